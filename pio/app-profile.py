@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+# app-profile - Symbolise a profile recorded by "profile start/stop"
+# Copyright 2026  Simon Arlott
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Usage:
+#
+# Run "profile start", then "profile stop" to write /profile.bin on the
+# device. Copy the output of "read /profile.bin" (in the "fs" context)
+# into a file (or decode it to the original binary file) and then run:
+#
+# app-profile.py .pio/build/<env>/firmware.elf profile.txt
+#
+# To create a flamegraph (of the sampled functions only, there are no
+# call stacks), use the folded output with flamegraph.pl:
+#
+# app-profile.py --folded profile.folded firmware.elf profile.txt
+# flamegraph.pl profile.folded >profile.svg
+
+import argparse
+import base64
+import bisect
+import collections
+import re
+import struct
+import subprocess
+import sys
+
+MAGIC = b"MCUP"
+VERSION = 1
+HEADER = struct.Struct("<4sBBHII")
+TASK = struct.Struct("<I16s")
+SAMPLE = struct.Struct("<IH")
+UNKNOWN_TASK = 0xFFFF
+
+Symbol = collections.namedtuple("Symbol", ["value", "size", "name"])
+RE_ELF_SYMBOL = re.compile(r"^\s*(?P<num>\w+):\s+(?P<value>\w+)\s+(?P<size>\w+)\s+(?P<type>\w+)\s+(?P<bind>\w+)\s+(?P<visibility>\w+)\s+(?P<ndx>\w+)\s+(?P<name>.+)$")
+
+
+class Symbols:
+	def __init__(self, fw_elf, readelf):
+		lines = subprocess.run([readelf, "-W", "--demangle", "--syms", fw_elf],
+				check=True, universal_newlines=True, stdout=subprocess.PIPE
+			).stdout.strip().split("\n")
+		syms = {}
+
+		for line in lines:
+			match = RE_ELF_SYMBOL.match(line)
+			if match and match["type"] == "FUNC" and match["ndx"] != "UND":
+				value = int(match["value"], 16)
+				size = int(match["size"], 0)
+				if size > 0 and (value not in syms or match["bind"] == "GLOBAL"):
+					syms[value] = Symbol(value, size, match["name"])
+
+		self.syms = sorted(syms.values())
+		self.values = [sym.value for sym in self.syms]
+
+	def lookup(self, pc):
+		pos = bisect.bisect_right(self.values, pc) - 1
+		if pos >= 0:
+			sym = self.syms[pos]
+			if pc < sym.value + sym.size:
+				return sym.name
+		return f"0x{pc:08x}"
+
+
+def read_profile(filename):
+	with open(filename, "rb") as f:
+		data = f.read()
+
+	if not data.startswith(MAGIC):
+		# Output of the "read" command: base64 lines followed by "<filename>: read <length>"
+		text = "".join(line.strip() for line in data.decode("ascii", "replace").split("\n")
+			if line.strip() and ":" not in line and " " not in line.strip())
+		data = base64.b64decode(text)
+
+	magic, version, _, task_count, interval_us, sample_count = HEADER.unpack_from(data, 0)
+	if magic != MAGIC or version != VERSION:
+		raise ValueError(f"{filename}: unsupported profile format")
+
+	offset = HEADER.size
+	tasks = {}
+	for i in range(task_count):
+		handle, name = TASK.unpack_from(data, offset)
+		tasks[i] = name.rstrip(b"\0").decode("ascii", "replace") or f"0x{handle:08x}"
+		offset += TASK.size
+
+	if len(data) < offset + sample_count * SAMPLE.size:
+		raise ValueError(f"{filename}: truncated ({sample_count} samples expected)")
+
+	samples = []
+	for i in range(sample_count):
+		samples.append(SAMPLE.unpack_from(data, offset))
+		offset += SAMPLE.size
+
+	return tasks, interval_us, samples
+
+
+def print_report(fw_elf, profile, readelf, top, folded):
+	symbols = Symbols(fw_elf, readelf)
+	tasks, interval_us, samples = read_profile(profile)
+	total = len(samples)
+
+	if not total:
+		print("No samples")
+		return
+
+	by_task = collections.Counter()
+	by_function = collections.Counter()
+	by_stack = collections.Counter()
+
+	for pc, task in samples:
+		task = tasks.get(task, "(other)") if task != UNKNOWN_TASK else "(other)"
+		function = symbols.lookup(pc)
+		by_task[task] += 1
+		by_function[function] += 1
+		by_stack[(task, function)] += 1
+
+	print(f"{total} samples at {1000000 // interval_us if interval_us else 0} Hz ({total * interval_us / 1000000:.3f}s)")
+	print()
+	print(" Samples      %  Task")
+	for task, count in by_task.most_common():
+		print(f"{count:8d} {count * 100 / total:6.2f}  {task}")
+	print()
+	print(" Samples      %  Function")
+	for function, count in by_function.most_common(top):
+		print(f"{count:8d} {count * 100 / total:6.2f}  {function}")
+
+	if folded:
+		with open(folded, "w") as f:
+			for (task, function), count in sorted(by_stack.items()):
+				f.write(f"{task};{function.replace(';', ':')} {count}\n")
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Symbolise a profile recorded by \"profile start/stop\"")
+	parser.add_argument("fw_elf", metavar="ELF", type=str, help="Firmware ELF filename")
+	parser.add_argument("profile", metavar="PROFILE", type=str, help="Profile filename (binary or base64)")
+	parser.add_argument("-r", "--readelf", type=str, default="readelf", help="readelf command")
+	parser.add_argument("-n", "--top", type=int, default=30, help="Number of functions to report")
+	parser.add_argument("-f", "--folded", type=str, help="Write folded stacks for flamegraph.pl")
+
+	args = parser.parse_args()
+	try:
+		print_report(**vars(args))
+	except ValueError as e:
+		print(e, file=sys.stderr)
+		sys.exit(1)
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# app-pstr-pool - Report bytes saved by pooling identical strings
+# Copyright 2026  Simon Arlott
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# PlatformIO usage:
+#
+# [env:...]
+# extra_scripts = post:app-pstr-pool.py
+
+import argparse
+import collections
+import os
+import re
+import struct
+
+SHF_ALLOC = 0x2
+SHF_MERGE = 0x10
+SHF_STRINGS = 0x20
+RE_SECTION_SUFFIX = re.compile(r"^(\.irom0\.pstr|\.rodata\.str\d+\.\d+)\..*$")
+
+Pool = collections.namedtuple("Pool", ["strings", "size", "unique"])
+
+
+def read_string_sections(filename):
+	with open(filename, "rb") as f:
+		data = f.read()
+
+	if data[:4] != b"\x7fELF":
+		return
+
+	endian = "<" if data[5] == 1 else ">"
+	if data[4] == 1:
+		header = struct.Struct(endian + "16xHHIIIIIHHHHHH")
+		section = struct.Struct(endian + "IIIIIIIIII")
+	else:
+		header = struct.Struct(endian + "16xHHIQQQIHHHHHH")
+		section = struct.Struct(endian + "IIQQQQIIQQ")
+
+	(_, _, _, _, _, shoff, _, _, _, _, shentsize, shnum, shstrndx) = header.unpack_from(data, 0)
+	sections = [section.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+	names = sections[shstrndx][4]
+
+	for (name, _, flags, _, offset, size, _, _, _, entsize) in sections:
+		if (flags & (SHF_ALLOC | SHF_MERGE | SHF_STRINGS)) == (SHF_ALLOC | SHF_MERGE | SHF_STRINGS) and entsize == 1:
+			name = data[names + name:data.index(b"\0", names + name)].decode("ascii")
+			yield name, data[offset:offset + size]
+
+
+def find_objects(build_dir):
+	for root, dirs, files in os.walk(build_dir):
+		for name in files:
+			if name.endswith(".o"):
+				yield os.path.join(root, name)
+
+
+def print_pool_report(build_dir, name=None):
+	sizes = collections.Counter()
+	strings = collections.defaultdict(list)
+	objects = 0
+
+	for filename in find_objects(build_dir):
+		objects += 1
+		for section, content in read_string_sections(filename):
+			section = RE_SECTION_SUFFIX.sub(r"\1", section)
+			sizes[section] += len(content)
+			strings[section].extend(value for value in content.split(b"\0")[:-1] if value)
+
+	pools = {}
+	for section in sorted(sizes):
+		pools[section] = Pool(len(strings[section]), sizes[section],
+			sum(len(value) + 1 for value in set(strings[section])))
+
+	print()
+	print(f"Pooled strings{' for ' + name if name else ''} ({objects} object files):")
+	for section, pool in pools.items():
+		print(f"\t{section:<28} {pool.strings:6d} strings {pool.size:8d} bytes -> {pool.unique:8d} bytes")
+
+	saved = sum(pool.size - pool.unique for pool in pools.values())
+	print(f"Total saved by pooling identical strings: {saved} bytes")
+
+
+def after_fw_elf(source, target, env):
+	print_pool_report(env.subst("$BUILD_DIR"), env.subst("$PIOENV"))
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Report bytes saved by pooling identical strings")
+	parser.add_argument("build_dir", metavar="DIR", type=str, help="Build directory containing object files")
+
+	args = parser.parse_args()
+	print_pool_report(**vars(args))
+elif __name__ == "SCons.Script":
+	Import("env")
+
+	env.AddPostAction("${BUILD_DIR}/${PROGNAME}.elf", after_fw_elf)
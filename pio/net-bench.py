@@ -0,0 +1,306 @@
+#!/usr/bin/env python3
+# net-bench - Network throughput benchmark peer for "net bench"
+# Copyright 2026  Simon Arlott
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Usage:
+#
+# Run "net-bench.py server" and then "net bench client <host> ..." on the
+# device, or run "net bench server" on the device and then
+# "net-bench.py client <device> ...".
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+DEFAULT_PORT = 5202
+HEADER = struct.Struct("!4sBBHII")
+RESULT = struct.Struct("!QII")
+MAGIC = b"MCUB"
+TCP_BUFFER_SIZE = 4096
+UDP_DATAGRAM_SIZE = 1400
+PROTOCOLS = ["tcp", "udp"]
+DIRECTIONS = ["send", "receive"]
+
+
+def print_rate(what, nbytes, elapsed):
+	elapsed = max(elapsed, 0.001)
+	print(f"{what:<12} {nbytes} bytes in {elapsed:.3f}s = {int(nbytes * 8 / elapsed / 1000)} kbit/s")
+
+
+def print_packets(packets, lost):
+	total = packets + lost
+	print(f"Packets:     {packets} received, {lost} lost ({lost * 100 / total if total else 0:.2f}%)")
+
+
+def print_retransmits(sock):
+	if hasattr(socket, "TCP_INFO"):
+		# struct tcp_info: tcpi_total_retrans is at offset 100 on Linux
+		info = sock.getsockopt(socket.IPPROTO_TCP, socket.TCP_INFO, 104)
+		if len(info) >= 104:
+			print(f"Retransmits: {struct.unpack_from('I', info, 100)[0]}")
+
+
+def print_cpu(start_cpu, start):
+	elapsed = max(time.monotonic() - start, 0.001)
+	print(f"CPU usage:   {int((time.process_time() - start_cpu) * 100 / elapsed)}% (process)")
+
+
+def recv_exact(sock, length):
+	data = b""
+	while len(data) < length:
+		chunk = sock.recv(length - len(data))
+		if not chunk:
+			return None
+		data += chunk
+	return data
+
+
+def udp_send_paced(sock, addr, seconds, rate_kbps):
+	buf = bytearray(UDP_DATAGRAM_SIZE)
+	packets = 0
+	nbytes = 0
+	start = time.monotonic()
+
+	while True:
+		elapsed = time.monotonic() - start
+		if elapsed >= seconds:
+			break
+
+		if nbytes >= elapsed * rate_kbps * 1000 / 8:
+			time.sleep(0.001)
+			continue
+
+		struct.pack_into("!I", buf, 0, packets & 0xFFFFFFFF)
+		try:
+			nbytes += sock.sendto(buf, addr) if addr else sock.send(buf)
+			packets += 1
+		except (BlockingIOError, OSError):
+			time.sleep(0.001)
+
+	return packets, nbytes, time.monotonic() - start
+
+
+class Receiver:
+	def __init__(self):
+		self.packets = 0
+		self.nbytes = 0
+		self.max_seq = None
+
+	def datagram(self, data):
+		if len(data) < 4:
+			return
+		seq = struct.unpack_from("!I", data, 0)[0]
+		if self.max_seq is None or seq > self.max_seq:
+			self.max_seq = seq
+		self.packets += 1
+		self.nbytes += len(data)
+
+	def lost(self):
+		if self.max_seq is None:
+			return 0
+		return max(0, self.max_seq + 1 - self.packets)
+
+
+def serve_one(conn, peer, udp):
+	header = recv_exact(conn, HEADER.size)
+	if header is None:
+		return
+
+	magic, mode, _, udp_port, seconds, rate_kbps = HEADER.unpack(header)
+	if magic != MAGIC or mode > 3:
+		print(f"{peer[0]}:{peer[1]}: invalid header")
+		return
+
+	protocol = PROTOCOLS[mode >> 1]
+	direction = DIRECTIONS[mode & 1]
+	seconds = min(seconds, 3600)
+
+	# Directions are relative to the client
+	print(f"{peer[0]}:{peer[1]}: {protocol.upper()} {'receive' if direction == 'send' else 'send'} test ({seconds}s)")
+	start = time.monotonic()
+	start_cpu = time.process_time()
+
+	if protocol == "tcp" and direction == "send":
+		nbytes = 0
+		while True:
+			data = conn.recv(TCP_BUFFER_SIZE)
+			if not data:
+				break
+			nbytes += len(data)
+		print_rate("Received:", nbytes, time.monotonic() - start)
+		conn.sendall(RESULT.pack(nbytes, 0, 0))
+	elif protocol == "tcp":
+		buf = bytes(TCP_BUFFER_SIZE)
+		nbytes = 0
+		while time.monotonic() - start < seconds:
+			nbytes += conn.send(buf)
+		print_rate("Sent:", nbytes, time.monotonic() - start)
+		print_retransmits(conn)
+	elif direction == "send":
+		receiver = Receiver()
+		conn.setblocking(False)
+		udp.setblocking(False)
+		while True:
+			try:
+				receiver.datagram(udp.recv(UDP_DATAGRAM_SIZE))
+				continue
+			except BlockingIOError:
+				pass
+
+			try:
+				if not conn.recv(1):
+					break
+			except BlockingIOError:
+				time.sleep(0.0001)
+		conn.setblocking(True)
+		print_rate("Received:", receiver.nbytes, time.monotonic() - start)
+		print_packets(receiver.packets, receiver.lost())
+		conn.sendall(RESULT.pack(receiver.nbytes, receiver.packets, receiver.lost()))
+	else:
+		udp.setblocking(True)
+		packets, nbytes, elapsed = udp_send_paced(udp, (peer[0], udp_port), seconds, rate_kbps)
+		print_rate("Sent:", nbytes, elapsed)
+		conn.sendall(RESULT.pack(nbytes, packets, 0))
+
+	print_cpu(start_cpu, start)
+
+
+def server(bind, port):
+	listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+	listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+	listener.bind((bind, port))
+	listener.listen(1)
+
+	udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+	udp.bind((bind, port))
+
+	print(f"Listening on {bind}:{port}")
+	while True:
+		conn, peer = listener.accept()
+		conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+		try:
+			serve_one(conn, peer, udp)
+		except OSError as e:
+			print(f"{peer[0]}:{peer[1]}: {e}")
+		finally:
+			conn.close()
+
+
+def client(host, port, protocol, direction, seconds, rate_kbps):
+	conn = socket.create_connection((host, port), timeout=5)
+	conn.settimeout(None)
+	conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+	udp = None
+	udp_port = 0
+	if protocol == "udp":
+		udp = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+		udp.bind(("", 0))
+		udp_port = udp.getsockname()[1]
+		if direction == "send":
+			udp.connect((conn.getpeername()[0], port))
+
+	mode = (PROTOCOLS.index(protocol) << 1) | DIRECTIONS.index(direction)
+	print(f"Connected to {host}:{port} for {protocol.upper()} {direction} test ({seconds}s)")
+	conn.sendall(HEADER.pack(MAGIC, mode, 0, udp_port, seconds, rate_kbps))
+	start = time.monotonic()
+	start_cpu = time.process_time()
+
+	if protocol == "tcp" and direction == "send":
+		buf = bytes(TCP_BUFFER_SIZE)
+		nbytes = 0
+		while time.monotonic() - start < seconds:
+			nbytes += conn.send(buf)
+		elapsed = time.monotonic() - start
+		conn.shutdown(socket.SHUT_WR)
+		result = recv_exact(conn, RESULT.size)
+		print_rate("Sent:", nbytes, elapsed)
+		if result:
+			print_rate("Received:", RESULT.unpack(result)[0], elapsed)
+		print_retransmits(conn)
+	elif protocol == "tcp":
+		nbytes = 0
+		while True:
+			data = conn.recv(TCP_BUFFER_SIZE)
+			if not data:
+				break
+			nbytes += len(data)
+		print_rate("Received:", nbytes, time.monotonic() - start)
+	elif direction == "send":
+		packets, nbytes, elapsed = udp_send_paced(udp, None, seconds, rate_kbps)
+		conn.shutdown(socket.SHUT_WR)
+		result = recv_exact(conn, RESULT.size)
+		print_rate("Sent:", nbytes, elapsed)
+		if result:
+			peer_bytes, peer_packets, peer_lost = RESULT.unpack(result)
+			print_rate("Received:", peer_bytes, elapsed)
+			print_packets(peer_packets, peer_lost)
+	else:
+		receiver = Receiver()
+		udp.settimeout(0.1)
+		conn.setblocking(False)
+		result = b""
+		while len(result) < RESULT.size:
+			try:
+				receiver.datagram(udp.recv(UDP_DATAGRAM_SIZE))
+			except socket.timeout:
+				pass
+
+			try:
+				data = conn.recv(RESULT.size - len(result))
+				if not data:
+					break
+				result += data
+			except BlockingIOError:
+				pass
+		elapsed = time.monotonic() - start
+		if len(result) == RESULT.size:
+			peer_bytes, peer_packets, _ = RESULT.unpack(result)
+			print_rate("Sent:", peer_bytes, elapsed)
+			print_rate("Received:", receiver.nbytes, elapsed)
+			print_packets(receiver.packets, max(0, peer_packets - receiver.packets))
+		else:
+			print("Connection closed before result")
+
+	print_cpu(start_cpu, start)
+	conn.close()
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Network throughput benchmark peer")
+	parser.add_argument("-p", "--port", type=int, default=DEFAULT_PORT, help="Port number")
+	subparsers = parser.add_subparsers(dest="command", required=True)
+
+	parser_server = subparsers.add_parser("server", help="Run server")
+	parser_server.add_argument("-b", "--bind", type=str, default="", help="Bind address")
+
+	parser_client = subparsers.add_parser("client", help="Run client")
+	parser_client.add_argument("host", type=str, help="Server host")
+	parser_client.add_argument("protocol", choices=PROTOCOLS, help="Protocol")
+	parser_client.add_argument("direction", choices=DIRECTIONS, help="Direction relative to the client")
+	parser_client.add_argument("seconds", type=int, nargs="?", default=10, help="Duration")
+	parser_client.add_argument("rate", type=int, nargs="?", default=10000, help="UDP rate (kbit/s)")
+
+	args = parser.parse_args()
+	try:
+		if args.command == "server":
+			server(args.bind, args.port)
+		else:
+			client(args.host, args.port, args.protocol, args.direction, args.seconds, args.rate)
+	except KeyboardInterrupt:
+		sys.exit(1)
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+# ota-push - Push an application image to an ESP32 over the network
+# Copyright 2026  Simon Arlott
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Usage:
+#
+# Enable OTA on the device with "set ota password" and "set ota on", then
+# run "ota-push.py <device> .pio/build/<env>/firmware.bin". The device
+# restarts after the image has been written.
+
+import argparse
+import getpass
+import hashlib
+import hmac
+import os
+import socket
+import struct
+import sys
+import time
+
+DEFAULT_PORT = 3232
+MAGIC = b"MCUO"
+NONCE_LEN = 32
+CHUNK_SIZE = 64 * 1024
+
+
+def recv_exact(sock, length):
+	data = b""
+	while len(data) < length:
+		chunk = sock.recv(length - len(data))
+		if not chunk:
+			return None
+		data += chunk
+	return data
+
+
+def recv_line(sock):
+	data = b""
+	while not data.endswith(b"\n"):
+		chunk = sock.recv(1)
+		if not chunk:
+			break
+		data += chunk
+	return data.decode("utf-8", "replace").strip()
+
+
+def push(host, port, filename, password):
+	with open(filename, "rb") as f:
+		image = f.read()
+
+	conn = socket.create_connection((host, port), timeout=30)
+	conn.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, CHUNK_SIZE * 4)
+
+	challenge = recv_exact(conn, len(MAGIC) + NONCE_LEN)
+	if challenge is None or challenge[0:len(MAGIC)] != MAGIC:
+		print("Invalid challenge")
+		return False
+
+	size = struct.pack("!I", len(image))
+	key = password.encode("utf-8")
+	mac = hmac.new(key, challenge[len(MAGIC):] + size, hashlib.sha256).digest()
+	conn.sendall(MAGIC + size + mac)
+
+	# The image is authenticated too, before the device will boot it
+	image_mac = hmac.new(key, challenge[len(MAGIC):] + size, hashlib.sha256)
+
+	response = recv_line(conn)
+	if response != "OK":
+		print(f"Rejected: {response}")
+		return False
+
+	print(f"Sending {len(image)} bytes")
+	start = time.monotonic()
+	last = start
+	sent = 0
+	while sent < len(image):
+		chunk = image[sent:sent + CHUNK_SIZE]
+		image_mac.update(chunk)
+		conn.sendall(chunk)
+		sent = min(sent + CHUNK_SIZE, len(image))
+
+		now = time.monotonic()
+		if now - last >= 1 or sent == len(image):
+			print(f"Progress:    {sent * 100 // len(image):3d}% ({sent})")
+			last = now
+
+	conn.sendall(image_mac.digest())
+	response = recv_line(conn)
+	elapsed = max(time.monotonic() - start, 0.001)
+	conn.close()
+
+	if not response.startswith("OK"):
+		print(f"Failed: {response}")
+		return False
+
+	print(f"Sent:        {len(image)} bytes in {elapsed:.3f}s = {int(len(image) * 8 / elapsed / 1000)} kbit/s")
+	fields = response.split()
+	if len(fields) == 3:
+		device_ms = max(int(fields[2]), 1)
+		print(f"Device:      {fields[1]} bytes in {device_ms}ms = {int(fields[1]) * 8 // device_ms} kbit/s")
+	return True
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Push an application image to an ESP32")
+	parser.add_argument("-p", "--port", type=int, default=DEFAULT_PORT, help="Port number")
+	parser.add_argument("host", type=str, help="Device host")
+	parser.add_argument("filename", type=str, help="Application image")
+
+	args = parser.parse_args()
+	password = os.environ.get("OTA_PASSWORD")
+	if password is None:
+		password = getpass.getpass("OTA password: ")
+
+	try:
+		sys.exit(0 if push(args.host, args.port, args.filename, password) else 1)
+	except KeyboardInterrupt:
+		sys.exit(1)
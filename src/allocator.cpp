@@ -0,0 +1,399 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "app/allocator.h"
+
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP32
+# include <esp_heap_caps.h>
+# include <soc/soc_memory_layout.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+#include "app/util.h"
+
+#if APP_NO_HEAP_AFTER_BOOT
+MAKE_PSTR(logger_name, "heap")
+#endif
+
+namespace app {
+
+namespace allocator {
+
+enum class Region : uint8_t {
+	INTERNAL,
+	PSRAM,
+	BUDGET,
+	END,
+};
+
+struct Counters {
+	std::atomic<unsigned long> allocations{0};
+	std::atomic<unsigned long> failures{0};
+	std::atomic<size_t> bytes{0};
+	std::atomic<size_t> peak_bytes{0};
+};
+
+static constexpr size_t SUBSYSTEMS = static_cast<size_t>(Subsystem::END);
+static constexpr size_t REGIONS = static_cast<size_t>(Region::END);
+
+static std::array<std::array<Counters, REGIONS>, SUBSYSTEMS> counters;
+
+#if APP_NO_HEAP_AFTER_BOOT
+/*
+ * Each budget is a bump allocator that is reset when everything allocated
+ * from it has been freed, so it can't be fragmented.
+ */
+struct Budget {
+	uint8_t *base{nullptr};
+	size_t size{0};
+	size_t used{0};
+	size_t peak{0};
+	size_t live{0};
+	unsigned long exhausted{0};
+};
+
+static constexpr size_t BUDGET_ALIGN = 8;
+static constexpr std::array<size_t, SUBSYSTEMS> budget_sizes{
+	APP_BUDGET_CONSOLE,
+	APP_BUDGET_FILESYSTEM,
+	APP_BUDGET_NETWORK,
+	APP_BUDGET_OTA,
+	APP_BUDGET_COMMAND,
+};
+
+static uuid::log::Logger logger{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
+static std::array<Budget, SUBSYSTEMS> budgets;
+# if MCU_APP_THREAD_SAFE
+static std::mutex budget_mutex;
+# endif
+static std::atomic<bool> booted{false};
+static std::atomic<unsigned long> heap_allocations{0};
+static std::atomic<size_t> heap_bytes{0};
+static std::atomic<uintptr_t> heap_caller{0};
+#endif
+
+static const __FlashStringHelper *subsystem_name(size_t subsystem) {
+	switch (static_cast<Subsystem>(subsystem)) {
+	case Subsystem::CONSOLE:
+		return F("console");
+
+	case Subsystem::FILESYSTEM:
+		return F("filesystem");
+
+	case Subsystem::NETWORK:
+		return F("network");
+
+	case Subsystem::OTA:
+		return F("ota");
+
+	case Subsystem::COMMAND:
+		return F("command");
+
+	case Subsystem::END:
+		break;
+	}
+
+	return F("?");
+}
+
+static Counters &counters_for(Subsystem subsystem, Region region) {
+	return counters[static_cast<size_t>(subsystem)][static_cast<size_t>(region)];
+}
+
+static Region region_of(Subsystem subsystem, void *ptr) {
+#if APP_NO_HEAP_AFTER_BOOT
+	const Budget &budget = budgets[static_cast<size_t>(subsystem)];
+
+	if (ptr >= budget.base && ptr < budget.base + budget.size)
+		return Region::BUDGET;
+#endif
+#ifdef ARDUINO_ARCH_ESP32
+	if (esp_ptr_external_ram(ptr))
+		return Region::PSRAM;
+#endif
+	return Region::INTERNAL;
+}
+
+static const __FlashStringHelper *region_name(size_t region) {
+	switch (static_cast<Region>(region)) {
+	case Region::INTERNAL:
+		return F("internal");
+
+	case Region::PSRAM:
+		return F("psram");
+
+	case Region::BUDGET:
+		return F("budget");
+
+	case Region::END:
+		break;
+	}
+
+	return F("?");
+}
+
+static void *heap_allocate(size_t size) {
+#ifdef ARDUINO_ARCH_ESP32
+	void *ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+	if (!ptr)
+		ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+	return ptr;
+#else
+	return std::malloc(size);
+#endif
+}
+
+#if APP_NO_HEAP_AFTER_BOOT
+static void *budget_allocate(Budget &budget, size_t size) {
+# if MCU_APP_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{budget_mutex};
+# endif
+	size = (size + BUDGET_ALIGN - 1) & ~(BUDGET_ALIGN - 1);
+
+	if (size > budget.size - budget.used) {
+		budget.exhausted++;
+		return nullptr;
+	}
+
+	void *ptr = budget.base + budget.used;
+
+	budget.used += size;
+	budget.live++;
+	budget.peak = std::max(budget.peak, budget.used);
+	return ptr;
+}
+
+static void budget_deallocate(Budget &budget) {
+# if MCU_APP_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{budget_mutex};
+# endif
+
+	if (--budget.live == 0)
+		budget.used = 0;
+}
+
+static void count_heap_allocation(size_t size, void *caller) {
+	if (booted) {
+		heap_allocations++;
+		heap_bytes += size;
+		heap_caller = reinterpret_cast<uintptr_t>(caller);
+	}
+}
+#endif
+
+void init() {
+#ifdef ARDUINO_ARCH_ESP32
+	if (psramFound())
+		heap_caps_malloc_extmem_enable(APP_PSRAM_ALLOC_THRESHOLD);
+#endif
+
+#if APP_NO_HEAP_AFTER_BOOT
+	for (size_t i = 0; i < SUBSYSTEMS; i++) {
+		if (!budget_sizes[i])
+			continue;
+
+		budgets[i].base = static_cast<uint8_t *>(heap_allocate(budget_sizes[i]));
+
+		if (budgets[i].base)
+			budgets[i].size = budget_sizes[i];
+	}
+#endif
+}
+
+void boot_complete() {
+#if APP_NO_HEAP_AFTER_BOOT
+	if (booted)
+		return;
+
+	for (size_t i = 0; i < SUBSYSTEMS; i++) {
+		if (budget_sizes[i]) {
+			if (budgets[i].size) {
+				logger.info(F("Budget for %S: %zu bytes"), subsystem_name(i), budgets[i].size);
+			} else {
+				logger.crit(F("Unable to reserve %zu bytes for %S"), budget_sizes[i], subsystem_name(i));
+			}
+		}
+	}
+
+# ifndef ENV_NATIVE
+	logger.info(F("Free heap after boot: %lu bytes"), (unsigned long)ESP.getFreeHeap());
+# endif
+	booted = true;
+#endif
+}
+
+void *allocate(Subsystem subsystem, size_t size) {
+	void *ptr = nullptr;
+
+#if APP_NO_HEAP_AFTER_BOOT
+	Budget &budget = budgets[static_cast<size_t>(subsystem)];
+
+	if (budget.size) {
+		ptr = budget_allocate(budget, size);
+
+		if (!ptr) {
+			counters_for(subsystem, Region::BUDGET).failures++;
+			return nullptr;
+		}
+	}
+#endif
+
+	if (!ptr) {
+		ptr = heap_allocate(size);
+
+		if (!ptr) {
+			counters_for(subsystem, Region::INTERNAL).failures++;
+			return nullptr;
+		}
+	}
+
+	Counters &region = counters_for(subsystem, region_of(subsystem, ptr));
+	size_t bytes = region.bytes += size;
+	size_t peak = region.peak_bytes;
+
+	region.allocations++;
+
+	while (bytes > peak && !region.peak_bytes.compare_exchange_weak(peak, bytes));
+
+	return ptr;
+}
+
+void deallocate(Subsystem subsystem, void *ptr, size_t size) {
+	if (!ptr)
+		return;
+
+	Region region = region_of(subsystem, ptr);
+
+	counters_for(subsystem, region).bytes -= size;
+
+#if APP_NO_HEAP_AFTER_BOOT
+	if (region == Region::BUDGET) {
+		budget_deallocate(budgets[static_cast<size_t>(subsystem)]);
+		return;
+	}
+#endif
+
+	std::free(ptr);
+}
+
+size_t available(Subsystem subsystem) {
+#if APP_NO_HEAP_AFTER_BOOT
+	const Budget &budget = budgets[static_cast<size_t>(subsystem)];
+
+	if (budget.size) {
+# if MCU_APP_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{budget_mutex};
+# endif
+		return budget.size - budget.used;
+	}
+#endif
+
+	return SIZE_MAX;
+}
+
+void show(uuid::console::Shell &shell) {
+	shell.printfln(F("Subsystem   Region    Allocations  Failures  Bytes     Peak bytes"));
+
+	for (size_t i = 0; i < SUBSYSTEMS; i++) {
+		for (size_t j = 0; j < REGIONS; j++) {
+			const Counters &region = counters[i][j];
+
+			if (!region.allocations && !region.failures)
+				continue;
+
+			shell.printfln(F("%-10s  %-8s  %11lu  %8lu  %8zu  %10zu"),
+				uuid::read_flash_string(subsystem_name(i)).c_str(),
+				uuid::read_flash_string(region_name(j)).c_str(),
+				region.allocations.load(), region.failures.load(),
+				region.bytes.load(), region.peak_bytes.load());
+		}
+	}
+
+#if APP_NO_HEAP_AFTER_BOOT
+	shell.println();
+	shell.printfln(F("Budget      Size      Used      Peak      Exhausted"));
+
+	for (size_t i = 0; i < SUBSYSTEMS; i++) {
+		Budget budget;
+
+		{
+# if MCU_APP_THREAD_SAFE
+			std::lock_guard<std::mutex> lock{budget_mutex};
+# endif
+			budget = budgets[i];
+		}
+
+		if (!budget.size)
+			continue;
+
+		shell.printfln(F("%-10s  %8zu  %8zu  %8zu  %9lu"),
+			uuid::read_flash_string(subsystem_name(i)).c_str(),
+			budget.size, budget.used, budget.peak, budget.exhausted);
+	}
+
+	shell.println();
+	shell.printfln(F("Heap allocations after boot: %lu (%zu bytes, last from 0x%08lx)"),
+		heap_allocations.load(), heap_bytes.load(), (unsigned long)heap_caller.load());
+#endif
+}
+
+} // namespace allocator
+
+} // namespace app
+
+#if APP_NO_HEAP_AFTER_BOOT
+/*
+ * Requires -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc so that
+ * all calls to these functions are counted.
+ */
+extern "C" {
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+	app::allocator::count_heap_allocation(size, __builtin_return_address(0));
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+	app::allocator::count_heap_allocation(nmemb * size, __builtin_return_address(0));
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	app::allocator::count_heap_allocation(size, __builtin_return_address(0));
+	return __real_realloc(ptr, size);
+}
+
+}
+#endif
@@ -0,0 +1,161 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <uuid/console.h>
+
+/*
+ * Allocations (by malloc() and new) of at least this size are made from
+ * PSRAM if it is available. Smaller allocations stay in internal RAM, as
+ * do allocations that explicitly require internal or DMA-capable memory.
+ */
+#ifndef APP_PSRAM_ALLOC_THRESHOLD
+# define APP_PSRAM_ALLOC_THRESHOLD 1024
+#endif
+
+/*
+ * Build with -DAPP_NO_HEAP_AFTER_BOOT=1 (and the linker flags in the
+ * app:no_heap_after_boot section of pio/config.ini) to reserve a fixed
+ * budget for each subsystem at boot. Subsystem buffers are then only
+ * allocated from their budget (and fail when it is exhausted) so that
+ * they can't fragment the heap. Any other heap allocation after boot
+ * is counted.
+ *
+ * On ESP8266 only the console has a (small) budget and almost all heap
+ * allocations are made by the core, lwIP and other libraries, so this
+ * mode only counts them and doesn't prevent fragmentation.
+ *
+ * A budget of 0 uses the heap.
+ */
+#ifndef APP_NO_HEAP_AFTER_BOOT
+# define APP_NO_HEAP_AFTER_BOOT 0
+#endif
+
+#if APP_NO_HEAP_AFTER_BOOT
+/* Base64 data entered on the console is limited to half of this */
+# ifndef APP_BUDGET_CONSOLE
+#  ifdef ARDUINO_ARCH_ESP8266
+#   define APP_BUDGET_CONSOLE 2048
+#  else
+#   define APP_BUDGET_CONSOLE 8192
+#  endif
+# endif
+/* The filesystem commands that use this are only available on ESP32 */
+# ifndef APP_BUDGET_FILESYSTEM
+#  ifdef ARDUINO_ARCH_ESP32
+#   define APP_BUDGET_FILESYSTEM 4096
+#  else
+#   define APP_BUDGET_FILESYSTEM 0
+#  endif
+# endif
+# ifndef APP_BUDGET_NETWORK
+#  define APP_BUDGET_NETWORK 0
+# endif
+# ifndef APP_BUDGET_OTA
+#  define APP_BUDGET_OTA 0
+# endif
+/* Command arenas keep their first block, which would never reset a budget */
+# ifndef APP_BUDGET_COMMAND
+#  define APP_BUDGET_COMMAND 0
+# endif
+#endif
+
+namespace app {
+
+namespace allocator {
+
+enum class Subsystem : uint8_t {
+	CONSOLE,
+	FILESYSTEM,
+	NETWORK,
+	OTA,
+	COMMAND,
+	END,
+};
+
+/* Apply the allocation size threshold for PSRAM and reserve budgets */
+void init();
+
+/* Start counting heap allocations, and log the budgets */
+void boot_complete();
+
+/*
+ * Allocate memory for a subsystem, preferring PSRAM regardless of size
+ * because these buffers are large or short-lived. Falls back to internal
+ * RAM if there's no PSRAM. Returns nullptr if there's no memory.
+ */
+void *allocate(Subsystem subsystem, size_t size);
+void deallocate(Subsystem subsystem, void *ptr, size_t size);
+
+/* Largest allocation that can be made from a subsystem's budget */
+size_t available(Subsystem subsystem);
+
+void show(uuid::console::Shell &shell);
+
+template <typename T, Subsystem S>
+class Allocator {
+public:
+	using value_type = T;
+
+	template <typename U>
+	struct rebind {
+		using other = Allocator<U, S>;
+	};
+
+	Allocator() = default;
+	template <typename U>
+	Allocator(const Allocator<U, S>&) {}
+
+	T *allocate(size_t n) {
+		void *ptr = allocator::allocate(S, n * sizeof(T));
+
+		if (!ptr) {
+#if __cpp_exceptions
+			throw std::bad_alloc();
+#else
+			std::abort();
+#endif
+		}
+
+		return static_cast<T *>(ptr);
+	}
+
+	void deallocate(T *ptr, size_t n) {
+		allocator::deallocate(S, ptr, n * sizeof(T));
+	}
+
+	template <typename U>
+	bool operator==(const Allocator<U, S>&) const { return true; }
+	template <typename U>
+	bool operator!=(const Allocator<U, S>&) const { return false; }
+};
+
+template <Subsystem S>
+using buffer = std::vector<uint8_t, Allocator<uint8_t, S>>;
+
+} // namespace allocator
+
+} // namespace app
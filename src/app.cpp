@@ -53,11 +53,17 @@
 # include <uuid/telnet.h>
 #endif
 
+#include "app/allocator.h"
 #include "app/config.h"
 #include "app/console.h"
 #include "app/console_stream.h"
 #include "app/fs.h"
+#include "app/isr_log.h"
+#include "app/littlefs_block_cache.h"
 #include "app/network.h"
+#include "app/pstr.h"
+#include "app/resolver.h"
+#include "app/serial_console.h"
 #include "app/util.h"
 
 #ifndef APP_NAME
@@ -81,11 +87,7 @@ extern const uint8_t x509_crt_bundle_end[]   asm("_binary_app_pio_certs_x509_crt
 # endif
 #endif
 
-#ifndef PSTR_ALIGN
-# define PSTR_ALIGN 4
-#endif
-
-static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = APP_NAME;
+MAKE_PSTR(logger_name, APP_NAME)
 
 namespace app {
 
@@ -93,19 +95,35 @@ uuid::log::Logger App::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::
 
 App::App()
 #ifndef ENV_NATIVE
-		: telnet_([this] (Stream &stream, const IPAddress &addr, uint16_t port) -> std::shared_ptr<uuid::console::Shell> {
-			return std::make_shared<app::AppConsole>(*this, stream, addr, port);
-		})
+		: syslog_resolver_(F("syslog"), [this] (const IPAddress &address) {
+			syslog_.destination(address);
+		}),
+		  telnet_([this] (Stream &stream, const IPAddress &addr, uint16_t port) -> std::shared_ptr<uuid::console::Shell> {
+			auto console = std::make_shared<app::AppConsole>(*this,
+				std::make_unique<QueuedStream>(stream), addr, port);
+
+			console->output_queue()->owner(console, console->console_name());
+			return console;
+		}),
+		  command_channel_(*this)
 #endif
 	{
 
 }
 
 void App::init() {
+	allocator::init();
+
 #ifdef ENV_NATIVE
-	shell_ = std::make_shared<AppConsole>(*this, serial_console_, true);
-	shell_->start();
-	shell_->log_level(uuid::log::Level::TRACE);
+	const char *replay = ::getenv("APP_CONSOLE_REPLAY");
+
+	if (replay) {
+		replay_ = std::make_unique<ConsoleReplay>(*this, serial_console_, replay);
+	} else {
+		shell_ = std::make_shared<AppConsole>(*this, serial_console_, true);
+		shell_->start();
+		shell_->log_level(uuid::log::Level::TRACE);
+	}
 #else
 	syslog_.start();
 	syslog_.maximum_log_messages(100);
@@ -115,9 +133,19 @@ void App::init() {
 
 	if (FS_begin(true)) {
 		logger_.debug(F("Mounted filesystem"));
+#ifdef ARDUINO_ARCH_ESP32
+		filesystem_cache::mounted();
+		uplink_.start();
+#endif
 	} else {
 		logger_.emerg(F("Unable to mount filesystem"));
 	}
+
+#ifdef ARDUINO_ARCH_ESP32
+	if (TMPFS.begin(APP_TMPFS_SIZE)) {
+		logger_.debug(F("Mounted %s in RAM (%zu bytes)"), TMPFS.mountpoint(), TMPFS.totalBytes());
+	}
+#endif
 }
 
 void App::start() {
@@ -205,7 +233,7 @@ void App::start() {
 	}
 
 	if (local_console_) {
-		serial_console_.begin(SERIAL_CONSOLE_BAUD_RATE);
+		serial_console::begin();
 		serial_console_.println();
 		serial_console_.println(F(APP_NAME " " APP_VERSION));
 	}
@@ -228,11 +256,10 @@ void App::start() {
 
 	network_.start();
 	config_syslog();
-#if defined(ARDUINO_ARCH_ESP8266)
 	config_ota();
-#endif
-	telnet_.default_write_timeout(1000);
+	telnet_.default_write_timeout(APP_TELNET_WRITE_TIMEOUT_MS);
 	telnet_.start();
+	command_channel_.start();
 
 	if (local_console_) {
 		shell_prompt();
@@ -241,15 +268,28 @@ void App::start() {
 }
 
 void App::loop() {
+#if APP_NO_HEAP_AFTER_BOOT
+	allocator::boot_complete();
+#endif
 	uuid::loop();
+	isr_log::loop();
 #ifndef ENV_NATIVE
+	network_.loop();
+	syslog_resolver_.loop();
 	syslog_.loop();
 # ifdef ARDUINO_ARCH_ESP32
 	ddns_.loop();
+	ota_server_.loop();
+	filesystem_cache::loop();
+	uplink_.loop();
 # endif
 	telnet_.loop();
+	command_channel_.loop();
 #endif
 	uuid::console::Shell::loop_all();
+#ifndef ENV_NATIVE
+	QueuedStream::loop_all();
+#endif
 
 #if defined(ARDUINO_ARCH_ESP8266)
 	if (ota_running_) {
@@ -258,11 +298,17 @@ void App::loop() {
 #endif
 
 #ifdef ENV_NATIVE
-	if (!shell_->running()) {
+	if (replay_) {
+		if (replay_->loop()) {
+			::exit(replay_->failures() ? 1 : 0);
+		}
+	} else if (!shell_->running()) {
 		::exit(0);
 	}
 #else
 	if (local_console_) {
+		serial_console::loop();
+
 		if (shell_) {
 			if (!shell_->running()) {
 				shell_.reset();
@@ -304,8 +350,11 @@ void App::config_syslog() {
 	Config config;
 	IPAddress addr;
 
-	if (!addr.fromString(config.syslog_host().c_str())) {
-		addr = (uint32_t)0;
+	if (addr.fromString(config.syslog_host().c_str())) {
+		syslog_resolver_.host("");
+	} else {
+		syslog_resolver_.host(config.syslog_host());
+		addr = syslog_resolver_.address();
 	}
 
 	syslog_.hostname(config.hostname());
@@ -368,6 +417,12 @@ void App::config_ota() {
 		ota_running_ = false;
 	}
 }
+#elif defined(ARDUINO_ARCH_ESP32)
+void App::config_ota() {
+	Config config;
+
+	ota_server_.config(config.ota_enabled(), config.ota_password());
+}
 #endif
 
 } // namespace app
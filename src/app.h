@@ -29,9 +29,17 @@
 # include <uuid/telnet.h>
 #endif
 
+#include "command_channel.h"
 #include "console.h"
+#include "console_replay.h"
 #include "ddns.h"
+#include "log_fanout.h"
 #include "network.h"
+#include "ota_server.h"
+#include "profiler.h"
+#include "resolver.h"
+#include "serial_console.h"
+#include "uplink_queue.h"
 
 #ifndef APP_CONSOLE_PIN
 # define APP_CONSOLE_PIN -1
@@ -43,7 +51,7 @@ class AppShell;
 
 class App {
 private:
-	static constexpr unsigned long SERIAL_CONSOLE_BAUD_RATE = 115200;
+	static constexpr unsigned long SERIAL_CONSOLE_BAUD_RATE = APP_SERIAL_CONSOLE_BAUD_RATE;
 	static constexpr auto& serial_console_ = Serial;
 	static constexpr int CONSOLE_PIN = APP_CONSOLE_PIN;
 
@@ -65,7 +73,7 @@ public:
 #ifndef ENV_NATIVE
 	void config_syslog();
 #endif
-#ifdef ARDUINO_ARCH_ESP8266
+#ifndef ENV_NATIVE
 	void config_ota();
 #endif
 
@@ -73,6 +81,8 @@ public:
 	Network network_;
 # ifdef ARDUINO_ARCH_ESP32
 	DynamicDNS ddns_;
+	Profiler profiler_;
+	UplinkQueue uplink_;
 # endif
 #endif
 
@@ -90,14 +100,22 @@ private:
 	void shell_prompt();
 
 #ifndef ENV_NATIVE
-	uuid::syslog::SyslogService syslog_;
+	AppSyslog syslog_;
+	Resolver syslog_resolver_;
 	uuid::telnet::TelnetService telnet_;
+	CommandChannel command_channel_;
 #endif
 	std::shared_ptr<AppShell> shell_;
+#ifdef ENV_NATIVE
+	std::unique_ptr<ConsoleReplay> replay_;
+#endif
 	bool local_console_;
 #ifdef ARDUINO_ARCH_ESP8266
 	bool ota_running_ = false;
 #else
+# ifdef ARDUINO_ARCH_ESP32
+	OTAServer ota_server_;
+# endif
 	std::string app_hash_;
 #endif
 };
@@ -0,0 +1,634 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/bench.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_image_format.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_random.h>
+#include <esp_spi_flash.h>
+#include <esp_timer.h>
+#include <mbedtls/aes.h>
+#include <mbedtls/sha256.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+#include <uuid/common.h>
+#include <uuid/console.h>
+
+#include "app/fs.h"
+#include "app/littlefs_block_cache.h"
+#include "app/util.h"
+
+namespace cbor = qindesign::cbor;
+
+using uuid::console::Shell;
+
+namespace app {
+
+namespace benchmark {
+
+static constexpr uint64_t TEST_TIME_US = 1000 * 1000;
+static constexpr uint64_t STEP_TIME_US = 20 * 1000;
+static constexpr size_t CHUNK_SIZE = 4096;
+static constexpr size_t FLASH_READ_SIZE = 1024 * 1024;
+static constexpr size_t FLASH_SCRATCH_SIZE = 64 * 1024;
+static constexpr size_t INTERNAL_COPY_SIZE = 16 * 1024;
+static constexpr size_t PSRAM_COPY_SIZE = 256 * 1024;
+static constexpr size_t FS_FILE_SIZE = 256 * 1024;
+static constexpr size_t FS_RANDOM_READ_SIZE = 256;
+static constexpr size_t CBOR_BUFFER_SIZE = 256;
+static constexpr size_t CBOR_MAP_ENTRIES = 8;
+
+struct Result {
+	enum class State : uint8_t {
+		OK,
+		SKIPPED,
+		FAILED,
+	};
+
+	const __FlashStringHelper *name;
+	State state{State::OK};
+	bool show_ops{false};
+	uint64_t bytes{0};
+	unsigned long ops{0};
+	uint64_t us{0};
+};
+
+class BufferPrint: public ::Print {
+public:
+	BufferPrint(uint8_t *buffer, size_t size) : buffer_(buffer), size_(size) {}
+
+	size_t write(uint8_t data) override {
+		return write(&data, 1);
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		if (size > size_ - length_) {
+			setWriteError();
+			return 0;
+		}
+
+		std::memcpy(&buffer_[length_], buffer, size);
+		length_ += size;
+		return size;
+	}
+
+	inline size_t length() const { return length_; }
+
+private:
+	uint8_t *buffer_;
+	size_t size_;
+	size_t length_{0};
+};
+
+class Runner {
+public:
+	explicit Runner(Suite suite);
+	~Runner();
+
+	bool loop(Shell &shell, bool stop);
+
+private:
+	/* Returns the number of bytes processed, 0 when finished or -1 on error */
+	using Step = std::function<long()>;
+
+	struct Test {
+		const __FlashStringHelper *name;
+		std::function<bool(Shell &shell)> setup;
+		Step step;
+		std::function<void()> teardown;
+		bool show_ops;
+	};
+
+	void add(const __FlashStringHelper *name, std::function<bool(Shell &shell)> setup,
+		Step step, std::function<void()> teardown = nullptr, bool show_ops = false);
+	void add_flash();
+	void add_memory();
+	void add_filesystem();
+	void add_crypto();
+	void add_cbor();
+
+	bool find_scratch(Shell &shell);
+	bool allocate_copy(uint32_t src_caps, uint32_t dst_caps, size_t size);
+	void free_copy();
+	bool open_file(bool cached);
+	long read_file(size_t offset, size_t len);
+	long encode_cbor();
+
+	void end_test(Shell &shell, Result::State state);
+	void print(Shell &shell, const Result &result);
+
+	std::vector<Test> tests_;
+	std::vector<Result> results_;
+	size_t index_{0};
+	bool running_{false};
+	uint64_t start_us_{0};
+
+	const esp_partition_t *partition_{nullptr};
+	size_t offset_{0};
+	size_t end_{0};
+	std::vector<uint8_t> buffer_;
+	uint8_t *src_{nullptr};
+	uint8_t *dst_{nullptr};
+	size_t copy_size_{0};
+	std::string filename_;
+	fs::File file_;
+	size_t file_size_{0};
+	mbedtls_sha256_context sha256_;
+	mbedtls_aes_context aes_;
+	std::array<uint8_t, 16> iv_{};
+	std::array<uint8_t, CBOR_BUFFER_SIZE> cbor_;
+	size_t cbor_len_{0};
+	bool scratch_ok_{false};
+};
+
+Runner::Runner(Suite suite) : filename_(uuid::read_flash_string(F("/bench.tmp"))) {
+	mbedtls_sha256_init(&sha256_);
+	mbedtls_aes_init(&aes_);
+
+	if (suite == Suite::ALL || suite == Suite::FLASH)
+		add_flash();
+
+	if (suite == Suite::ALL || suite == Suite::MEMORY)
+		add_memory();
+
+	if (suite == Suite::ALL || suite == Suite::FILESYSTEM)
+		add_filesystem();
+
+	if (suite == Suite::ALL || suite == Suite::CRYPTO)
+		add_crypto();
+
+	if (suite == Suite::ALL || suite == Suite::CBOR)
+		add_cbor();
+}
+
+Runner::~Runner() {
+	if (running_ && tests_[index_].teardown)
+		tests_[index_].teardown();
+
+	free_copy();
+	file_.close();
+	filesystem_cache::bypass(false);
+
+	if (FS.exists(filename_.c_str()))
+		FS.remove(filename_.c_str());
+
+	mbedtls_sha256_free(&sha256_);
+	mbedtls_aes_free(&aes_);
+}
+
+void Runner::add(const __FlashStringHelper *name, std::function<bool(Shell &shell)> setup,
+		Step step, std::function<void()> teardown, bool show_ops) {
+	tests_.push_back({name, std::move(setup), std::move(step), std::move(teardown), show_ops});
+}
+
+void Runner::add_flash() {
+	add(F("Flash read"), [this] (Shell &shell) {
+		partition_ = esp_ota_get_running_partition();
+		offset_ = 0;
+		end_ = std::min((size_t)partition_->size, FLASH_READ_SIZE);
+		buffer_.resize(CHUNK_SIZE);
+		return true;
+	}, [this] () -> long {
+		if (offset_ >= end_)
+			offset_ = 0;
+
+		if (esp_partition_read(partition_, offset_, buffer_.data(), CHUNK_SIZE))
+			return -1;
+
+		offset_ += CHUNK_SIZE;
+		return CHUNK_SIZE;
+	});
+
+	add(F("Flash write"), [this] (Shell &shell) {
+		if (!find_scratch(shell))
+			return false;
+
+		std::fill(buffer_.begin(), buffer_.end(), 0x5A);
+		return true;
+	}, [this] () -> long {
+		if (offset_ >= end_)
+			return 0;
+
+		if (esp_partition_write(partition_, offset_, buffer_.data(), CHUNK_SIZE))
+			return -1;
+
+		offset_ += CHUNK_SIZE;
+		return CHUNK_SIZE;
+	});
+
+	/* Leaves the scratch area erased */
+	add(F("Flash erase"), [this] (Shell &shell) {
+		return find_scratch(shell);
+	}, [this] () -> long {
+		if (offset_ >= end_)
+			return 0;
+
+		if (esp_partition_erase_range(partition_, offset_, SPI_FLASH_SEC_SIZE))
+			return -1;
+
+		offset_ += SPI_FLASH_SEC_SIZE;
+		return SPI_FLASH_SEC_SIZE;
+	});
+}
+
+/*
+ * Use the end of the next OTA partition if it's already erased or isn't
+ * used by the image in that partition.
+ */
+bool Runner::find_scratch(Shell &shell) {
+	partition_ = esp_ota_get_next_update_partition(nullptr);
+	buffer_.resize(CHUNK_SIZE);
+
+	if (!partition_ || partition_->size < FLASH_SCRATCH_SIZE) {
+		shell.println(F("No OTA partition for flash write/erase tests"));
+		return false;
+	}
+
+	offset_ = partition_->size - FLASH_SCRATCH_SIZE;
+	end_ = partition_->size;
+
+	if (scratch_ok_)
+		return true;
+
+	bool erased = true;
+
+	for (size_t offset = offset_; erased && offset < end_; offset += CHUNK_SIZE) {
+		if (esp_partition_read(partition_, offset, buffer_.data(), CHUNK_SIZE))
+			return false;
+
+		erased = std::all_of(buffer_.begin(), buffer_.end(),
+			[] (uint8_t value) { return value == 0xFF; });
+	}
+
+	if (erased) {
+		scratch_ok_ = true;
+		return true;
+	}
+
+	/* Don't overwrite a partial image (which may be resumed) */
+	esp_partition_pos_t pos{partition_->address, partition_->size};
+	esp_image_metadata_t data{};
+
+	if (esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &pos, &data) != ESP_OK
+			|| data.image_len > offset_) {
+		shell.printfln(F("No unused space in OTA partition %s for flash write/erase tests"),
+			partition_->label);
+		return false;
+	}
+
+	scratch_ok_ = esp_partition_erase_range(partition_, offset_, FLASH_SCRATCH_SIZE) == ESP_OK;
+	return scratch_ok_;
+}
+
+void Runner::add_memory() {
+	auto copy = [this] () -> long {
+		std::memcpy(dst_, src_, copy_size_);
+		return copy_size_;
+	};
+
+	add(F("Copy internal to internal"), [this] (Shell &shell) {
+		return allocate_copy(MALLOC_CAP_INTERNAL, MALLOC_CAP_INTERNAL, INTERNAL_COPY_SIZE);
+	}, copy, [this] { free_copy(); });
+
+	add(F("Copy PSRAM to PSRAM"), [this] (Shell &shell) {
+		return allocate_copy(MALLOC_CAP_SPIRAM, MALLOC_CAP_SPIRAM, PSRAM_COPY_SIZE);
+	}, copy, [this] { free_copy(); });
+
+	add(F("Copy PSRAM to internal"), [this] (Shell &shell) {
+		return allocate_copy(MALLOC_CAP_SPIRAM, MALLOC_CAP_INTERNAL, INTERNAL_COPY_SIZE);
+	}, copy, [this] { free_copy(); });
+
+	add(F("Copy internal to PSRAM"), [this] (Shell &shell) {
+		return allocate_copy(MALLOC_CAP_INTERNAL, MALLOC_CAP_SPIRAM, INTERNAL_COPY_SIZE);
+	}, copy, [this] { free_copy(); });
+}
+
+bool Runner::allocate_copy(uint32_t src_caps, uint32_t dst_caps, size_t size) {
+	src_ = static_cast<uint8_t *>(heap_caps_malloc(size, src_caps | MALLOC_CAP_8BIT));
+	dst_ = static_cast<uint8_t *>(heap_caps_malloc(size, dst_caps | MALLOC_CAP_8BIT));
+	copy_size_ = size;
+
+	if (!src_ || !dst_) {
+		free_copy();
+		return false;
+	}
+
+	std::memset(src_, 0xA5, size);
+	return true;
+}
+
+void Runner::free_copy() {
+	heap_caps_free(src_);
+	heap_caps_free(dst_);
+	src_ = nullptr;
+	dst_ = nullptr;
+}
+
+void Runner::add_filesystem() {
+	add(F("FS sequential write"), [this] (Shell &shell) {
+		const char mode[2] = { 'w', '\0' };
+
+		file_size_ = std::min(FS_FILE_SIZE, (FS.totalBytes() - FS.usedBytes()) / 2);
+		file_size_ -= file_size_ % CHUNK_SIZE;
+
+		if (file_size_ < CHUNK_SIZE) {
+			shell.println(F("Not enough free space for filesystem tests"));
+			return false;
+		}
+
+		file_ = FS.open(filename_.c_str(), mode);
+		buffer_.assign(CHUNK_SIZE, 0x5A);
+		offset_ = 0;
+		return (bool)file_;
+	}, [this] () -> long {
+		if (offset_ >= file_size_) {
+			/* Include the time to flush the file */
+			file_.close();
+			return 0;
+		}
+
+		if (file_.write(buffer_.data(), CHUNK_SIZE) != CHUNK_SIZE)
+			return -1;
+
+		offset_ += CHUNK_SIZE;
+		return CHUNK_SIZE;
+	}, [this] {
+		/* The test may have been stopped by the time limit before the end */
+		file_.close();
+		file_size_ = offset_;
+	});
+
+	for (bool cached : {true, false}) {
+		add(cached ? F("FS sequential read (cached)") : F("FS sequential read (uncached)"),
+				[this, cached] (Shell &shell) {
+			return open_file(cached);
+		}, [this] () -> long {
+			if (offset_ >= file_size_)
+				offset_ = 0;
+
+			long len = read_file(offset_, CHUNK_SIZE);
+
+			offset_ += CHUNK_SIZE;
+			return len;
+		}, [this] { file_.close(); filesystem_cache::bypass(false); });
+
+		add(cached ? F("FS random read (cached)") : F("FS random read (uncached)"),
+				[this, cached] (Shell &shell) {
+			return open_file(cached);
+		}, [this] () -> long {
+			size_t blocks = file_size_ / FS_RANDOM_READ_SIZE;
+
+			return read_file((esp_random() % blocks) * FS_RANDOM_READ_SIZE, FS_RANDOM_READ_SIZE);
+		}, [this] { file_.close(); filesystem_cache::bypass(false); }, true);
+	}
+}
+
+bool Runner::open_file(bool cached) {
+	const char mode[2] = { 'r', '\0' };
+
+	if (!file_size_)
+		return false;
+
+	filesystem_cache::bypass(!cached);
+	file_ = FS.open(filename_.c_str(), mode);
+	buffer_.resize(CHUNK_SIZE);
+	offset_ = 0;
+	return (bool)file_;
+}
+
+long Runner::read_file(size_t offset, size_t len) {
+	if (file_.position() != offset && !file_.seek(offset))
+		return -1;
+
+	if (file_.read(buffer_.data(), len) != len)
+		return -1;
+
+	return len;
+}
+
+void Runner::add_crypto() {
+	add(F("SHA-256"), [this] (Shell &shell) {
+		buffer_.assign(CHUNK_SIZE, 0x5A);
+		return mbedtls_sha256_starts_ret(&sha256_, 0) == 0;
+	}, [this] () -> long {
+		if (mbedtls_sha256_update_ret(&sha256_, buffer_.data(), CHUNK_SIZE))
+			return -1;
+
+		return CHUNK_SIZE;
+	}, [this] {
+		std::array<uint8_t, 32> digest;
+
+		mbedtls_sha256_finish_ret(&sha256_, digest.data());
+	});
+
+	add(F("AES-128-CBC encrypt"), [this] (Shell &shell) {
+		std::array<uint8_t, 16> key;
+
+		esp_fill_random(key.data(), key.size());
+		esp_fill_random(iv_.data(), iv_.size());
+		buffer_.assign(CHUNK_SIZE, 0x5A);
+		return mbedtls_aes_setkey_enc(&aes_, key.data(), key.size() * 8) == 0;
+	}, [this] () -> long {
+		if (mbedtls_aes_crypt_cbc(&aes_, MBEDTLS_AES_ENCRYPT, CHUNK_SIZE,
+				iv_.data(), buffer_.data(), buffer_.data()))
+			return -1;
+
+		return CHUNK_SIZE;
+	});
+}
+
+/* A map similar to the config file */
+long Runner::encode_cbor() {
+	BufferPrint print{cbor_.data(), cbor_.size()};
+	cbor::Writer writer{print};
+
+	writer.writeTag(cbor::kSelfDescribeTag);
+	writer.beginMap(CBOR_MAP_ENTRIES);
+
+	for (size_t i = 0; i < CBOR_MAP_ENTRIES; i++) {
+		std::array<char, 8> key;
+
+		::snprintf(key.data(), key.size(), "key%zu", i);
+		write_text(writer, key.data());
+
+		if (i % 2) {
+			write_text(writer, "value");
+		} else {
+			writer.writeUnsignedInt(i * 1000);
+		}
+	}
+
+	if (print.getWriteError())
+		return -1;
+
+	cbor_len_ = print.length();
+	return cbor_len_;
+}
+
+void Runner::add_cbor() {
+	add(F("CBOR encode"), nullptr, [this] () -> long {
+		return encode_cbor();
+	}, nullptr, true);
+
+	add(F("CBOR decode"), [this] (Shell &shell) {
+		return encode_cbor() > 0;
+	}, [this] () -> long {
+		cbor::BytesStream stream{cbor_.data(), cbor_len_};
+		cbor::Reader reader{stream};
+		uint64_t length;
+		bool indefinite;
+
+		if (!cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag)
+				|| !cbor::expectMap(reader, &length, &indefinite) || indefinite)
+			return -1;
+
+		for (size_t i = 0; i < length; i++) {
+			std::string key;
+			std::string text;
+			uint64_t value;
+
+			if (!read_text(reader, key))
+				return -1;
+
+			if (i % 2) {
+				if (!read_text(reader, text))
+					return -1;
+			} else if (!cbor::expectUnsignedInt(reader, &value)) {
+				return -1;
+			}
+		}
+
+		return cbor_len_;
+	}, nullptr, true);
+}
+
+bool Runner::loop(Shell &shell, bool stop) {
+	if (stop) {
+		shell.println(F("Interrupted"));
+		return true;
+	}
+
+	uint64_t step_start_us = esp_timer_get_time();
+
+	while (esp_timer_get_time() - step_start_us < STEP_TIME_US) {
+		if (!running_) {
+			if (index_ >= tests_.size())
+				break;
+
+			Test &test = tests_[index_];
+
+			results_.push_back({test.name});
+			results_.back().show_ops = test.show_ops;
+
+			if (test.setup && !test.setup(shell)) {
+				end_test(shell, Result::State::SKIPPED);
+				continue;
+			}
+
+			running_ = true;
+			start_us_ = esp_timer_get_time();
+		}
+
+		Result &result = results_.back();
+		uint64_t start_us = esp_timer_get_time();
+		long bytes = tests_[index_].step();
+
+		if (bytes < 0) {
+			end_test(shell, Result::State::FAILED);
+		} else if (bytes == 0) {
+			end_test(shell, Result::State::OK);
+		} else {
+			result.us += esp_timer_get_time() - start_us;
+			result.bytes += bytes;
+			result.ops++;
+
+			if (result.us >= TEST_TIME_US || esp_timer_get_time() - start_us_ >= 2 * TEST_TIME_US)
+				end_test(shell, Result::State::OK);
+		}
+	}
+
+	if (index_ < tests_.size())
+		return false;
+
+	shell.println();
+	shell.println(F("Test                            Rate"));
+
+	for (const auto &result : results_)
+		print(shell, result);
+
+	return true;
+}
+
+void Runner::end_test(Shell &shell, Result::State state) {
+	Test &test = tests_[index_];
+
+	if (running_ && test.teardown)
+		test.teardown();
+
+	running_ = false;
+	results_.back().state = state;
+	print(shell, results_.back());
+	index_++;
+}
+
+void Runner::print(Shell &shell, const Result &result) {
+	std::string name = uuid::read_flash_string(result.name);
+
+	if (result.state == Result::State::SKIPPED) {
+		shell.printfln(F("%-30s  skipped"), name.c_str());
+	} else if (result.state == Result::State::FAILED || !result.us) {
+		shell.printfln(F("%-30s  failed"), name.c_str());
+	} else if (result.show_ops) {
+		shell.printfln(F("%-30s  %8lu op/s  %8lu KiB/s"), name.c_str(),
+			(unsigned long)(result.ops * 1000000ULL / result.us),
+			(unsigned long)(result.bytes * 1000000ULL / 1024 / result.us));
+	} else {
+		shell.printfln(F("%-30s  %8lu KiB/s"), name.c_str(),
+			(unsigned long)(result.bytes * 1000000ULL / 1024 / result.us));
+	}
+}
+
+void run(Shell &shell, Suite suite) {
+	auto runner = std::make_shared<Runner>(suite);
+
+	shell.block_with([runner] (Shell &shell, bool stop) -> bool {
+		return runner->loop(shell, stop);
+	});
+}
+
+} // namespace benchmark
+
+} // namespace app
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+
+#include <uuid/console.h>
+
+namespace app {
+
+/*
+ * Measure the performance of flash, memory, the filesystem, crypto and
+ * CBOR on the current board.
+ *
+ * Each test runs for up to a second in short steps while the shell is
+ * blocked, so that the rest of the application keeps running. Flash
+ * writes use the unused space at the end of the next OTA partition and
+ * are skipped if there isn't enough.
+ */
+namespace benchmark {
+
+enum class Suite : uint8_t {
+	ALL,
+	FLASH,
+	MEMORY,
+	FILESYSTEM,
+	CRYPTO,
+	CBOR,
+};
+
+void run(uuid::console::Shell &shell, Suite suite);
+
+} // namespace benchmark
+
+} // namespace app
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "app/command_arena.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <uuid/console.h>
+
+#include "app/allocator.h"
+
+namespace app {
+
+static unsigned long total_commands;
+static unsigned long total_allocations;
+static unsigned long long total_bytes;
+static unsigned long overflow_blocks;
+static size_t peak_used;
+
+/* Count the length of printed output without storing it */
+class LengthPrint: public ::Print {
+public:
+	size_t write(uint8_t data) override {
+		length_++;
+		return 1;
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		length_ += size;
+		return size;
+	}
+
+	inline size_t length() const { return length_; }
+
+private:
+	size_t length_{0};
+};
+
+class BufferPrint: public ::Print {
+public:
+	BufferPrint(char *buffer, size_t size) : buffer_(buffer), size_(size) {}
+
+	size_t write(uint8_t data) override {
+		return write(&data, 1);
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		size = std::min(size, size_ - length_);
+		std::memcpy(&buffer_[length_], buffer, size);
+		length_ += size;
+		return size;
+	}
+
+	inline size_t length() const { return length_; }
+
+private:
+	char *buffer_;
+	size_t size_;
+	size_t length_{0};
+};
+
+CommandArena::~CommandArena() {
+	reset();
+
+	if (blocks_)
+		allocator::deallocate(allocator::Subsystem::COMMAND, blocks_, sizeof(Block) + blocks_->size);
+}
+
+bool CommandArena::add_block(size_t size) {
+	Block *block = static_cast<Block *>(allocator::allocate(allocator::Subsystem::COMMAND,
+		sizeof(Block) + size));
+
+	if (!block)
+		return false;
+
+	if (blocks_)
+		overflow_blocks++;
+
+	block->next = blocks_;
+	block->size = size;
+	blocks_ = block;
+	pos_ = data(block);
+	end_ = pos_ + size;
+	return true;
+}
+
+void *CommandArena::allocate(size_t size, size_t align) {
+	uintptr_t start = (reinterpret_cast<uintptr_t>(pos_) + align - 1) & ~(uintptr_t)(align - 1);
+
+	if (!pos_ || start + size > reinterpret_cast<uintptr_t>(end_)) {
+		if (!add_block(std::max(size + align, (size_t)APP_COMMAND_ARENA_SIZE)))
+			return nullptr;
+
+		start = (reinterpret_cast<uintptr_t>(pos_) + align - 1) & ~(uintptr_t)(align - 1);
+	}
+
+	void *ptr = reinterpret_cast<void *>(start);
+
+	used_ += start + size - reinterpret_cast<uintptr_t>(pos_);
+	pos_ = reinterpret_cast<uint8_t *>(start + size);
+	allocations_++;
+	return ptr;
+}
+
+const char *CommandArena::flash_string(const __FlashStringHelper *text) {
+	size_t len = strlen_P(reinterpret_cast<PGM_P>(text));
+	char *str = static_cast<char *>(allocate(len + 1, 1));
+
+	if (!str)
+		return "";
+
+	strncpy_P(str, reinterpret_cast<PGM_P>(text), len);
+	str[len] = '\0';
+	return str;
+}
+
+const char *CommandArena::printable_to_string(const Printable &printable) {
+	LengthPrint length;
+
+	printable.printTo(length);
+
+	char *str = static_cast<char *>(allocate(length.length() + 1, 1));
+
+	if (!str)
+		return "";
+
+	BufferPrint buffer{str, length.length()};
+
+	printable.printTo(buffer);
+	str[buffer.length()] = '\0';
+	return str;
+}
+
+const char *CommandArena::hex_string(const uint8_t *buf, size_t len) {
+	char *str = static_cast<char *>(allocate(2 * len + 1, 1));
+
+	if (!str)
+		return "";
+
+	for (size_t i = 0; i < len; i++)
+		::snprintf_P(&str[i * 2], 3, PSTR("%02x"), buf[i]);
+
+	str[2 * len] = '\0';
+	return str;
+}
+
+const char *CommandArena::null_terminated_string(const char *data, size_t size) {
+	const char *found = static_cast<const char *>(std::memchr(data, '\0', size));
+	size_t len = found ? (found - data) : size;
+	char *str = static_cast<char *>(allocate(len + 1, 1));
+
+	if (!str)
+		return "";
+
+	std::memcpy(str, data, len);
+	str[len] = '\0';
+	return str;
+}
+
+void CommandArena::reset() {
+	if (allocations_) {
+		total_commands++;
+		total_allocations += allocations_;
+		total_bytes += used_;
+		peak_used = std::max(peak_used, used_);
+	}
+
+	/* Keep the first block */
+	while (blocks_ && blocks_->next) {
+		Block *block = blocks_;
+
+		blocks_ = block->next;
+		allocator::deallocate(allocator::Subsystem::COMMAND, block, sizeof(Block) + block->size);
+	}
+
+	if (blocks_) {
+		pos_ = data(blocks_);
+		end_ = pos_ + blocks_->size;
+	}
+
+	used_ = 0;
+	allocations_ = 0;
+}
+
+void CommandArena::show(uuid::console::Shell &shell) {
+	shell.printfln(F("Command arena: %lu commands, %lu allocations (%llu bytes), peak %zu bytes, %lu overflow blocks"),
+		total_commands, total_allocations, total_bytes, peak_used, overflow_blocks);
+}
+
+} // namespace app
@@ -0,0 +1,96 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <uuid/console.h>
+
+/* Size of the block kept by each console session for command data */
+#ifndef APP_COMMAND_ARENA_SIZE
+# if defined(ARDUINO_ARCH_ESP8266)
+#  define APP_COMMAND_ARENA_SIZE 256
+# else
+#  define APP_COMMAND_ARENA_SIZE 1024
+# endif
+#endif
+
+namespace app {
+
+/*
+ * Bump allocator for temporary data (mostly strings for output) used while
+ * running a console command. Everything is released at once when the
+ * command (and anything it blocks the shell with) has finished, which is
+ * when the next prompt is displayed or a command channel request completes.
+ *
+ * The first block is kept for the next command. Anything that doesn't fit
+ * is allocated in additional blocks that are freed on reset.
+ *
+ * Returned strings are only valid until the command finishes and must not
+ * be stored anywhere that outlives it.
+ */
+class CommandArena {
+public:
+	CommandArena() = default;
+	~CommandArena();
+
+	CommandArena(const CommandArena&) = delete;
+	CommandArena& operator=(const CommandArena&) = delete;
+
+	static void show(uuid::console::Shell &shell);
+
+	/* Returns nullptr if there's no memory */
+	void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+	/* These return an empty string if there's no memory */
+	const char *flash_string(const __FlashStringHelper *text);
+	const char *printable_to_string(const Printable &printable);
+	const char *hex_string(const uint8_t *buf, size_t len);
+	const char *null_terminated_string(const char *data, size_t size);
+
+	template<size_t size>
+	inline const char *null_terminated_string(const char(&data)[size]) {
+		return null_terminated_string(&data[0], size);
+	}
+
+	void reset();
+
+private:
+	struct Block {
+		Block *next;
+		size_t size;
+	};
+
+	bool add_block(size_t size);
+	inline uint8_t *data(Block *block) { return reinterpret_cast<uint8_t *>(block + 1); }
+
+	Block *blocks_{nullptr};
+	uint8_t *pos_{nullptr};
+	uint8_t *end_{nullptr};
+	size_t used_{0};
+	unsigned long allocations_{0};
+};
+
+/* The arena for the command running on a shell */
+CommandArena &command_arena(uuid::console::Shell &shell);
+
+} // namespace app
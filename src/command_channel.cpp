@@ -0,0 +1,267 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENV_NATIVE
+#include "app/command_channel.h"
+
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP8266
+# include <ESP8266WiFi.h>
+#else
+# include <WiFi.h>
+#endif
+
+#include <array>
+#include <memory>
+#include <string>
+
+#include <uuid/common.h>
+#include <uuid/log.h>
+
+#include "app/app.h"
+#include "app/config.h"
+#include "app/console.h"
+#include "app/console_stream.h"
+#include "app/pstr.h"
+#include "app/util.h"
+
+MAKE_PSTR(logger_name, "cmd")
+
+namespace app {
+
+/*
+ * While a command is running, the input is at end of transmission so that
+ * anything waiting for input finishes and the shell reports when it's idle.
+ */
+class CommandChannel::OutputStream: public Stream {
+public:
+	int available() override { return end_of_input_ ? 1 : 0; }
+	int read() override { return end_of_input_ ? '\x04' : -1; }
+	int peek() override { return read(); }
+
+	void end_of_input(bool state) { end_of_input_ = state; }
+
+	size_t write(uint8_t c) override {
+		text_.push_back(c);
+		return 1;
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		text_.append(reinterpret_cast<const char *>(buffer), size);
+		return size;
+	}
+
+	std::string take() {
+		std::string text;
+
+		text.swap(text_);
+		return text;
+	}
+
+private:
+	std::string text_;
+	bool end_of_input_{false};
+};
+
+uuid::log::Logger CommandChannel::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+CommandChannel::CommandChannel(App &app) : app_(app), server_(DEFAULT_PORT) {
+
+}
+
+void CommandChannel::start() {
+	server_.begin();
+	logger_.info(F("Listening on port %u"), DEFAULT_PORT);
+}
+
+void CommandChannel::loop() {
+	WiFiClient client = server_.available();
+
+	if (client) {
+		if (sessions_.size() >= MAX_SESSIONS) {
+			logger_.warning(F("Rejected connection from [%s]:%u (too many sessions)"),
+				uuid::printable_to_string(client.remoteIP()).c_str(), client.remotePort());
+			client.stop();
+		} else {
+			client.setNoDelay(true);
+			sessions_.emplace_back(app_, std::move(client), next_id_++);
+		}
+	}
+
+	for (auto it = sessions_.begin(); it != sessions_.end(); ) {
+		if (it->loop()) {
+			it++;
+		} else {
+			it = sessions_.erase(it);
+		}
+	}
+}
+
+CommandChannel::Session::Session(App &app, WiFiClient &&client, size_t id)
+		: client_(std::move(client)) {
+	std::array<char, 16> text;
+
+	snprintf_P(text.data(), text.size(), PSTR("cmd%zu"), id);
+	name_ = text.data();
+
+	output_ = std::make_unique<OutputStream>();
+	shell_ = std::make_shared<AppBatchConsole>(app, *output_, name_);
+	shell_->start();
+	shell_->log_level(uuid::log::Level::OFF);
+	output_->take();
+
+	logger_.info(F("Allocated session %s for connection from [%s]:%u"),
+		name_.c_str(), uuid::printable_to_string(client_.remoteIP()).c_str(), client_.remotePort());
+}
+
+CommandChannel::Session::~Session() {
+	logger_.info(F("Closed session %s"), name_.c_str());
+	client_.stop();
+}
+
+/*
+ * The shell is looped by uuid::console::Shell::loop_all() so it keeps
+ * running anything that a command blocked it with. The session can't be
+ * removed until the shell has stopped because it owns the shell's stream.
+ */
+bool CommandChannel::Session::loop() {
+	if (!shell_->running()) {
+		if (busy_)
+			finish();
+
+		pending_.clear();
+		client_.stop();
+		return false;
+	}
+
+	receive();
+
+	if (busy_ && shell_->idle())
+		finish();
+
+	if (auth_delay_ms_ && uuid::get_uptime_ms() >= auth_delay_ms_) {
+		auth_delay_ms_ = 0;
+		respond(id_, false, uuid::read_flash_string(F("su: incorrect password")));
+	}
+
+	for (size_t i = 0; i < MAX_COMMANDS_PER_LOOP && !busy_ && !auth_delay_ms_ && !pending_.empty(); i++) {
+		execute(pending_.front());
+		pending_.pop_front();
+	}
+
+	if (!client_.connected() && !client_.available() && pending_.empty() && !busy_)
+		shell_->stop();
+
+	return true;
+}
+
+void CommandChannel::Session::receive() {
+	while (pending_.size() < MAX_PENDING) {
+		int c = client_.read();
+
+		if (c < 0)
+			break;
+
+		if (c == '\r') {
+			continue;
+		} else if (c != '\n') {
+			if (rx_.length() < MAX_LINE_LENGTH) {
+				rx_.push_back(c);
+			} else {
+				overflow_ = true;
+			}
+			continue;
+		}
+
+		std::string line;
+		line.swap(rx_);
+
+		size_t pos = line.find(' ');
+		Request request{line.substr(0, pos),
+			pos == std::string::npos ? std::string{} : line.substr(pos + 1)};
+
+		if (request.id.empty() || request.id.length() > MAX_ID_LENGTH) {
+			respond(std::string{'-'}, false, uuid::read_flash_string(F("Invalid request ID")));
+		} else if (overflow_) {
+			respond(request.id, false, uuid::read_flash_string(F("Request too long")));
+		} else {
+			pending_.push_back(std::move(request));
+		}
+
+		overflow_ = false;
+	}
+}
+
+void CommandChannel::Session::execute(const Request &request) {
+	auto &shell = *shell_;
+	const std::string su = uuid::read_flash_string(F("su"));
+
+	if (request.line == su || request.line.compare(0, su.length() + 1, su + ' ') == 0) {
+		std::string password = request.line.length() > su.length()
+			? request.line.substr(su.length() + 1) : std::string{};
+
+		if (!password.empty() && password_equal(password, Config().admin_password())) {
+			shell.logger().log(uuid::log::Level::NOTICE, uuid::log::Facility::AUTH,
+				F("Admin session opened on console %s"), name_.c_str());
+			shell.add_flags(CommandFlags::ADMIN);
+			respond(request.id, true, {});
+		} else {
+			shell.logger().log(uuid::log::Level::NOTICE, uuid::log::Facility::AUTH,
+				F("Invalid admin password on console %s"), name_.c_str());
+			id_ = request.id;
+			auth_delay_ms_ = uuid::get_uptime_ms() + AppShell::INVALID_PASSWORD_DELAY_MS;
+		}
+		return;
+	}
+
+	if (request.line.empty()) {
+		respond(request.id, true, {});
+		return;
+	}
+
+	auto error = shell.execute(request.line);
+
+	if (error)
+		shell.println(error);
+
+	id_ = request.id;
+	ok_ = !error;
+	busy_ = true;
+	output_->end_of_input(true);
+}
+
+/* The command and anything it blocked the shell with has finished */
+void CommandChannel::Session::finish() {
+	output_->end_of_input(false);
+	busy_ = false;
+	respond(id_, ok_, output_->take());
+}
+
+void CommandChannel::Session::respond(const std::string &id, bool ok, const std::string &output) {
+	std::array<char, MAX_ID_LENGTH + 32> header;
+
+	int len = snprintf_P(header.data(), header.size(), PSTR("%s %s %zu\n"),
+		id.c_str(), ok ? "ok" : "error", output.length());
+
+	client_.write(reinterpret_cast<const uint8_t *>(header.data()), len);
+	client_.write(reinterpret_cast<const uint8_t *>(output.data()), output.length());
+}
+
+} // namespace app
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef ENV_NATIVE
+
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP8266
+# include <ESP8266WiFi.h>
+#else
+# include <WiFi.h>
+#endif
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+
+#include <uuid/log.h>
+
+#ifndef APP_COMMAND_PORT
+# define APP_COMMAND_PORT 2323
+#endif
+
+namespace app {
+
+class App;
+class AppBatchConsole;
+
+/*
+ * Non-interactive command protocol for automation.
+ *
+ * Requests are single lines of the form "<id> <command line>" and can be
+ * sent without waiting for a response. They're executed in order and each
+ * one produces a response header line of "<id> <status> <length>" followed
+ * by exactly <length> bytes of command output. The status is "ok" or
+ * "error" (in which case the output is the error message).
+ *
+ * Sessions start without admin access; a request of "<id> su <password>"
+ * grants it. After an incorrect password, the response and any further
+ * requests are delayed in the same way as the console. Commands that block the shell run to completion before their
+ * response is sent. There is no input, so commands that prompt for input
+ * see the end of input immediately.
+ */
+class CommandChannel {
+public:
+	static constexpr uint16_t DEFAULT_PORT = APP_COMMAND_PORT;
+
+	explicit CommandChannel(App &app);
+
+	void start();
+	void loop();
+
+	size_t sessions() const { return sessions_.size(); }
+
+private:
+	static constexpr size_t MAX_SESSIONS = 4;
+	static constexpr size_t MAX_PENDING = 64;
+	static constexpr size_t MAX_LINE_LENGTH = 512;
+	static constexpr size_t MAX_ID_LENGTH = 32;
+	static constexpr size_t MAX_COMMANDS_PER_LOOP = 1;
+
+	class OutputStream;
+
+	class Session {
+	public:
+		Session(App &app, WiFiClient &&client, size_t id);
+		~Session();
+
+		bool loop();
+
+	private:
+		struct Request {
+			std::string id;
+			std::string line;
+		};
+
+		void receive();
+		void execute(const Request &request);
+		void finish();
+		void respond(const std::string &id, bool ok, const std::string &output);
+
+		WiFiClient client_;
+		std::string name_;
+		std::string rx_;
+		std::deque<Request> pending_;
+		std::unique_ptr<OutputStream> output_;
+		std::shared_ptr<AppBatchConsole> shell_;
+		std::string id_;
+		bool ok_{false};
+		bool busy_{false};
+		uint64_t auth_delay_ms_{0}; /* Response to a failed "su" is delayed until then */
+		bool overflow_{false};
+	};
+
+	static uuid::log::Logger logger_;
+
+	App &app_;
+	WiFiServer server_;
+	std::list<Session> sessions_;
+	size_t next_id_{0};
+};
+
+} // namespace app
+
+#endif
@@ -36,14 +36,10 @@
 
 #include "app/app.h"
 #include "app/fs.h"
+#include "app/pstr.h"
+#include "app/resolver.h"
 #include "app/util.h"
 
-#ifndef PSTR_ALIGN
-# define PSTR_ALIGN 4
-#endif
-
-#define MAKE_PSTR(string_name, string_literal) static const char __pstr__##string_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = string_literal;
-
 namespace cbor = qindesign::cbor;
 
 namespace app {
@@ -55,7 +51,7 @@ namespace app {
 # define WRITE_LOCK() do { } while (0)
 #endif
 
-#ifdef ARDUINO_ARCH_ESP8266
+#ifndef ENV_NATIVE
 # define MCU_APP_INTERNAL_CONFIG_DATA_OTA \
 		MCU_APP_CONFIG_PRIMITIVE(bool, "", ota_enabled, "", true) \
 		MCU_APP_CONFIG_SIMPLE(std::string, "", ota_password, "", "")
@@ -225,6 +221,40 @@ void Config::write_config(cbor::Writer &writer) {
 #undef MCU_APP_CONFIG_ENUM
 }
 
+/* Create a copy of the member data for transactions */
+#define MCU_APP_CONFIG_ENUM MCU_APP_CONFIG_GENERIC
+#define MCU_APP_CONFIG_GENERIC(__type, __key_prefix, __name, __key_suffix, __read_default, ...) \
+		__type __name;
+
+struct Config::Snapshot {
+	MCU_APP_INTERNAL_CONFIG_DATA
+};
+
+#undef MCU_APP_CONFIG_GENERIC
+
+void Config::save(Snapshot &snapshot) const {
+	READ_LOCK();
+
+#define MCU_APP_CONFIG_GENERIC(__type, __key_prefix, __name, __key_suffix, __read_default, ...) \
+		snapshot.__name = __name##_;
+
+	MCU_APP_INTERNAL_CONFIG_DATA
+
+#undef MCU_APP_CONFIG_GENERIC
+}
+
+void Config::restore(const Snapshot &snapshot) {
+	WRITE_LOCK();
+
+#define MCU_APP_CONFIG_GENERIC(__type, __key_prefix, __name, __key_suffix, __read_default, ...) \
+		__name##_ = snapshot.__name;
+
+	MCU_APP_INTERNAL_CONFIG_DATA
+
+#undef MCU_APP_CONFIG_GENERIC
+}
+
+#undef MCU_APP_CONFIG_ENUM
 #undef MCU_APP_CONFIG_SIMPLE
 #undef MCU_APP_CONFIG_PRIMITIVE
 #undef MCU_APP_CONFIG_CUSTOM
@@ -266,14 +296,15 @@ MCU_APP_INTERNAL_CONFIG_DATA
 #undef MCU_APP_CONFIG_CUSTOM
 #undef MCU_APP_CONFIG_ENUM
 
-static const char __pstr__config_filename[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "/config.cbor";
-static const char __pstr__config_backup_filename[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "/config.cbor~";
+MAKE_PSTR(config_filename, "/config.cbor")
+MAKE_PSTR(config_backup_filename, "/config.cbor~")
 
-static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "config";
+MAKE_PSTR(logger_name, "config")
 uuid::log::Logger Config::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
 
 bool Config::unavailable_ = false;
 bool Config::loaded_ = false;
+std::unique_ptr<Config::Snapshot> Config::transaction_;
 
 Config::Config(bool load) {
 	if (!loaded_) {
@@ -299,7 +330,8 @@ void Config::syslog_host(const std::string &syslog_host) {
 #ifndef ENV_NATIVE
 	IPAddress addr;
 
-	if (addr.fromString(syslog_host.c_str())) {
+	if (addr.fromString(syslog_host.c_str())
+			|| Resolver::valid_hostname(syslog_host)) {
 		syslog_host_= syslog_host;
 	} else {
 		syslog_host_.clear();
@@ -308,6 +340,11 @@ void Config::syslog_host(const std::string &syslog_host) {
 }
 
 void Config::commit() {
+	if (transaction_) {
+		logger_.debug(F("Deferring config commit until end of transaction"));
+		return;
+	}
+
 	std::string filename = uuid::read_flash_string(FPSTR(__pstr__config_filename));
 	std::string backup_filename = uuid::read_flash_string(FPSTR(__pstr__config_backup_filename));
 
@@ -318,6 +355,58 @@ void Config::commit() {
 	}
 }
 
+bool Config::in_transaction() {
+	return (bool)transaction_;
+}
+
+bool Config::begin_transaction() {
+	if (transaction_)
+		return false;
+
+	transaction_ = std::make_unique<Snapshot>();
+	save(*transaction_);
+	logger_.debug(F("Config transaction started"));
+	return true;
+}
+
+bool Config::commit_transaction() {
+	if (!transaction_)
+		return false;
+
+	transaction_.reset();
+	logger_.debug(F("Config transaction committed"));
+	commit();
+	return true;
+}
+
+bool Config::abort_transaction() {
+	if (!transaction_)
+		return false;
+
+	restore(*transaction_);
+	transaction_.reset();
+	logger_.debug(F("Config transaction aborted"));
+	return true;
+}
+
+bool Config::import(Stream &stream) {
+	cbor::Reader reader{stream};
+	Snapshot snapshot;
+
+	save(snapshot);
+
+	if (!cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag)
+			|| !read_config(reader)) {
+		logger_.err(F("Failed to import config"));
+		restore(snapshot);
+		return false;
+	}
+
+	logger_.info(F("Imported config"));
+	commit();
+	return true;
+}
+
 bool Config::read_config(const std::string &filename, bool load) {
 	logger_.info(F("Reading config file %s"), filename.c_str());
 	const char mode[2] = {'r', '\0'};
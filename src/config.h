@@ -23,6 +23,7 @@
 #if MCU_APP_THREAD_SAFE
 # include <shared_mutex>
 #endif
+#include <memory>
 #include <string>
 
 #include <CBOR.h>
@@ -65,7 +66,7 @@ public:
 	std::string ddns_password() const;
 	void ddns_password(const std::string &ddns_password);
 
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 	bool ota_enabled() const;
 	void ota_enabled(bool ota_enabled);
 
@@ -75,7 +76,25 @@ public:
 
 	void commit();
 
+	/*
+	 * While a transaction is in progress, commit() only applies changes
+	 * in memory; the config file is written once by commit_transaction().
+	 */
+	static bool in_transaction();
+	bool begin_transaction();
+	bool commit_transaction();
+	bool abort_transaction();
+
+	/*
+	 * Apply all of the keys in a CBOR config document (in the same format
+	 * as the config file) and then commit. The config is unchanged if the
+	 * document is invalid.
+	 */
+	bool import(Stream &stream);
+
 private:
+	struct Snapshot;
+
 	static uuid::log::Logger logger_;
 
 	static bool unavailable_;
@@ -90,19 +109,22 @@ private:
 	static unsigned long syslog_mark_interval_;
 	static std::string ddns_url_;
 	static std::string ddns_password_;
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 	static bool ota_enabled_;
 	static std::string ota_password_;
 #endif
 #if MCU_APP_THREAD_SAFE
 	static std::shared_mutex data_mutex_;
 #endif
+	static std::unique_ptr<Snapshot> transaction_;
 
 	bool read_config(const std::string &filename, bool load = true);
 	bool read_config(qindesign::cbor::Reader &reader);
 	void read_config_defaults();
 	bool write_config(const std::string &filename);
 	void write_config(qindesign::cbor::Writer &writer);
+	void save(Snapshot &snapshot) const;
+	void restore(const Snapshot &snapshot);
 
 #if __has_include("../../src/config_class.h")
 # include "../../src/config_class.h"
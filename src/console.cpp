@@ -22,11 +22,6 @@
 #include <time.h>
 
 #ifdef ARDUINO_ARCH_ESP32
-# pragma GCC diagnostic push
-# pragma GCC diagnostic ignored "-Wswitch-enum"
-# include <esp_crt_bundle.h>
-# pragma GCC diagnostic pop
-# include <esp_https_ota.h>
 # include <esp_ota_ops.h>
 # include <rom/rtc.h>
 #endif
@@ -40,25 +35,38 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
 #include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <CBOR_streams.h>
 #include <uuid/console.h>
 #include <uuid/log.h>
 
+#include "app/allocator.h"
 #include "app/app.h"
+#include "app/bench.h"
 #include "app/config.h"
 #include "app/console_stream.h"
 #include "app/fs.h"
+#include "app/fs_archive.h"
+#include "app/fs_tree.h"
+#include "app/isr_log.h"
+#include "app/littlefs_block_cache.h"
+#include "app/log_fanout.h"
+#include "app/net_bench.h"
 #include "app/network.h"
+#include "app/ota.h"
+#include "app/profiler.h"
+#include "app/pstr.h"
+#include "app/serial_console.h"
 #include "app/util.h"
 
-#ifndef PSTR_ALIGN
-# define PSTR_ALIGN 4
-#endif
-
 #if defined(ARDUINO_ARCH_ESP32)
 # define CONSOLE_FILESYSTEM_SUPPORTED 1
 #else
@@ -71,34 +79,55 @@ using ::uuid::console::Shell;
 using LogLevel = ::uuid::log::Level;
 using LogFacility = ::uuid::log::Facility;
 
-#define MAKE_PSTR(string_name, string_literal) static const char __pstr__##string_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = string_literal;
-#define MAKE_PSTR_WORD(string_name) MAKE_PSTR(string_name, #string_name)
-#define F_(string_name) FPSTR(__pstr__##string_name)
-
 namespace app {
 
 #pragma GCC diagnostic push
 #ifndef ENV_NATIVE
 # pragma GCC diagnostic error "-Wunused-const-variable"
 #endif
+MAKE_PSTR_WORD(abort)
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(all)
+#endif
 #if !defined(ARDUINO_ARCH_ESP8266)
 MAKE_PSTR_WORD(bad)
 #endif
+MAKE_PSTR_WORD(begin)
+#if !defined(ARDUINO_ARCH_ESP8266)
+MAKE_PSTR_WORD(bench)
+#endif
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(cbor)
+#endif
+#if !defined(ARDUINO_ARCH_ESP8266)
+MAKE_PSTR_WORD(client)
+#endif
+MAKE_PSTR_WORD(commit)
+MAKE_PSTR_WORD(config)
 MAKE_PSTR_WORD(connect)
 MAKE_PSTR_WORD(console)
 #if CONSOLE_FILESYSTEM_SUPPORTED
 MAKE_PSTR_WORD(cp)
 #endif
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(crypto)
+#endif
 MAKE_PSTR_WORD(ddns)
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 MAKE_PSTR_WORD(disabled)
 #endif
 MAKE_PSTR_WORD(disconnect)
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 MAKE_PSTR_WORD(enabled)
 #endif
 MAKE_PSTR_WORD(exit)
 #if CONSOLE_FILESYSTEM_SUPPORTED
+MAKE_PSTR_WORD(export)
+#endif
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(flash)
+#endif
+#if CONSOLE_FILESYSTEM_SUPPORTED
 MAKE_PSTR_WORD(fs)
 #endif
 #if !defined(ARDUINO_ARCH_ESP8266)
@@ -107,9 +136,16 @@ MAKE_PSTR_WORD(good)
 MAKE_PSTR_WORD(help)
 MAKE_PSTR_WORD(host)
 MAKE_PSTR_WORD(hostname)
+MAKE_PSTR_WORD(import)
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(iram)
+#endif
 MAKE_PSTR_WORD(level)
 MAKE_PSTR_WORD(log)
 MAKE_PSTR_WORD(logout)
+#if !defined(ARDUINO_ARCH_ESP8266)
+MAKE_PSTR_WORD(loopback)
+#endif
 #if CONSOLE_FILESYSTEM_SUPPORTED
 MAKE_PSTR_WORD(ls)
 #endif
@@ -122,14 +158,20 @@ MAKE_PSTR_WORD(mkfs)
 #if CONSOLE_FILESYSTEM_SUPPORTED
 MAKE_PSTR_WORD(mv)
 #endif
+#if !defined(ARDUINO_ARCH_ESP8266)
+MAKE_PSTR_WORD(net)
+#endif
 MAKE_PSTR_WORD(network)
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 MAKE_PSTR_WORD(off)
 MAKE_PSTR_WORD(on)
 #endif
 MAKE_PSTR_WORD(ota)
 MAKE_PSTR_WORD(passwd)
 MAKE_PSTR_WORD(password)
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(profile)
+#endif
 #if CONSOLE_FILESYSTEM_SUPPORTED
 MAKE_PSTR_WORD(read)
 #endif
@@ -140,16 +182,31 @@ MAKE_PSTR_WORD(rm)
 MAKE_PSTR_WORD(rmdir)
 #endif
 MAKE_PSTR_WORD(scan)
+#if !defined(ARDUINO_ARCH_ESP8266)
+MAKE_PSTR_WORD(server)
+#endif
 MAKE_PSTR_WORD(set)
 MAKE_PSTR_WORD(show)
 MAKE_PSTR_WORD(ssid)
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(start)
+#endif
 MAKE_PSTR_WORD(status)
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(stop)
+#endif
 MAKE_PSTR_WORD(su)
 MAKE_PSTR_WORD(syslog)
 MAKE_PSTR_WORD(system)
+#ifndef ENV_NATIVE
+MAKE_PSTR_WORD(telnet)
+#endif
 #if !defined(ARDUINO_ARCH_ESP8266) && defined(OTA_URL)
 MAKE_PSTR_WORD(update)
 #endif
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR_WORD(uplink)
+#endif
 MAKE_PSTR_WORD(uptime)
 MAKE_PSTR_WORD(url)
 MAKE_PSTR_WORD(version)
@@ -160,13 +217,20 @@ MAKE_PSTR_WORD(write)
 MAKE_PSTR(asterisks, "********")
 MAKE_PSTR(ddns_url_fmt, "DDNS URL = %s");
 MAKE_PSTR(ddns_password_fmt, "DDNS Password = %S");
+#ifdef ARDUINO_ARCH_ESP32
+MAKE_PSTR(frequency_optional, "[Hz]")
+#endif
 #if CONSOLE_FILESYSTEM_SUPPORTED
 MAKE_PSTR(filename_mandatory, "<filename>")
+#endif
 MAKE_PSTR(filename_optional, "[filename]")
+#if !defined(ARDUINO_ARCH_ESP8266)
+MAKE_PSTR(direction_mandatory, "<send|receive>")
+MAKE_PSTR(host_mandatory, "<host>")
 #endif
 MAKE_PSTR(host_is_fmt, "Host = %s")
+MAKE_PSTR(host_optional, "[host]")
 MAKE_PSTR(invalid_log_level, "Invalid log level")
-MAKE_PSTR(ip_address_optional, "[IP address]")
 MAKE_PSTR(log_level_is_fmt, "Log level = %s")
 MAKE_PSTR(log_level_optional, "[level]")
 MAKE_PSTR(mark_interval_is_fmt, "Mark interval = %lus");
@@ -174,11 +238,18 @@ MAKE_PSTR(name_mandatory, "<name>")
 MAKE_PSTR(name_optional, "[name]")
 MAKE_PSTR(new_password_prompt1, "Enter new password: ")
 MAKE_PSTR(new_password_prompt2, "Retype new password: ")
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 MAKE_PSTR(ota_enabled_fmt, "OTA %S");
 MAKE_PSTR(ota_password_fmt, "OTA Password = %S");
 #endif
 MAKE_PSTR(password_prompt, "Password: ")
+#if !defined(ARDUINO_ARCH_ESP8266)
+MAKE_PSTR(protocol_mandatory, "<tcp|udp>")
+MAKE_PSTR(rate_optional, "[kbit/s]")
+#endif
+#if CONSOLE_FILESYSTEM_SUPPORTED
+MAKE_PSTR(recursive, "-r")
+#endif
 MAKE_PSTR(seconds_optional, "[seconds]")
 MAKE_PSTR(unset, "<unset>")
 MAKE_PSTR(url_mandatory, "<url>")
@@ -186,8 +257,6 @@ MAKE_PSTR(wifi_ssid_fmt, "WiFi SSID = %s");
 MAKE_PSTR(wifi_password_fmt, "WiFi Password = %S");
 #pragma GCC diagnostic pop
 
-static constexpr unsigned long INVALID_PASSWORD_DELAY_MS = 3000;
-
 static inline AppShell &to_shell(Shell &shell) {
 	return static_cast<AppShell&>(shell);
 }
@@ -196,22 +265,52 @@ static inline App &to_app(Shell &shell) {
 	return to_shell(shell).app_;
 }
 
+CommandArena &command_arena(Shell &shell) {
+	return to_shell(shell).arena();
+}
+
 #define NO_ARGUMENTS std::vector<std::string>{}
 
-#if CONSOLE_FILESYSTEM_SUPPORTED
+static void reconfigure(Shell &shell) {
+#ifndef ENV_NATIVE
+	to_app(shell).config_syslog();
+	to_app(shell).config_ota();
+#endif
+}
 
-static char encode_base64(uint8_t value) {
-	if (value < 26) {
-		return 'A' + value;
-	} else if (value < 52) {
-		return 'a' + (value - 26);
-	} else if (value < 62) {
-		return '0' + (value - 52);
-	} else if (value == 62) {
-		return '+';
-	} else {
-		return '/';
+/*
+ * The config is shared by all sessions, so while a transaction is in
+ * progress only the session that started it can make changes. Changes
+ * from other sessions would otherwise be committed or discarded with it.
+ */
+static bool config_writable(Shell &shell) {
+	auto *owner = AppShell::config_transaction_;
+
+	if (owner && owner != &to_shell(shell)) {
+		shell.printfln(F("Config transaction in progress on console %s"), owner->console_name().c_str());
+		return false;
 	}
+
+	return true;
+}
+
+/* Discard the changes made by a transaction and apply the previous config */
+static bool config_abort(AppShell &shell) {
+	Config config;
+	std::string wifi_ssid = config.wifi_ssid();
+	std::string wifi_password = config.wifi_password();
+
+	if (!config.abort_transaction())
+		return false;
+
+	AppShell::config_transaction_ = nullptr;
+	reconfigure(shell);
+
+#ifndef ENV_NATIVE
+	if (config.wifi_ssid() != wifi_ssid || config.wifi_password() != wifi_password)
+		to_app(shell).network_.reconnect();
+#endif
+	return true;
 }
 
 static int8_t decode_base64(char value) {
@@ -232,27 +331,251 @@ static int8_t decode_base64(char value) {
 	}
 }
 
+using console_buffer = allocator::buffer<allocator::Subsystem::CONSOLE>;
+using base64_receive_function = std::function<bool(Shell &shell, const uint8_t *data, size_t len)>;
+
+/*
+ * Read base64 encoded data from the console until ^D, passing the decoded
+ * data to the receive function at the end of each line (and when the
+ * buffer is full). Reading stops if the receive function returns false.
+ *
+ * Input is not echoed for large transfers, where it would double the
+ * amount of data sent back to the client.
+ */
+static void read_base64(Shell &shell, bool echo, base64_receive_function receive,
+		std::function<void(Shell &shell)> complete) {
+	std::array<uint8_t,192> data{};
+	size_t data_len = 0;
+	std::array<uint8_t,4> buf{};
+	size_t len = 0;
+	size_t padding = 0;
+	bool newline = true;
+
+	shell.block_with([echo, receive, complete, data, data_len, buf, len, padding, newline] (Shell &shell, bool stop) mutable -> bool {
+		if (stop)
+			return stop;
+
+		for (size_t i = 0; i < data.size(); i++) {
+			int c = shell.read();
+
+			if (c == -1)
+				return stop;
+
+			int8_t val = decode_base64(c);
+
+			if (val >= 0) {
+				if (echo) {
+					shell.write(c);
+					newline = false;
+				}
+			} else if (c == '\r') {
+				if (echo) {
+					shell.println();
+					newline = true;
+				}
+			} else if (c == '\x03' || c == '\x1C') {
+				shell.println();
+				shell.println(F("Interrupted"));
+				return true;
+			}
+
+			if (val == 64) {
+				padding++;
+
+				if (padding > 2) {
+					if (!newline)
+						shell.println();
+
+					shell.println(F("Data error: too much padding"));
+					return true;
+				}
+			} else if (val >= 0) {
+				if (padding > 0) {
+					if (!newline)
+						shell.println();
+
+					shell.println(F("Data error: content after padding"));
+					return true;
+				}
+
+				buf[len] = val;
+				len++;
+			}
+
+			if (len + padding >= 4) {
+				if (len == 1) {
+					if (!newline)
+						shell.println();
+
+					shell.println(F("Data error: incomplete byte"));
+					return true;
+				}
+
+				if (len >= 2)
+					data[data_len++] = (buf[0] << 2) | (buf[1] >> 4);
+
+				if (len >= 3)
+					data[data_len++] = (buf[1] << 4) | (buf[2] >> 2);
+
+				if (len >= 4)
+					data[data_len++] = (buf[2] << 6) | buf[3];
+
+				len = 0;
+				padding = 0;
+			}
+
+			if (c == '\r' || c == '\x04' || data.size() - data_len < 3) {
+				if (data_len > 0 && !receive(shell, data.data(), data_len))
+					return true;
+
+				data_len = 0;
+			}
+
+			if (c == '\x04') {
+				if (!newline)
+					shell.println();
+
+				if (len + padding > 0) {
+					shell.println(F("Data error: incomplete sequence"));
+				} else {
+					complete(shell);
+				}
+
+				return true;
+			}
+		}
+
+		return stop;
+	});
+}
+
+/*
+ * Read base64 encoded data from the console until ^D, then call the
+ * completion function with the decoded data.
+ */
+static void read_base64(Shell &shell,
+		std::function<void(Shell &shell, const console_buffer &data)> complete) {
+	auto data = std::make_shared<console_buffer>();
+
+	read_base64(shell, true, [data] (Shell &shell, const uint8_t *buf, size_t len) -> bool {
+		if (data->capacity() - data->size() < len) {
+			size_t capacity = std::max({data->capacity() * 2, data->size() + len, (size_t)64});
+
+			if (allocator::available(allocator::Subsystem::CONSOLE) < capacity) {
+				shell.println(F("Out of memory"));
+				return false;
+			}
+
+			data->reserve(capacity);
+		}
+
+		data->insert(data->end(), buf, buf + len);
+		return true;
+	}, [data, complete] (Shell &shell) {
+		complete(shell, *data);
+	});
+}
+
+#if CONSOLE_FILESYSTEM_SUPPORTED
+
+static char encode_base64(uint8_t value) {
+	if (value < 26) {
+		return 'A' + value;
+	} else if (value < 52) {
+		return 'a' + (value - 26);
+	} else if (value < 62) {
+		return '0' + (value - 52);
+	} else if (value == 62) {
+		return '+';
+	} else {
+		return '/';
+	}
+}
+
+/* Base64 encode output to the console in lines of the same length as "fs read" */
+class Base64Print: public ::Print {
+public:
+	/* Input for a whole line, and the maximum output for each line */
+	static constexpr size_t LINE_BYTES = 57;
+	static constexpr size_t LINE_OUTPUT = 76 + 2;
+
+	explicit Base64Print(Shell &shell) : shell_(shell) {}
+
+	size_t write(uint8_t data) override {
+		buf_[len_++] = data;
+
+		if (len_ == buf_.size()) {
+			shell_.print(encode_base64(buf_[0] >> 2));
+			shell_.print(encode_base64(((buf_[0] & 0x3) << 4) | (buf_[1] >> 4)));
+			shell_.print(encode_base64(((buf_[1] & 0xF) << 2) | (buf_[2] >> 6)));
+			shell_.print(encode_base64(buf_[2] & 0x3F));
+			len_ = 0;
+
+			column_ += 4;
+			if (column_ == LINE_LENGTH) {
+				shell_.println();
+				column_ = 0;
+			}
+		}
+
+		return 1;
+	}
+
+	using ::Print::write;
+
+	void finish() {
+		if (len_ > 0) {
+			buf_[len_] = 0;
+			shell_.print(encode_base64(buf_[0] >> 2));
+			shell_.print(encode_base64(((buf_[0] & 0x3) << 4) | (buf_[1] >> 4)));
+			if (len_ >= 2) {
+				shell_.print(encode_base64((buf_[1] & 0xF) << 2));
+			} else {
+				shell_.print('=');
+			}
+			shell_.print('=');
+			len_ = 0;
+			column_ += 4;
+		}
+
+		if (column_ > 0) {
+			shell_.println();
+			column_ = 0;
+		}
+	}
+
+private:
+	static constexpr size_t LINE_LENGTH = 76;
+
+	Shell &shell_;
+	std::array<uint8_t,3> buf_{};
+	size_t len_{0};
+	size_t column_{0};
+};
+
+/* Output for the largest archive entry header (path and metadata) */
+static constexpr size_t EXPORT_HEADER_LINES = 6;
+
 static void list_file(Shell &shell, fs::File &file) {
-	std::string path = file.path();
+	const char *path = file.path();
+	size_t path_len = std::strlen(path);
+	const char *suffix = file.isDirectory() && (!path_len || path[path_len - 1] != '/') ? "/" : "";
 	struct tm tm;
 	time_t mtime = file.getLastWrite();
 
-	if (file.isDirectory() && (path.empty() || path.back() != '/'))
-		path.push_back('/');
-
 	tm.tm_year = 0;
 	gmtime_r(&mtime, &tm);
 
 	if (tm.tm_year != 0) {
-		shell.printfln(F("%c %7zu %04u-%02u-%02u %02u:%02u:%02u %s"),
+		shell.printfln(F("%c %7zu %04u-%02u-%02u %02u:%02u:%02u %s%s"),
 			file.isDirectory() ? 'd' : '-', file.size(),
 			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
 			tm.tm_hour, tm.tm_min, tm.tm_sec,
-			path.c_str());
+			path, suffix);
 	} else {
-		shell.printfln(F("%c %7zu [%10ld] %s"),
+		shell.printfln(F("%c %7zu [%10ld] %s%s"),
 			file.isDirectory() ? 'd' : '-', file.size(),
-			mtime, (unsigned long)file.getLastWrite(), path.c_str());
+			mtime, path, suffix);
 	}
 }
 
@@ -268,7 +591,7 @@ static bool fs_allowed(Shell &shell, const std::string &filename) {
 
 static bool fs_valid_file(Shell &shell, const std::string &filename, bool allow_dir = false) {
 	const char mode[2] = { 'r', '\0' };
-	auto file = FS.open(filename.c_str(), mode);
+	auto file = FS_for(filename).open(filename.c_str(), mode);
 
 	if (!file) {
 		shell.printfln(F("%s: file not found"), filename.c_str());
@@ -289,7 +612,7 @@ static bool fs_valid_file(Shell &shell, const std::string &filename, bool allow_
 }
 
 static bool fs_valid_dir(Shell &shell, const std::string &dirname, bool must_exist = true) {
-	auto dir = FS.open(dirname.c_str());
+	auto dir = FS_for(dirname).open(dirname.c_str());
 
 	if (dir) {
 		if (!dir.isDirectory()) {
@@ -319,7 +642,7 @@ static bool fs_valid_mv_cp(Shell &shell, const std::string &from_filename, std::
 	}
 
 	if (!to_filename.empty()) {
-		auto file = FS.open(to_filename.c_str());
+		auto file = FS_for(to_filename).open(to_filename.c_str());
 		if (file.isDirectory()) {
 			if (to_filename.back() != '/')
 				to_filename.push_back('/');
@@ -331,7 +654,7 @@ static bool fs_valid_mv_cp(Shell &shell, const std::string &from_filename, std::
 				return false;
 			}
 
-			auto file2 = FS.open(to_filename.c_str());
+			auto file2 = FS_for(to_filename).open(to_filename.c_str());
 			if (file2.isDirectory()) {
 				shell.printfln(F("%s: is a directory"), to_filename.c_str());
 				return false;
@@ -342,6 +665,92 @@ static bool fs_valid_mv_cp(Shell &shell, const std::string &from_filename, std::
 	return true;
 }
 
+static bool fs_copy(Shell &shell, const std::string &from_filename, const std::string &to_filename) {
+	const char read_mode[2] = { 'r', '\0' };
+	auto from_file = FS_for(from_filename).open(from_filename.c_str(), read_mode);
+	const char write_mode[2] = { 'w', '\0' };
+	auto to_file = FS_for(to_filename).open(to_filename.c_str(), write_mode, true);
+
+	if (!to_file) {
+		shell.printfln(F("%s: open error"), to_filename.c_str());
+		return false;
+	}
+
+	static constexpr size_t BUFFER_SIZE = 4096;
+
+	/* The filesystem budget may already be in use by another console */
+	if (allocator::available(allocator::Subsystem::FILESYSTEM) < BUFFER_SIZE) {
+		shell.println(F("Out of memory"));
+		return false;
+	}
+
+	allocator::buffer<allocator::Subsystem::FILESYSTEM> buf(BUFFER_SIZE);
+	size_t len;
+
+	do {
+		len = from_file.read(buf.data(), buf.size());
+		if (len > 0) {
+			if (to_file.write(buf.data(), len) != len) {
+				shell.printfln(F("%s: write error"), to_filename.c_str());
+				return false;
+			}
+		}
+	} while (len > 0);
+
+	return true;
+}
+
+static bool fs_valid_tree(Shell &shell, const std::string &from_filename, const std::string &to_filename) {
+	std::string from_path = normalise_filename(from_filename);
+	std::string to_path = normalise_filename(to_filename);
+
+	if (from_path.empty() || from_path.back() != '/')
+		from_path.push_back('/');
+
+	if (to_path.empty() || to_path.back() != '/')
+		to_path.push_back('/');
+
+	if (to_path.rfind(from_path, 0) == 0) {
+		shell.printfln(F("%s: can't copy a directory into itself"), from_filename.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/* Run a recursive operation in steps, and report what was done when it has finished */
+static void fs_tree_job(Shell &shell, fs_tree::Operation operation,
+		const std::string &from_filename, const std::string &to_filename) {
+	auto job = std::make_shared<fs_tree::Job>(operation, from_filename, to_filename,
+		[&shell] (const std::string &path) {
+			return fs_allowed(shell, path);
+		});
+	uint64_t start_ms = uuid::get_uptime_ms();
+
+	shell.block_with([operation, job, start_ms] (Shell &shell, bool stop) -> bool {
+		if (stop) {
+			shell.println(F("Interrupted"));
+		} else if (!job->step()) {
+			return false;
+		} else if (!job->error().empty()) {
+			shell.println(job->error().c_str());
+		}
+
+		const __FlashStringHelper *action = F("Removed");
+
+		if (operation == fs_tree::Operation::COPY) {
+			action = F("Copied");
+		} else if (operation == fs_tree::Operation::MOVE) {
+			action = F("Moved");
+		}
+
+		shell.printfln(F("%S %lu files and %lu directories (%llu bytes) in %lums"),
+			action, job->files(), job->directories(), job->bytes(),
+			(unsigned long)(uuid::get_uptime_ms() - start_ms));
+		return true;
+	});
+}
+
 static std::vector<std::string> fs_autocomplete(Shell &shell,
 		const std::vector<std::string> &current_arguments,
 		const std::string &next_argument) {
@@ -349,7 +758,7 @@ static std::vector<std::string> fs_autocomplete(Shell &shell,
 	std::vector<std::string> files;
 
 retry:
-	auto dir = FS.open(path.c_str());
+	auto dir = FS_for(path).open(path.c_str());
 	if (dir) {
 		if (dir.isDirectory()) {
 			path = dir.path();
@@ -365,6 +774,13 @@ retry:
 					break;
 				}
 			}
+
+			if (path == "/" && TMPFS.mounted()) {
+				std::string tmp_path = TMPFS.mountpoint();
+
+				if (std::find(files.begin(), files.end(), tmp_path) == files.end())
+					files.push_back(tmp_path);
+			}
 		} else {
 			files.emplace_back(dir.path());
 		}
@@ -402,6 +818,53 @@ static std::vector<std::string> log_level_autocomplete(Shell &shell,
 	return uuid::log::levels_lowercase();
 }
 
+#if !defined(ARDUINO_ARCH_ESP8266)
+static bool net_bench_arguments(Shell &shell, const std::vector<std::string> &arguments,
+		NetworkBenchmark::Protocol &protocol, NetworkBenchmark::Direction &direction,
+		unsigned long &seconds, unsigned long &rate_kbps) {
+	if (arguments[0] == uuid::read_flash_string(F("tcp"))) {
+		protocol = NetworkBenchmark::Protocol::TCP;
+	} else if (arguments[0] == uuid::read_flash_string(F("udp"))) {
+		protocol = NetworkBenchmark::Protocol::UDP;
+	} else {
+		shell.printfln(F("Invalid protocol: %s"), arguments[0].c_str());
+		return false;
+	}
+
+	if (arguments[1] == uuid::read_flash_string(F("send"))) {
+		direction = NetworkBenchmark::Direction::SEND;
+	} else if (arguments[1] == uuid::read_flash_string(F("receive"))) {
+		direction = NetworkBenchmark::Direction::RECEIVE;
+	} else {
+		shell.printfln(F("Invalid direction: %s"), arguments[1].c_str());
+		return false;
+	}
+
+	seconds = arguments.size() > 2 ? std::strtoul(arguments[2].c_str(), nullptr, 10)
+		: NetworkBenchmark::DEFAULT_SECONDS;
+	rate_kbps = arguments.size() > 3 ? std::strtoul(arguments[3].c_str(), nullptr, 10)
+		: NetworkBenchmark::DEFAULT_UDP_RATE_KBPS;
+
+	if (seconds == 0 || rate_kbps == 0) {
+		shell.println(F("Invalid duration or rate"));
+		return false;
+	}
+
+	return true;
+}
+
+static std::vector<std::string> net_bench_autocomplete(size_t offset,
+		const std::vector<std::string> &current_arguments) {
+	if (current_arguments.size() == offset) {
+		return {uuid::read_flash_string(F("tcp")), uuid::read_flash_string(F("udp"))};
+	} else if (current_arguments.size() == offset + 1) {
+		return {uuid::read_flash_string(F("send")), uuid::read_flash_string(F("receive"))};
+	} else {
+		return {};
+	}
+}
+#endif
+
 static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 	for (unsigned int context = ShellContext::MAIN; context < ShellContext::END; context++) {
 		commands->add_command(context, CommandFlags::USER, {F_(console), F_(log)}, {F_(log_level_optional)}, console_log_level, log_level_autocomplete);
@@ -411,6 +874,88 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		commands->add_command(context, CommandFlags::USER, {F_(logout)}, AppShell::main_logout_function);
 	}
 
+#ifdef ARDUINO_ARCH_ESP32
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(bench), F_(iram)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		filesystem_cache::benchmark(shell);
+	});
+
+	for (auto suite : {
+			std::make_pair(F_(all), benchmark::Suite::ALL),
+			std::make_pair(F_(cbor), benchmark::Suite::CBOR),
+			std::make_pair(F_(crypto), benchmark::Suite::CRYPTO),
+			std::make_pair(F_(flash), benchmark::Suite::FLASH),
+			std::make_pair(F_(fs), benchmark::Suite::FILESYSTEM),
+			std::make_pair(F_(memory), benchmark::Suite::MEMORY)}) {
+		commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(bench), suite.first},
+				[suite] (Shell &shell, const std::vector<std::string> &arguments) {
+			benchmark::run(shell, suite.second);
+		});
+	}
+#endif
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(config), F_(abort)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
+		if (config_abort(to_shell(shell))) {
+			shell.println(F("Config changes discarded"));
+		} else {
+			shell.println(F("No config transaction in progress"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(config), F_(begin)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (Config().begin_transaction()) {
+			AppShell::config_transaction_ = &to_shell(shell);
+			shell.println(F("Config changes will be written by \"config commit\""));
+		} else {
+			shell.println(F("Config transaction already in progress"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(config), F_(commit)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
+		if (Config().commit_transaction()) {
+			AppShell::config_transaction_ = nullptr;
+			shell.println(F("Config changes written"));
+		} else {
+			shell.println(F("No config transaction in progress"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN | CommandFlags::LOCAL, flash_string_vector{F_(config), F_(import)}, flash_string_vector{F_(filename_optional)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
+		if (!arguments.empty()) {
+			auto &filename = arguments[0];
+			const char mode[2] = { 'r', '\0' };
+			auto file = FS_for(filename).open(filename.c_str(), mode);
+
+			if (!file || file.isDirectory()) {
+				shell.printfln(F("%s: file not found"), filename.c_str());
+				return;
+			}
+
+			shell.println(Config().import(file) ? F("Config imported") : F("Config import failed"));
+			reconfigure(shell);
+		} else {
+			read_base64(shell, [] (Shell &shell, const console_buffer &data) {
+				qindesign::cbor::BytesStream stream{data.data(), data.size()};
+
+				shell.println(Config().import(stream) ? F("Config imported") : F("Config import failed"));
+				reconfigure(shell);
+			});
+		}
+	});
+
 #if CONSOLE_FILESYSTEM_SUPPORTED
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(fs)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
@@ -418,6 +963,48 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 	});
 #endif
 
+#if !defined(ARDUINO_ARCH_ESP8266)
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(net), F_(bench), F_(client)},
+			flash_string_vector{F_(host_mandatory), F_(protocol_mandatory), F_(direction_mandatory), F_(seconds_optional), F_(rate_optional)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		NetworkBenchmark::Protocol protocol;
+		NetworkBenchmark::Direction direction;
+		unsigned long seconds;
+		unsigned long rate_kbps;
+
+		if (net_bench_arguments(shell, {arguments.begin() + 1, arguments.end()},
+				protocol, direction, seconds, rate_kbps)) {
+			NetworkBenchmark::client(shell, arguments[0], protocol, direction, seconds, rate_kbps);
+		}
+	},
+	[] (Shell &shell, const std::vector<std::string> &current_arguments,
+			const std::string &next_argument) -> std::vector<std::string> {
+		return net_bench_autocomplete(1, current_arguments);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(net), F_(bench), F_(loopback)},
+			flash_string_vector{F_(protocol_mandatory), F_(direction_mandatory), F_(seconds_optional), F_(rate_optional)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		NetworkBenchmark::Protocol protocol;
+		NetworkBenchmark::Direction direction;
+		unsigned long seconds;
+		unsigned long rate_kbps;
+
+		if (net_bench_arguments(shell, arguments, protocol, direction, seconds, rate_kbps)) {
+			NetworkBenchmark::loopback(shell, protocol, direction, seconds, rate_kbps);
+		}
+	},
+	[] (Shell &shell, const std::vector<std::string> &current_arguments,
+			const std::string &next_argument) -> std::vector<std::string> {
+		return net_bench_autocomplete(0, current_arguments);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(net), F_(bench), F_(server)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		NetworkBenchmark::server(shell);
+	});
+#endif
+
 #ifndef ENV_NATIVE
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN | CommandFlags::LOCAL, flash_string_vector{F_(mkfs)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
@@ -438,81 +1025,23 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(ota), F_(bad)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 		esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
-		if (err) {
-			shell.printfln(F("Rollback failed: %d"), err);
-		}
-	});
-
-	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(ota), F_(good)},
-			[] (Shell &shell, const std::vector<std::string> &arguments) {
-		esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
-		if (err) {
-			shell.printfln(F("Commit failed: %d"), err);
-		}
-	});
-
-# ifdef OTA_URL
-	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(ota), F_(update)},
-			[] (Shell &shell, const std::vector<std::string> &arguments) {
-		esp_http_client_config_t http_config{};
-		esp_https_ota_config_t ota_config{};
-		esp_https_ota_handle_t handle{};
-
-		http_config.buffer_size = 4096;
-		http_config.crt_bundle_attach = arduino_esp_crt_bundle_attach;
-		http_config.keep_alive_enable = true;
-		http_config.disable_auto_redirect = true;
-		http_config.url = OTA_URL;
-		ota_config.http_config = &http_config;
-
-		esp_err_t err = esp_https_ota_begin(&ota_config, &handle);
-		if (err) {
-			shell.printfln(F("OTA failed: %d"), err);
-			return;
-		}
-
-		const int size = esp_https_ota_get_image_size(handle);
-		uint64_t start_ms = uuid::get_uptime_ms();
-		uint64_t last_update_ms = start_ms;
-		int last_progress = -1;
-		shell.printfln(F("OTA size: %d"), size);
-
-		shell.block_with([http_config, ota_config, handle, size, start_ms, last_update_ms, last_progress]
-				(Shell &shell, bool stop) mutable -> bool {
-			if (stop) {
-				esp_https_ota_abort(handle);
-				shell.printfln(F("OTA aborted"));
-				return true;
-			}
-
-			int err = esp_https_ota_perform(handle);
-			int count = esp_https_ota_get_image_len_read(handle);
-			int progress = (count * 100) / size;
-			uint64_t now_ms = uuid::get_uptime_ms();
-
-			if (err == ESP_OK || (now_ms - last_update_ms >= 1000 && progress != last_progress)) {
-				shell.printfln(F("OTA progress: %3d%% (%d)"), progress, count);
-				last_progress = progress;
-				last_update_ms = now_ms;
-			}
-
-			if (err == ESP_OK) {
-				err = esp_https_ota_finish(handle);
-				if (err) {
-					shell.printfln(F("OTA failed: %d"), err);
-				} else {
-					shell.printfln(F("OTA finished (%ums)"),
-						uuid::get_uptime_ms() - start_ms);
-				}
+		if (err) {
+			shell.printfln(F("Rollback failed: %d"), err);
+		}
+	});
 
-				return true;
-			} else if (err != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
-				shell.printfln(F("OTA perform failed: %d"), err);
-				esp_https_ota_abort(handle);
-			}
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(ota), F_(good)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+		if (err) {
+			shell.printfln(F("Commit failed: %d"), err);
+		}
+	});
 
-			return false;
-		});
+# ifdef OTA_URL
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(ota), F_(update)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		OTADownload::update(shell, uuid::read_flash_string(F(OTA_URL)));
 	});
 # endif
 #endif
@@ -524,7 +1053,7 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 			if (completed) {
 				shell.enter_password(F_(new_password_prompt2),
 						[password1] (Shell &shell, bool completed, const std::string &password2) {
-					if (completed) {
+					if (completed && config_writable(shell)) {
 						if (password1 == password2) {
 							Config config;
 							config.admin_password(password2);
@@ -539,9 +1068,35 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		});
 	});
 
+#ifdef ARDUINO_ARCH_ESP32
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(profile), F_(start)}, flash_string_vector{F_(frequency_optional)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		unsigned long frequency_hz = !arguments.empty()
+			? std::strtoul(arguments[0].c_str(), nullptr, 10) : Profiler::DEFAULT_FREQUENCY_HZ;
+
+		to_app(shell).profiler_.start(shell, frequency_hz);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(profile), F_(stop)}, flash_string_vector{F_(filename_optional)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		std::string filename = !arguments.empty() ? arguments[0] : uuid::read_flash_string(F("/profile.bin"));
+
+		if (!fs_allowed(shell, filename)) {
+			shell.printfln(F("%s: access denied"), filename.c_str());
+			return;
+		}
+
+		to_app(shell).profiler_.stop(shell, filename);
+	});
+#endif
+
 #ifndef ENV_NATIVE
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(reboot)},
 		[] (Shell &shell, const std::vector<std::string> &arguments) {
+#ifdef ARDUINO_ARCH_ESP32
+			filesystem_cache::save_snapshot();
+			to_app(shell).uplink_.commit();
+#endif
 			ESP.restart();
 	});
 #endif
@@ -553,6 +1108,9 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(set), F_(ddns), F_(url)}, flash_string_vector{F_(url_mandatory)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
 		Config config;
 		config.ddns_url(arguments.front());
 		config.commit();
@@ -569,7 +1127,7 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		shell.enter_password(F_(new_password_prompt1), [] (Shell &shell, bool completed, const std::string &password1) {
 				if (completed) {
 					shell.enter_password(F_(new_password_prompt2), [password1] (Shell &shell, bool completed, const std::string &password2) {
-						if (completed) {
+						if (completed && config_writable(shell)) {
 							if (password1 == password2) {
 								Config config;
 								config.ddns_password(password2);
@@ -586,6 +1144,9 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(set), F_(hostname)}, flash_string_vector{F_(name_optional)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
 		Config config;
 
 		if (arguments.empty()) {
@@ -599,9 +1160,12 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 #endif
 	});
 
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(set), F_(ota), F_(off)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
 		Config config;
 		config.ota_enabled(false);
 		config.commit();
@@ -611,6 +1175,9 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN | CommandFlags::LOCAL, flash_string_vector{F_(set), F_(ota), F_(on)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
 		Config config;
 		config.ota_enabled(true);
 		config.commit();
@@ -623,7 +1190,7 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		shell.enter_password(F_(new_password_prompt1), [] (Shell &shell, bool completed, const std::string &password1) {
 				if (completed) {
 					shell.enter_password(F_(new_password_prompt2), [password1] (Shell &shell, bool completed, const std::string &password2) {
-						if (completed) {
+						if (completed && config_writable(shell)) {
 							if (password1 == password2) {
 								Config config;
 								config.ota_password(password2);
@@ -642,6 +1209,9 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN | CommandFlags::LOCAL, flash_string_vector{F_(set), F_(wifi), F_(ssid)}, flash_string_vector{F_(name_mandatory)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		if (!config_writable(shell))
+			return;
+
 		Config config;
 		config.wifi_ssid(arguments.front());
 		config.commit();
@@ -658,7 +1228,7 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		shell.enter_password(F_(new_password_prompt1), [] (Shell &shell, bool completed, const std::string &password1) {
 				if (completed) {
 					shell.enter_password(F_(new_password_prompt2), [password1] (Shell &shell, bool completed, const std::string &password2) {
-						if (completed) {
+						if (completed && config_writable(shell)) {
 							if (password1 == password2) {
 								Config config;
 								config.wifi_password(password2);
@@ -692,6 +1262,18 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 	});
 
 #ifndef ENV_NATIVE
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(console)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		serial_console::show(shell);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(log)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		log_fanout::show(shell);
+		shell.println();
+		isr_log::show(shell);
+	});
+
 	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(memory)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 #if defined(ARDUINO_ARCH_ESP8266)
@@ -709,9 +1291,16 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		shell.printfln(F("Free PSRAM:               %lu bytes"), (unsigned long)ESP.getFreePsram());
 		shell.printfln(F("Minimum free PSRAM:       %lu bytes"), (unsigned long)ESP.getMinFreePsram());
 		shell.printfln(F("Maximum PSRAM block size: %lu bytes"), (unsigned long)ESP.getMaxAllocPsram());
+		if (ESP.getPsramSize()) {
+			shell.printfln(F("PSRAM allocation size:    %u bytes or more"), (unsigned int)APP_PSRAM_ALLOC_THRESHOLD);
+		}
 #else
 # error "Unknown arch"
 #endif
+		shell.println();
+		allocator::show(shell);
+		shell.println();
+		CommandArena::show(shell);
 	});
 
 	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(network)},
@@ -749,11 +1338,13 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 			shell.println(ota_state_string(state));
 
 			if (!esp_ota_get_partition_description(part, &desc)) {
-				shell.printfln(F("    Name:      %s"), null_terminated_string(desc.project_name).c_str());
-				shell.printfln(F("    Version:   %s"), null_terminated_string(desc.version).c_str());
+				CommandArena &arena = command_arena(shell);
+
+				shell.printfln(F("    Name:      %s"), arena.null_terminated_string(desc.project_name));
+				shell.printfln(F("    Version:   %s"), arena.null_terminated_string(desc.version));
 				shell.printfln(F("    Timestamp: %s %s"),
-					null_terminated_string(desc.date).c_str(),
-					null_terminated_string(desc.time).c_str());
+					arena.null_terminated_string(desc.date),
+					arena.null_terminated_string(desc.time));
 				shell.print(F("    Hash:      "));
 				shell.println(HexPrintable(desc.app_elf_sha256, sizeof(desc.app_elf_sha256)));
 			}
@@ -804,12 +1395,32 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 #elif defined(ARDUINO_ARCH_ESP32)
 		shell.printfln(F("FS size:       %zu bytes"), FS.totalBytes());
 		shell.printfln(F("FS used:       %zu bytes (%.2f%%)"), FS.usedBytes(), (float)FS.usedBytes() / (float)FS.totalBytes() * 100);
+		filesystem_cache::show(shell);
+
+		if (TMPFS.mounted()) {
+			shell.printfln(F("RAM FS size:   %zu bytes (%s)"), TMPFS.totalBytes(), TMPFS.mountpoint());
+			shell.printfln(F("RAM FS used:   %zu bytes (%.2f%%)"), TMPFS.usedBytes(), (float)TMPFS.usedBytes() / (float)TMPFS.totalBytes() * 100);
+		}
 #else
 # error "Unknown arch"
 #endif
 	});
 #endif
 
+#ifndef ENV_NATIVE
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(telnet)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		QueuedStream::show_all(shell);
+	});
+#endif
+
+#ifdef ARDUINO_ARCH_ESP32
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(uplink)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		to_app(shell).uplink_.show(shell);
+	});
+#endif
+
 	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(uptime)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 		shell.print(F("Uptime: "));
@@ -853,10 +1464,10 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 				if (completed) {
 					uint64_t now = uuid::get_uptime_ms();
 
-					if (!password.empty() && password == Config().admin_password()) {
+					if (!password.empty() && password_equal(password, Config().admin_password())) {
 						become_admin(shell);
 					} else {
-						shell.delay_until(now + INVALID_PASSWORD_DELAY_MS, [] (Shell &shell) {
+						shell.delay_until(now + AppShell::INVALID_PASSWORD_DELAY_MS, [] (Shell &shell) {
 							shell.logger().log(LogLevel::NOTICE, LogFacility::AUTH, F("Invalid admin password on console %s"), to_shell(shell).console_name().c_str());
 							shell.println(F("su: incorrect password"));
 						});
@@ -867,10 +1478,13 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 	});
 
 #ifndef ENV_NATIVE
-	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(syslog), F_(host)}, flash_string_vector{F_(ip_address_optional)},
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(syslog), F_(host)}, flash_string_vector{F_(host_optional)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 		Config config;
 		if (!arguments.empty()) {
+			if (!config_writable(shell))
+				return;
+
 			config.syslog_host(arguments[0]);
 			config.commit();
 		}
@@ -885,6 +1499,9 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		if (!arguments.empty()) {
 			uuid::log::Level level;
 
+			if (!config_writable(shell))
+				return;
+
 			if (uuid::log::parse_level_lowercase(arguments[0], level)) {
 				config.syslog_level(level);
 				config.commit();
@@ -905,6 +1522,9 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 		Config config;
 		if (!arguments.empty()) {
+			if (!config_writable(shell))
+				return;
+
 			config.syslog_mark_interval(std::atol(arguments[0].c_str()));
 			config.commit();
 		}
@@ -946,10 +1566,10 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 		auto dirname = arguments.empty() ? uuid::read_flash_string(F("/")) : arguments[0];
 		const char mode[2] = { 'r', '\0' };
-		auto dir = FS.open(dirname.c_str(), mode);
+		auto dir = FS_for(dirname).open(dirname.c_str(), mode);
 		if (dir) {
 			for (auto &filename : fs_autocomplete(shell, {}, dirname)) {
-				auto file = FS.open(filename.c_str());
+				auto file = FS_for(filename).open(filename.c_str());
 				list_file(shell, file);
 			}
 		} else {
@@ -966,8 +1586,20 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		if (!fs_valid_mv_cp(shell, from_filename, to_filename, true))
 			return;
 
-		if (!FS.rename(from_filename.c_str(), to_filename.c_str())) {
-			if (!FS.open(from_filename.c_str())) {
+		auto &from_fs = FS_for(from_filename);
+
+		if (&from_fs != &FS_for(to_filename)) {
+			if (from_fs.open(from_filename.c_str()).isDirectory()) {
+				shell.printfln(F("%s: can't move a directory to another filesystem"), from_filename.c_str());
+			} else if (fs_copy(shell, from_filename, to_filename)) {
+				if (!from_fs.remove(from_filename.c_str()))
+					shell.printfln(F("%s: error"), from_filename.c_str());
+			}
+			return;
+		}
+
+		if (!from_fs.rename(from_filename.c_str(), to_filename.c_str())) {
+			if (!from_fs.open(from_filename.c_str())) {
 				shell.printfln(F("%s: error"), from_filename.c_str());
 			} else {
 				shell.printfln(F("%s: error"), to_filename.c_str());
@@ -984,28 +1616,33 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		if (!fs_valid_mv_cp(shell, from_filename, to_filename))
 			return;
 
-		const char read_mode[2] = { 'r', '\0' };
-		auto from_file = FS.open(from_filename.c_str(), read_mode);
-		const char write_mode[2] = { 'w', '\0' };
-		auto to_file = FS.open(to_filename.c_str(), write_mode, true);
+		fs_copy(shell, from_filename, to_filename);
+	}, fs_autocomplete);
+
+	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(mv), F_(recursive)},
+				flash_string_vector{F_(filename_mandatory), F_(filename_mandatory)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		auto &from_filename = arguments[0];
+		auto to_filename = arguments[1];
 
-		if (!to_file) {
-			shell.printfln(F("%s: open error"), to_filename.c_str());
+		if (!fs_valid_mv_cp(shell, from_filename, to_filename, true)
+				|| !fs_valid_tree(shell, from_filename, to_filename))
 			return;
-		}
 
-		uint8_t buf[1024];
-		size_t len;
+		fs_tree_job(shell, fs_tree::Operation::MOVE, from_filename, to_filename);
+	}, fs_autocomplete);
 
-		do {
-			len = from_file.read(buf, sizeof(buf));
-			if (len > 0) {
-				if (to_file.write(buf, len) != len) {
-					shell.printfln(F("%s: write error"), to_filename.c_str());
-					return;
-				}
-			}
-		} while (len > 0);
+	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(cp), F_(recursive)},
+				flash_string_vector{F_(filename_mandatory), F_(filename_mandatory)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		auto &from_filename = arguments[0];
+		auto to_filename = arguments[1];
+
+		if (!fs_valid_mv_cp(shell, from_filename, to_filename, true)
+				|| !fs_valid_tree(shell, from_filename, to_filename))
+			return;
+
+		fs_tree_job(shell, fs_tree::Operation::COPY, from_filename, to_filename);
 	}, fs_autocomplete);
 
 	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(rm)}, flash_string_vector{F_(filename_mandatory)},
@@ -1015,12 +1652,22 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		if (!fs_valid_file(shell, filename))
 			return;
 
-		if (!FS.remove(filename.c_str())) {
+		if (!FS_for(filename).remove(filename.c_str())) {
 			shell.printfln(F("%s: error"), filename.c_str());
 			return;
 		}
 	}, fs_autocomplete);
 
+	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(rm), F_(recursive)}, flash_string_vector{F_(filename_mandatory)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		auto &filename = arguments[0];
+
+		if (!fs_valid_file(shell, filename, true))
+			return;
+
+		fs_tree_job(shell, fs_tree::Operation::REMOVE, filename, "");
+	}, fs_autocomplete);
+
 	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(mkdir)}, flash_string_vector{F_(filename_mandatory)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 		auto &dirname = arguments[0];
@@ -1028,7 +1675,7 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		if (!fs_valid_dir(shell, dirname, false))
 			return;
 
-		if (!FS.mkdir(dirname.c_str())) {
+		if (!FS_for(dirname).mkdir(dirname.c_str())) {
 			shell.printfln(F("%s: error"), dirname.c_str());
 			return;
 		}
@@ -1041,7 +1688,7 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 		if (!fs_valid_dir(shell, dirname))
 			return;
 
-		if (!FS.rmdir(dirname.c_str())) {
+		if (!FS_for(dirname).rmdir(dirname.c_str())) {
 			shell.printfln(F("%s: error"), dirname.c_str());
 			return;
 		}
@@ -1050,72 +1697,51 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(read)}, flash_string_vector{F_(filename_mandatory)},
 			[] (Shell &shell, const std::vector<std::string> &arguments) {
 		auto &filename = arguments[0];
-
-		uint8_t buf[58];
 		const char mode[2] = { 'r', '\0' };
-		auto file = FS.open(filename.c_str(), mode);
+		auto file = FS_for(filename).open(filename.c_str(), mode);
 
-		if (file) {
-			if (file.isDirectory()) {
-				shell.printfln(F("%s: is a directory"), filename.c_str());
-				return;
-			}
+		if (!file) {
+			shell.printfln(F("%s: file not found"), filename.c_str());
+			return;
+		}
 
-			if (!fs_allowed(shell, filename)) {
-				shell.printfln(F("%s: access denied"), filename.c_str());
-				return;
-			}
+		if (file.isDirectory()) {
+			shell.printfln(F("%s: is a directory"), filename.c_str());
+			return;
+		}
 
-			bool newline = true;
-			size_t total = 0;
-			size_t len;
+		if (!fs_allowed(shell, filename)) {
+			shell.printfln(F("%s: access denied"), filename.c_str());
+			return;
+		}
 
-			do {
-				len = file.read(buf, sizeof(buf) - 1);
+		auto output = std::make_shared<Base64Print>(shell);
+		size_t total = 0;
 
-				if (len > 0) {
-					size_t pos = 0;
-					size_t available = len;
-					bool end = false;
+		shell.block_with([file, filename, output, total] (Shell &shell, bool stop) mutable -> bool {
+			std::array<uint8_t,Base64Print::LINE_BYTES> buf;
 
-					buf[len] = 0;
+			if (stop) {
+				output->finish();
+				shell.println(F("Interrupted"));
+				return true;
+			}
 
-					while (available > 0) {
-						newline = false;
-						shell.print(encode_base64(buf[pos] >> 2));
-						shell.print(encode_base64(((buf[pos] & 0x3) << 4) | (buf[pos + 1] >> 4)));
-						if (available >= 2) {
-							shell.print(encode_base64(((buf[pos + 1] & 0xF) << 2) | (buf[pos + 2] >> 6)));
-						} else {
-							shell.print('=');
-						}
-						if (available >= 3) {
-							shell.print(encode_base64( buf[pos + 2] & 0x3F));
-						} else {
-							shell.print('=');
-							end = true;
-							break;
-						}
-						pos += 3;
-						available -= 3;
-					}
+			while (to_shell(shell).output_available() >= Base64Print::LINE_OUTPUT) {
+				size_t len = file.read(buf.data(), buf.size());
 
-					if (end || len == sizeof(buf) - 1) {
-						shell.println();
-						newline = true;
-					}
+				output->write(buf.data(), len);
+				total += len;
 
-					total += len;
+				if (len < buf.size()) {
+					output->finish();
+					shell.printfln(F("%s: read %zu"), filename.c_str(), total);
+					return true;
 				}
-			} while (len == sizeof(buf) - 1);
-
-			if (!newline)
-				shell.println();
+			}
 
-			shell.printfln(F("%s: read %zu"), filename.c_str(), total);
-		} else {
-			shell.printfln(F("%s: file not found"), filename.c_str());
-		}
+			return false;
+		});
 	}, fs_autocomplete);
 
 	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(write)}, flash_string_vector{F_(filename_mandatory)},
@@ -1124,7 +1750,7 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 
 		{
 			const char mode[2] = { 'r', '\0' };
-			auto file = FS.open(filename.c_str(), mode);
+			auto file = FS_for(filename).open(filename.c_str(), mode);
 
 			if (file && file.isDirectory()) {
 				shell.printfln(F("%s: is a directory"), filename.c_str());
@@ -1137,106 +1763,98 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 			return;
 		}
 
-		std::vector<uint8_t> data;
-		std::array<uint8_t,4> buf{};
-		size_t len = 0;
-		size_t padding = 0;
-		bool newline = true;
+		read_base64(shell, [filename] (Shell &shell, const console_buffer &data) {
+			const char mode[2] = { 'w', '\0' };
+			auto file = FS_for(filename).open(filename.c_str(), mode, true);
 
-		shell.block_with([filename, data, buf, len, padding, newline] (Shell &shell, bool stop) mutable -> bool {
-			if (stop)
-				return stop;
+			if (file) {
+				if (file.write(data.data(), data.size()) != data.size()) {
+					shell.printfln(F("%s: write error"), filename.c_str());
+				} else {
+					shell.printfln(F("%s: write %zu"), filename.c_str(), data.size());
+				}
+				file.close();
+			} else {
+				shell.printfln(F("%s: unable to open for writing"), filename.c_str());
+			}
+		});
+	}, fs_autocomplete);
 
-			int c = shell.read();
+	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(export)}, flash_string_vector{F_(filename_optional)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		auto dirname = arguments.empty() ? uuid::read_flash_string(F("/")) : arguments[0];
 
-			if (c == -1)
-				return stop;
+		if (!fs_valid_dir(shell, dirname))
+			return;
 
-			int8_t val = decode_base64(c);
+		auto output = std::make_shared<Base64Print>(shell);
+		auto archive = std::make_shared<fs_archive::Export>(*output, dirname, [&shell] (const std::string &path) {
+			return fs_allowed(shell, path);
+		});
+		uint64_t start_ms = uuid::get_uptime_ms();
 
-			if (val >= 0) {
-				shell.write(c);
-				newline = false;
-			} else if (c == '\r') {
-				shell.println();
-				newline = true;
-			} else if (c == '\x03' || c == '\x1C') {
-				shell.println();
+		shell.block_with([output, archive, start_ms] (Shell &shell, bool stop) -> bool {
+			if (stop) {
+				output->finish();
 				shell.println(F("Interrupted"));
 				return true;
 			}
 
-			if (val == 64) {
-				padding++;
+			/* Leave space for an entry header and a partial line */
+			size_t lines = to_shell(shell).output_available() / Base64Print::LINE_OUTPUT;
 
-				if (padding > 2) {
-					if (!newline)
-						shell.println();
+			if (lines < EXPORT_HEADER_LINES + 2)
+				return false;
 
-					shell.println(F("Data error: too much padding"));
-					return true;
-				}
-			} else if (val >= 0) {
-				if (padding > 0) {
-					if (!newline)
-						shell.println();
+			if (!archive->step((lines - EXPORT_HEADER_LINES - 1) * Base64Print::LINE_BYTES))
+				return false;
 
-					shell.println(F("Data error: content after padding"));
-					return true;
-				}
+			output->finish();
 
-				buf[len] = val;
-				len++;
+			if (!archive->error().empty()) {
+				shell.println(archive->error().c_str());
+				return true;
 			}
 
-			if (len + padding >= 4) {
-				if (len == 1) {
-					if (!newline)
-						shell.println();
-
-					shell.println(F("Data error: incomplete byte"));
-					return true;
-				}
-
-				if (len >= 2)
-					data.push_back((char)(buf[0] << 2) | (buf[1] >> 4));
+			shell.printfln(F("Exported %lu files and %lu directories (%llu bytes) in %lums"),
+				archive->files(), archive->directories(), archive->bytes(),
+				(unsigned long)(uuid::get_uptime_ms() - start_ms));
 
-				if (len >= 3)
-					data.push_back((char)(buf[1] << 4) | (buf[2] >> 2));
+			if (archive->skipped())
+				shell.printfln(F("Skipped %lu inaccessible files"), archive->skipped());
 
-				if (len >= 4)
-					data.push_back((char)(buf[2] << 6) | buf[3]);
+			return true;
+		});
+	}, fs_autocomplete);
 
-				len = 0;
-				padding = 0;
-			}
+	commands->add_command(ShellContext::FILESYSTEM, CommandFlags::ADMIN, flash_string_vector{F_(import)}, flash_string_vector{F_(filename_optional)},
+			[] (Shell &shell, const std::vector<std::string> &arguments) {
+		auto dirname = arguments.empty() ? uuid::read_flash_string(F("/")) : arguments[0];
 
-			if (c == '\x04') {
-				if (!newline)
-					shell.println();
+		if (!fs_valid_dir(shell, dirname))
+			return;
 
-				if (len + padding > 0) {
-					shell.println(F("Data error: incomplete sequence"));
-				} else {
-					const char mode[2] = { 'w', '\0' };
-					auto file = FS.open(filename.c_str(), mode, true);
+		auto archive = std::make_shared<fs_archive::Import>(dirname, [&shell] (const std::string &path) {
+			return fs_allowed(shell, path);
+		});
+		uint64_t start_ms = uuid::get_uptime_ms();
 
-					if (file) {
-						if (file.write(data.data(), data.size()) != data.size()) {
-							shell.printfln(F("%s: write error"), filename.c_str());
-						} else {
-							shell.printfln(F("%s: write %zu"), filename.c_str(), data.size());
-						}
-						file.close();
-					} else {
-						shell.printfln(F("%s: unable to open for writing"), filename.c_str());
-					}
-				}
+		read_base64(shell, false, [archive] (Shell &shell, const uint8_t *data, size_t len) -> bool {
+			if (!archive->write(data, len)) {
+				shell.println(archive->error().c_str());
+				return false;
+			}
 
-				return true;
+			return true;
+		}, [archive, start_ms] (Shell &shell) {
+			if (!archive->finish()) {
+				shell.println(archive->error().c_str());
+				return;
 			}
 
-			return stop;
+			shell.printfln(F("Imported %lu files and %lu directories (%llu bytes) in %lums"),
+				archive->files(), archive->directories(), archive->bytes(),
+				(unsigned long)(uuid::get_uptime_ms() - start_ms));
 		});
 	}, fs_autocomplete);
 #endif
@@ -1244,6 +1862,8 @@ static void setup_builtin_commands(std::shared_ptr<Commands> &commands) {
 
 __attribute__((weak)) void setup_commands(std::shared_ptr<Commands> &commands) {}
 
+AppShell *AppShell::config_transaction_{nullptr};
+
 std::shared_ptr<Commands> AppShell::commands_ = [] {
 	std::shared_ptr<Commands> commands = std::make_shared<Commands>();
 	setup_builtin_commands(commands);
@@ -1256,12 +1876,26 @@ AppShell::AppShell(App &app, Stream &stream, unsigned int context, unsigned int
 
 }
 
+size_t AppShell::output_available() {
+	return SIZE_MAX;
+}
+
+void AppShell::operator<<(std::shared_ptr<uuid::log::Message> message) {
+	log_fanout::delivered(message, log_fanout::Sink::CONSOLE);
+	Shell::operator<<(std::move(message));
+}
+
 void AppShell::started() {
 	logger().log(LogLevel::INFO, LogFacility::CONSOLE,
 		F("User session opened on console %s"), console_name().c_str());
 }
 
 void AppShell::stopped() {
+	if (config_transaction_ == this && config_abort(*this)) {
+		logger().log(LogLevel::NOTICE, LogFacility::CONSOLE,
+			F("Config transaction aborted on console %s"), console_name().c_str());
+	}
+
 	if (has_flags(CommandFlags::ADMIN)) {
 		logger().log(LogLevel::INFO, LogFacility::AUTH,
 			F("Admin session closed on console %s"), console_name().c_str());
@@ -1311,6 +1945,9 @@ std::string AppShell::context_text() {
 }
 
 std::string AppShell::prompt_suffix() {
+	/* The previous command has finished */
+	arena_.reset();
+
 	if (has_flags(CommandFlags::ADMIN)) {
 		return std::string{'#'};
 	} else {
@@ -1368,7 +2005,7 @@ void AppShell::set_command(Shell &shell) {
 		shell.printfln(F_(ddns_url_fmt), config.ddns_url().empty() ? uuid::read_flash_string(F_(unset)).c_str() : config.ddns_url().c_str());
 		shell.printfln(F_(ddns_password_fmt), config.ddns_password().empty() ? F_(unset) : F_(asterisks));
 	}
-#if defined(ARDUINO_ARCH_ESP8266)
+#ifndef ENV_NATIVE
 	if (shell.has_flags(CommandFlags::ADMIN)) {
 		shell.printfln(F_(ota_enabled_fmt), config.ota_enabled() ? F_(enabled) : F_(disabled));
 	}
@@ -1397,12 +2034,15 @@ AppConsole::AppConsole(App &app, Stream &stream, bool local)
 }
 
 #ifndef ENV_NATIVE
-AppConsole::AppConsole(App &app, Stream &stream, const IPAddress &addr, uint16_t port)
-		: APP_SHELL_TYPE(app, stream, ShellContext::MAIN, CommandFlags::USER),
+AppConsole::AppConsole(App &app, std::unique_ptr<QueuedStream> stream, const IPAddress &addr, uint16_t port)
+		: APP_SHELL_TYPE(app, *stream, ShellContext::MAIN, CommandFlags::USER),
 		  addr_(addr),
-		  port_(port) {
+		  port_(port),
+		  output_queue_(std::move(stream)) {
 	std::array<char, 16> text;
 
+	maximum_log_messages(APP_TELNET_LOG_MESSAGES);
+
 	pty_ = 0;
 	while (pty_ < ptys_.size() && ptys_[pty_])
 		pty_++;
@@ -1436,4 +2076,42 @@ std::string AppConsole::console_name() {
 	return name_;
 }
 
+#ifndef ENV_NATIVE
+size_t AppConsole::output_available() {
+	return output_queue_ ? output_queue_->output_available() : APP_SHELL_TYPE::output_available();
+}
+
+void AppConsole::operator<<(std::shared_ptr<uuid::log::Message> message) {
+	if (output_queue_ && !output_queue_->accept_log(*message))
+		return;
+
+	APP_SHELL_TYPE::operator<<(std::move(message));
+}
+#endif
+
+#ifndef ENV_NATIVE
+AppBatchConsole::AppBatchConsole(App &app, Stream &stream, const std::string &name)
+		: APP_SHELL_TYPE(app, stream, ShellContext::MAIN, CommandFlags::USER),
+		  name_(name) {
+
+}
+
+std::string AppBatchConsole::console_name() {
+	return name_;
+}
+
+const __FlashStringHelper *AppBatchConsole::execute(const std::string &line) {
+	auto execution = commands_->execute_command(*this, uuid::console::CommandLine{line});
+
+	idle_ = false;
+	return execution.error;
+}
+
+/* There's no prompt to reset the arena when a command finishes */
+void AppBatchConsole::end_of_transmission() {
+	arena().reset();
+	idle_ = true;
+}
+#endif
+
 } // namespace app
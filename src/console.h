@@ -25,6 +25,7 @@
 #include <vector>
 
 #include "app.h"
+#include "command_arena.h"
 
 #ifdef LOCAL
 # undef LOCAL
@@ -51,6 +52,8 @@ class App;
 
 class AppShell: public uuid::console::Shell {
 public:
+	static constexpr unsigned long INVALID_PASSWORD_DELAY_MS = 3000;
+
 	~AppShell() override = default;
 
 	virtual std::string console_name() = 0;
@@ -62,8 +65,22 @@ public:
 
 	virtual void set_command(Shell &shell);
 
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override;
+
+	inline CommandArena &arena() { return arena_; }
+
+	/*
+	 * Space for output that won't have to wait for the client. Network
+	 * consoles are stopped if their output queue overflows, so commands
+	 * that write a lot of output check this and produce it in steps.
+	 */
+	virtual size_t output_available();
+
 	App &app_;
 
+	/* Shell that started the current config transaction */
+	static AppShell *config_transaction_;
+
 protected:
 	AppShell(App &app, Stream &stream, unsigned int context, unsigned int flags);
 
@@ -80,6 +97,8 @@ protected:
 private:
 	static void main_exit_user_function(Shell &shell, const std::vector<std::string> &arguments);
 	static void main_exit_admin_function(Shell &shell, const std::vector<std::string> &arguments);
+
+	CommandArena arena_;
 };
 
 } // namespace app
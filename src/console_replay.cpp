@@ -0,0 +1,408 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ENV_NATIVE
+#include "app/console_replay.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/console.h"
+#include "app/console_stream.h"
+
+namespace app {
+
+static std::atomic<unsigned long> heap_allocations{0};
+static std::atomic<size_t> heap_bytes{0};
+
+/* Notifies the replay when the command has finished */
+class ConsoleReplay::Console: public AppConsole {
+public:
+	Console(App &app, ConsoleReplay &replay)
+			: AppConsole(app, replay.stream_, true), replay_(replay) {
+	}
+
+protected:
+	std::string prompt_suffix() override {
+		replay_.prompt();
+		return AppConsole::prompt_suffix();
+	}
+
+private:
+	ConsoleReplay &replay_;
+};
+
+int ConsoleReplay::ReplayStream::available() {
+	return input_.size() - pos_;
+}
+
+int ConsoleReplay::ReplayStream::read() {
+	if (input_complete())
+		return -1;
+
+	char c = input_[pos_++];
+
+	if (c == '\r')
+		replay_.command_started();
+
+	return (uint8_t)c;
+}
+
+int ConsoleReplay::ReplayStream::peek() {
+	return input_complete() ? -1 : (uint8_t)input_[pos_];
+}
+
+size_t ConsoleReplay::ReplayStream::write(uint8_t c) {
+	output_.push_back(c);
+	return 1;
+}
+
+size_t ConsoleReplay::ReplayStream::write(const uint8_t *buffer, size_t size) {
+	output_.append(reinterpret_cast<const char *>(buffer), size);
+	return size;
+}
+
+void ConsoleReplay::ReplayStream::input(const std::string &text) {
+	input_ = text;
+	pos_ = 0;
+}
+
+ConsoleReplay::ConsoleReplay(App &app, Print &report, const std::string &filename)
+		: report_(report), stream_(*this) {
+	stream_.output_.reserve(OUTPUT_RESERVE);
+
+	if (!parse(filename)) {
+		failures_++;
+		finished_ = true;
+		return;
+	}
+
+	console_ = std::make_shared<Console>(app, *this);
+	console_->start();
+	console_->log_level(uuid::log::Level::OFF);
+
+	report_.printf("Replaying %zu commands from %s\r\n", commands_.size(), filename.c_str());
+	report_.println();
+	report_.println(" Line   Time (us)  Allocations     Bytes  Result  Command");
+}
+
+unsigned long ConsoleReplay::run(App &app, Print &report, const std::string &filename) {
+	ConsoleReplay replay{app, report, filename};
+
+	while (!replay.loop()) {
+		uuid::loop();
+		uuid::console::Shell::loop_all();
+	}
+
+	return replay.failures();
+}
+
+bool ConsoleReplay::loop() {
+	if (finished_)
+		return true;
+
+	if (running_) {
+		if (!console_->running()) {
+			if (started_ && stream_.input_complete()) {
+				/* The command ended the session (e.g. logout) */
+				complete();
+				return false;
+			}
+
+			fail(commands_[next_], "console stopped");
+		} else if (uuid::get_uptime_ms() - start_ms_ >= APP_CONSOLE_REPLAY_TIMEOUT_MS) {
+			fail(commands_[next_], "timeout");
+		} else {
+			return false;
+		}
+
+		finished_ = true;
+	} else if (next_ == commands_.size()) {
+		finished_ = true;
+	} else if (!console_->running()) {
+		fail(commands_[next_], "console stopped");
+		finished_ = true;
+	} else {
+		stream_.output_.clear();
+		stream_.input(commands_[next_].input);
+		start_ms_ = uuid::get_uptime_ms();
+		started_ = false;
+		running_ = true;
+		return false;
+	}
+
+	if (console_->running())
+		console_->stop();
+
+	summary();
+	return true;
+}
+
+bool ConsoleReplay::parse(const std::string &filename) {
+	std::ifstream file{filename};
+
+	if (!file) {
+		report_.printf("%s: unable to open\r\n", filename.c_str());
+		return false;
+	}
+
+	std::string text;
+	unsigned long line = 0;
+
+	while (std::getline(file, text)) {
+		line++;
+
+		if (!text.empty() && text.back() == '\r')
+			text.pop_back();
+
+		if (!parse_line(line, text)) {
+			report_.printf("%s:%lu: invalid line: %s\r\n", filename.c_str(), line, text.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ConsoleReplay::parse_line(unsigned long line, const std::string &text) {
+	if (text.empty() || text[0] == '#')
+		return true;
+
+	if (text.length() < 2 || text[1] != ' ')
+		return false;
+
+	std::string value = text.substr(2);
+
+	if (text[0] == '>') {
+		commands_.emplace_back();
+		commands_.back().line = line;
+		commands_.back().text = value;
+		commands_.back().input = value + '\r';
+		return true;
+	}
+
+	if (commands_.empty())
+		return false;
+
+	auto &command = commands_.back();
+
+	switch (text[0]) {
+	case '+':
+		command.input += value + '\r';
+		return true;
+
+	case '~':
+	case '!':
+		try {
+			command.patterns.push_back({text[0] == '~', value, std::regex{value}});
+		} catch (const std::regex_error&) {
+			return false;
+		}
+		return true;
+
+	case '@':
+		return parse_limit(command, value);
+	}
+
+	return false;
+}
+
+bool ConsoleReplay::parse_limit(Command &command, const std::string &text) {
+	size_t pos = text.find(' ');
+
+	if (pos == std::string::npos || pos + 1 == text.length())
+		return false;
+
+	std::string name = text.substr(0, pos);
+	char *end = nullptr;
+	unsigned long limit = std::strtoul(text.c_str() + pos + 1, &end, 10);
+
+	if (*end)
+		return false;
+
+	if (name == "time") {
+		command.max_time_us = limit;
+	} else if (name == "allocations") {
+		command.max_allocations = limit;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+/* The end of the command line has been read */
+void ConsoleReplay::command_started() {
+	if (!running_ || started_)
+		return;
+
+	started_ = true;
+	output_start_ = stream_.output_.size();
+	start_allocations_ = heap_allocations;
+	start_bytes_ = heap_bytes;
+	start_us_ = micros();
+}
+
+/* The next prompt is being displayed so the command has finished */
+void ConsoleReplay::prompt() {
+	if (running_ && started_ && stream_.input_complete())
+		complete();
+}
+
+void ConsoleReplay::complete() {
+	unsigned long time_us = micros() - start_us_;
+	unsigned long allocations = heap_allocations - start_allocations_;
+	const auto &command = commands_[next_];
+	auto lines = output_lines(stream_.output_.substr(output_start_));
+	auto errors = check(command, lines, time_us, allocations);
+
+#if APP_CONSOLE_REPLAY_ALLOCATIONS
+	report_.printf("%5lu  %10lu  %11lu  %8zu  %-6s  %s\r\n",
+		command.line, time_us, allocations, heap_bytes - start_bytes_,
+		errors.empty() ? "ok" : "FAILED", command.text.c_str());
+#else
+	report_.printf("%5lu  %10lu  %11s  %8s  %-6s  %s\r\n",
+		command.line, time_us, "-", "-",
+		errors.empty() ? "ok" : "FAILED", command.text.c_str());
+#endif
+
+	if (!errors.empty()) {
+		for (const auto &error : errors)
+			fail(command, error);
+
+		for (const auto &line : lines)
+			report_.printf("       | %s\r\n", line.c_str());
+	}
+
+	total_time_us_ += time_us;
+	total_allocations_ += allocations;
+	running_ = false;
+	next_++;
+}
+
+std::vector<std::string> ConsoleReplay::output_lines(const std::string &output) {
+	std::vector<std::string> lines;
+	size_t pos = 0;
+
+	while (pos < output.length()) {
+		size_t end = output.find('\n', pos);
+
+		if (end == std::string::npos)
+			end = output.length();
+
+		lines.push_back(output.substr(pos, end - pos));
+
+		if (!lines.back().empty() && lines.back().back() == '\r')
+			lines.back().pop_back();
+
+		pos = end + 1;
+	}
+
+	return lines;
+}
+
+std::vector<std::string> ConsoleReplay::check(const Command &command,
+		const std::vector<std::string> &lines, unsigned long time_us,
+		unsigned long allocations) {
+	std::vector<std::string> errors;
+	auto next_line = lines.cbegin();
+
+	for (const auto &pattern : command.patterns) {
+		if (pattern.match) {
+			auto it = std::find_if(next_line, lines.cend(), [&pattern] (const std::string &line) {
+				return std::regex_search(line, pattern.regex);
+			});
+
+			if (it == lines.cend()) {
+				errors.push_back("no match for: " + pattern.text);
+			} else {
+				next_line = it + 1;
+			}
+		} else if (std::any_of(lines.cbegin(), lines.cend(), [&pattern] (const std::string &line) {
+					return std::regex_search(line, pattern.regex);
+				})) {
+			errors.push_back("unexpected match for: " + pattern.text);
+		}
+	}
+
+	if (command.max_time_us && time_us > command.max_time_us) {
+		errors.push_back("took " + std::to_string(time_us)
+			+ "us (limit " + std::to_string(command.max_time_us) + "us)");
+	}
+
+	if (APP_CONSOLE_REPLAY_ALLOCATIONS && command.max_allocations
+			&& allocations > command.max_allocations) {
+		errors.push_back("made " + std::to_string(allocations)
+			+ " allocations (limit " + std::to_string(command.max_allocations) + ")");
+	}
+
+	return errors;
+}
+
+void ConsoleReplay::fail(const Command &command, const std::string &reason) {
+	report_.printf("%5lu: %s: %s\r\n", command.line, command.text.c_str(), reason.c_str());
+	failures_++;
+}
+
+void ConsoleReplay::summary() {
+	report_.println();
+	report_.printf("%zu of %zu commands run, %lu failures, %llu us, %llu allocations\r\n",
+		next_, commands_.size(), failures_, total_time_us_, total_allocations_);
+}
+
+} // namespace app
+
+#if APP_CONSOLE_REPLAY_ALLOCATIONS
+/*
+ * Count all allocations made with new (which is used by std::string and
+ * the containers) so that the number made by each command can be reported.
+ */
+void *operator new(std::size_t size) {
+	void *ptr = std::malloc(size ? size : 1);
+
+	if (!ptr)
+		throw std::bad_alloc();
+
+	app::heap_allocations++;
+	app::heap_bytes += size;
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size __attribute__((unused))) noexcept {
+	std::free(ptr);
+}
+#endif
+
+#endif
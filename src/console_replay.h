@@ -0,0 +1,159 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ENV_NATIVE
+
+#include <Arduino.h>
+
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+/* Maximum time to wait for a command to finish */
+#ifndef APP_CONSOLE_REPLAY_TIMEOUT_MS
+# define APP_CONSOLE_REPLAY_TIMEOUT_MS 10000
+#endif
+
+/*
+ * Count heap allocations made by each command, by replacing the global
+ * operator new. This applies to the whole program so it should only be
+ * enabled for replay and test builds (see [app:console_replay] in
+ * pio/config.ini).
+ */
+#ifndef APP_CONSOLE_REPLAY_ALLOCATIONS
+# define APP_CONSOLE_REPLAY_ALLOCATIONS 0
+#endif
+
+namespace app {
+
+class App;
+class AppShell;
+
+/*
+ * Replays a scripted console session on the native build, measuring the
+ * time taken and the number of heap allocations made by each command.
+ *
+ * Set APP_CONSOLE_REPLAY to the filename of the script to run it instead
+ * of the interactive console. The process exits with status 1 if any
+ * command fails. Unit tests (in the native_test environment) can use
+ * run() and check that it returns 0.
+ *
+ * Script format, one item per line:
+ *   # comment
+ *   > command          Run a command and wait for the next prompt
+ *   + text             Further input for the command (e.g. passwords)
+ *   ~ regex            A line of output must match (after previous matches)
+ *   ! regex            No line of output may match
+ *   @ time <us>        Fail if the command takes longer than this
+ *   @ allocations <n>  Fail if the command makes more heap allocations
+ *                      (only checked if APP_CONSOLE_REPLAY_ALLOCATIONS)
+ *
+ * Timing starts when the console reads the end of the command line and
+ * stops when it displays the next prompt.
+ */
+class ConsoleReplay {
+public:
+	ConsoleReplay(App &app, Print &report, const std::string &filename);
+
+	/* Replay a script to completion and return the number of failures */
+	static unsigned long run(App &app, Print &report, const std::string &filename);
+
+	/* Returns true when the session has finished */
+	bool loop();
+
+	inline unsigned long failures() const { return failures_; }
+
+private:
+	static constexpr size_t OUTPUT_RESERVE = 64 * 1024;
+
+	struct Pattern {
+		bool match;
+		std::string text;
+		std::regex regex;
+	};
+
+	struct Command {
+		unsigned long line;
+		std::string text;
+		std::string input;
+		std::vector<Pattern> patterns;
+		unsigned long max_time_us{0};
+		unsigned long max_allocations{0};
+	};
+
+	class Console;
+
+	class ReplayStream: public Stream {
+	public:
+		ReplayStream(ConsoleReplay &replay) : replay_(replay) {}
+
+		int available() override;
+		int read() override;
+		int peek() override;
+		size_t write(uint8_t c) override;
+		size_t write(const uint8_t *buffer, size_t size) override;
+
+		void input(const std::string &text);
+		inline bool input_complete() const { return pos_ == input_.size(); }
+
+		std::string output_;
+
+	private:
+		ConsoleReplay &replay_;
+		std::string input_;
+		size_t pos_{0};
+	};
+
+	bool parse(const std::string &filename);
+	bool parse_line(unsigned long line, const std::string &text);
+	static bool parse_limit(Command &command, const std::string &text);
+	void command_started();
+	void prompt();
+	void complete();
+	static std::vector<std::string> output_lines(const std::string &output);
+	std::vector<std::string> check(const Command &command,
+		const std::vector<std::string> &lines, unsigned long time_us,
+		unsigned long allocations);
+	void fail(const Command &command, const std::string &reason);
+	void summary();
+
+	Print &report_;
+	ReplayStream stream_;
+	std::shared_ptr<AppShell> console_;
+	std::vector<Command> commands_;
+	size_t next_{0};
+	bool running_{false};
+	bool started_{false};
+	bool finished_{false};
+
+	uint64_t start_ms_{0};
+	unsigned long start_us_{0};
+	unsigned long start_allocations_{0};
+	size_t start_bytes_{0};
+	size_t output_start_{0};
+
+	unsigned long failures_{0};
+	unsigned long long total_time_us_{0};
+	unsigned long long total_allocations_{0};
+};
+
+} // namespace app
+
+#endif
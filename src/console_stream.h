@@ -20,7 +20,10 @@
 
 #include <uuid/console.h>
 
+#include <memory>
+
 #include "console.h"
+#include "queued_stream.h"
 
 #if __has_include("../../src/console_app_shell_type.h")
 # include "../../src/console_app_shell_type.h"
@@ -34,11 +37,17 @@ class AppConsole: public APP_SHELL_TYPE {
 public:
 	AppConsole(App &app, Stream &stream, bool local);
 #ifndef ENV_NATIVE
-	AppConsole(App &app, Stream &stream, const IPAddress &addr, uint16_t port);
+	AppConsole(App &app, std::unique_ptr<QueuedStream> stream, const IPAddress &addr, uint16_t port);
 #endif
 	~AppConsole() override;
 
 	std::string console_name();
+#ifndef ENV_NATIVE
+	inline QueuedStream *output_queue() { return output_queue_.get(); }
+	size_t output_available() override;
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override;
+#endif
 
 private:
 #ifndef ENV_NATIVE
@@ -50,7 +59,34 @@ private:
 	size_t pty_;
 	IPAddress addr_;
 	uint16_t port_;
+	std::unique_ptr<QueuedStream> output_queue_;
 #endif
 };
 
+#ifndef ENV_NATIVE
+class AppBatchConsole: public APP_SHELL_TYPE {
+public:
+	AppBatchConsole(App &app, Stream &stream, const std::string &name);
+	~AppBatchConsole() override = default;
+
+	std::string console_name();
+
+	/* Returns an error if the command could not be executed */
+	const __FlashStringHelper *execute(const std::string &line);
+
+	/*
+	 * The shell has read the end of input, so the command and anything it
+	 * blocked the shell with has finished.
+	 */
+	inline bool idle() const { return idle_; }
+
+protected:
+	void end_of_transmission() override;
+
+private:
+	std::string name_;
+	bool idle_{true};
+};
+#endif
+
 } // namespace app
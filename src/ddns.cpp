@@ -41,15 +41,12 @@
 #include <uuid/log.h>
 
 #include "app/config.h"
+#include "app/pstr.h"
 #include "app/util.h"
 
-#ifndef PSTR_ALIGN
-# define PSTR_ALIGN 4
-#endif
-
 namespace cbor = qindesign::cbor;
 
-static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "ddns";
+MAKE_PSTR(logger_name, "ddns")
 
 namespace app {
 
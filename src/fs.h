@@ -21,6 +21,12 @@
 #include <FS.h>
 #include <LittleFS.h>
 
+#include <string>
+
+#ifdef ARDUINO_ARCH_ESP32
+# include "ram_fs.h"
+#endif
+
 namespace app {
 
 static constexpr auto &FS = LittleFS;
@@ -42,4 +48,13 @@ inline bool FS_begin(bool formatOnFail) {
 	return ret;
 }
 
+/* Files under /tmp are in RAM (if it has been mounted) */
+inline fs::FS &FS_for(const std::string &path) {
+#ifdef ARDUINO_ARCH_ESP32
+	if (TMPFS.contains(path) && TMPFS.mounted())
+		return TMPFS;
+#endif
+	return FS;
+}
+
 } // namespace app
@@ -0,0 +1,444 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/fs_archive.h"
+
+#include <Arduino.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <CBOR.h>
+#include <uuid/common.h>
+
+#include "app/allocator.h"
+#include "app/fs.h"
+#include "app/util.h"
+
+namespace cbor = qindesign::cbor;
+
+namespace app {
+
+namespace fs_archive {
+
+/* CBOR initial bytes for the parts of the archive that have a fixed encoding */
+static constexpr uint8_t CBOR_INDEFINITE_ARRAY = 0x9F;
+static constexpr uint8_t CBOR_ENTRY_ARRAY = 0x84;
+static constexpr uint8_t CBOR_NULL = 0xF6;
+static constexpr uint8_t CBOR_BREAK = 0xFF;
+static constexpr uint8_t CBOR_INDEFINITE_LENGTH = 31;
+
+/* LittleFS is mounted by FS_begin() at the default base path */
+static const char LITTLEFS_BASE_PATH[] = "/littlefs";
+
+static std::string root_path(const std::string &path) {
+	std::string root = normalise_filename(path);
+
+	while (root.length() > 1 && root.back() == '/')
+		root.pop_back();
+
+	if (root.empty())
+		root.push_back('/');
+
+	return root;
+}
+
+static std::string child_path(const std::string &root, const std::string &path) {
+	return root.length() == 1 ? root + path : root + "/" + path;
+}
+
+Export::Export(Print &output, const std::string &path, Filter filter)
+		: writer_(output), filter_(filter), root_(root_path(path)),
+		pending_{root_} {
+	/* The filesystem budget may already be in use by another console */
+	if (allocator::available(allocator::Subsystem::FILESYSTEM) < BUFFER_SIZE) {
+		error_ = uuid::read_flash_string(F("Out of memory"));
+		done_ = true;
+		return;
+	}
+
+	buffer_.resize(BUFFER_SIZE);
+	writer_.writeTag(cbor::kSelfDescribeTag);
+	writer_.beginIndefiniteArray();
+}
+
+bool Export::step(size_t max_len) {
+	if (done_)
+		return true;
+
+	if (file_) {
+		done_ = !copy(max_len);
+	} else if (!pending_.empty()) {
+		std::string path = std::move(pending_.back());
+
+		pending_.pop_back();
+		entry(path);
+	} else {
+		writer_.endIndefinite();
+		done_ = true;
+	}
+
+	return done_;
+}
+
+void Export::entry(const std::string &path) {
+	const char mode[2] = { 'r', '\0' };
+	auto file = FS_for(path).open(path.c_str(), mode);
+
+	if (!file || !filter_(path)) {
+		skipped_++;
+		return;
+	}
+
+	if (file.isDirectory()) {
+		std::vector<std::string> children;
+
+		while (true) {
+			auto name = file.getNextFileName();
+
+			if (name.length() == 0)
+				break;
+
+			children.emplace_back(name.c_str());
+		}
+
+		/* Visit children in order by taking them from the end */
+		std::sort(children.begin(), children.end(), std::greater<std::string>());
+		pending_.insert(pending_.end(), children.begin(), children.end());
+
+		if (path == root_)
+			return;
+	}
+
+	std::string relative = path.substr(root_.length() == 1 ? 1 : root_.length() + 1);
+	size_t size = file.isDirectory() ? 0 : file.size();
+
+	writer_.beginArray(4);
+	write_text(writer_, relative);
+	writer_.writeUnsignedInt(size);
+	writer_.writeUnsignedInt(std::max(file.getLastWrite(), (time_t)0));
+
+	if (file.isDirectory()) {
+		writer_.writeNull();
+		directories_++;
+	} else {
+		writer_.beginBytes(size);
+		files_++;
+
+		if (size > 0) {
+			file_ = file;
+			filename_ = path;
+			remaining_ = size;
+		}
+	}
+}
+
+/* Returns false if the file could not be read */
+bool Export::copy(size_t max_len) {
+	size_t len = file_.read(buffer_.data(), std::min({buffer_.size(), remaining_, max_len}));
+
+	if (len == 0) {
+		error_ = filename_ + uuid::read_flash_string(F(": read error"));
+		file_.close();
+		return false;
+	}
+
+	writer_.writeBytes(buffer_.data(), len);
+	remaining_ -= len;
+	bytes_ += len;
+
+	if (!remaining_)
+		file_.close();
+
+	return true;
+}
+
+Import::Import(const std::string &path, Filter filter)
+		: filter_(filter), root_(root_path(path)) {
+	if (allocator::available(allocator::Subsystem::FILESYSTEM) < BUFFER_SIZE) {
+		fail(F("Out of memory"));
+		return;
+	}
+
+	buffer_.reserve(BUFFER_SIZE);
+}
+
+Import::~Import() {
+	if (file_)
+		fail(F("Interrupted"));
+}
+
+bool Import::write(const uint8_t *data, size_t len) {
+	while (len > 0 && error_.empty()) {
+		size_t used = 1;
+
+		switch (state_) {
+		case State::PATH_TEXT:
+			used = std::min((uint64_t)len, remaining_);
+			path_.append(reinterpret_cast<const char *>(data), used);
+			remaining_ -= used;
+
+			if (!remaining_)
+				end_path();
+			break;
+
+		case State::DATA:
+			used = std::min((uint64_t)std::min(len, BUFFER_SIZE - buffer_.size()), remaining_);
+			buffer_.insert(buffer_.end(), data, data + used);
+			remaining_ -= used;
+			bytes_ += used;
+
+			if (!remaining_) {
+				end_file();
+			} else if (buffer_.size() == BUFFER_SIZE) {
+				flush();
+			}
+			break;
+
+		case State::END:
+			fail(F("Data after end of archive"));
+			break;
+
+		case State::TAG:
+		case State::ARRAY:
+		case State::ENTRY:
+		case State::PATH:
+		case State::SIZE:
+		case State::MTIME:
+		case State::CONTENT:
+			if (header(*data))
+				process();
+			break;
+		}
+
+		data += used;
+		len -= used;
+	}
+
+	return error_.empty();
+}
+
+bool Import::finish() {
+	if (error_.empty() && state_ != State::END)
+		fail(F("Incomplete archive"));
+
+	return error_.empty();
+}
+
+/* Returns true when the header of a data item has been read */
+bool Import::header(uint8_t value) {
+	if (header_remaining_ > 0) {
+		value_ = (value_ << 8) | value;
+		return --header_remaining_ == 0;
+	}
+
+	uint8_t info = value & 0x1F;
+
+	initial_ = value;
+
+	if (info < 24) {
+		value_ = info;
+		return true;
+	} else if (info <= 27) {
+		value_ = 0;
+		header_remaining_ = 1 << (info - 24);
+		return false;
+	} else {
+		value_ = 0;
+		return true;
+	}
+}
+
+bool Import::process() {
+	uint8_t major = initial_ >> 5;
+
+	switch (state_) {
+	case State::TAG:
+		if (major != 6 || value_ != cbor::kSelfDescribeTag)
+			return fail(F("Not an archive"));
+
+		state_ = State::ARRAY;
+		return true;
+
+	case State::ARRAY:
+		if (initial_ != CBOR_INDEFINITE_ARRAY)
+			return fail(F("Not an archive"));
+
+		state_ = State::ENTRY;
+		return true;
+
+	case State::ENTRY:
+		if (initial_ == CBOR_BREAK) {
+			state_ = State::END;
+			return true;
+		} else if (initial_ != CBOR_ENTRY_ARRAY) {
+			return fail(F("Invalid entry"));
+		}
+
+		state_ = State::PATH;
+		return true;
+
+	case State::PATH:
+		if (major != 3 || value_ == 0 || value_ > MAX_PATH_LENGTH)
+			return fail(F("Invalid path"));
+
+		path_.clear();
+		remaining_ = value_;
+		state_ = State::PATH_TEXT;
+		return true;
+
+	case State::SIZE:
+		if (major != 0 || (initial_ & 0x1F) == CBOR_INDEFINITE_LENGTH)
+			return fail(filename_, F("invalid size"));
+
+		size_ = value_;
+		state_ = State::MTIME;
+		return true;
+
+	case State::MTIME:
+		if (major != 0 || (initial_ & 0x1F) == CBOR_INDEFINITE_LENGTH)
+			return fail(filename_, F("invalid modification time"));
+
+		mtime_ = value_;
+		state_ = State::CONTENT;
+		return true;
+
+	case State::CONTENT:
+		return begin_content();
+
+	case State::PATH_TEXT:
+	case State::DATA:
+	case State::END:
+		break;
+	}
+
+	return fail(F("Invalid archive"));
+}
+
+/* Paths must be relative and already normalised so that they stay inside the root */
+bool Import::end_path() {
+	if (path_.front() == '/' || path_.back() == '/'
+			|| path_.find('\0') != std::string::npos
+			|| normalise_filename(path_) != path_)
+		return fail(F("Invalid path"));
+
+	filename_ = child_path(root_, path_);
+
+	if (!filter_(filename_))
+		return fail(filename_, F("access denied"));
+
+	state_ = State::SIZE;
+	return true;
+}
+
+bool Import::begin_content() {
+	if (initial_ == CBOR_NULL) {
+		auto &fs = FS_for(filename_);
+
+		if (!fs.open(filename_.c_str()).isDirectory() && !fs.mkdir(filename_.c_str()))
+			return fail(filename_, F("unable to create directory"));
+
+		set_mtime(filename_);
+		directories_++;
+		state_ = State::ENTRY;
+		return true;
+	}
+
+	if ((initial_ >> 5) != 2 || (initial_ & 0x1F) == CBOR_INDEFINITE_LENGTH || value_ != size_)
+		return fail(filename_, F("invalid content"));
+
+	const char mode[2] = { 'w', '\0' };
+
+	file_ = FS_for(filename_).open(filename_.c_str(), mode, true);
+	if (!file_)
+		return fail(filename_, F("unable to open for writing"));
+
+	remaining_ = size_;
+	files_++;
+
+	if (!remaining_)
+		return end_file();
+
+	state_ = State::DATA;
+	return true;
+}
+
+bool Import::flush() {
+	if (buffer_.empty())
+		return true;
+
+	if (file_.write(buffer_.data(), buffer_.size()) != buffer_.size())
+		return fail(filename_, F("write error"));
+
+	buffer_.clear();
+	return true;
+}
+
+bool Import::end_file() {
+	if (!flush())
+		return false;
+
+	file_.close();
+	set_mtime(filename_);
+	state_ = State::ENTRY;
+	return true;
+}
+
+/*
+ * The Arduino filesystem API can't set the modification time, but the
+ * LittleFS VFS driver can. Files in RAM keep the current time.
+ */
+void Import::set_mtime(const std::string &path) {
+	if (&FS_for(path) != &FS || !mtime_)
+		return;
+
+	std::string vfs_path = LITTLEFS_BASE_PATH + path;
+	struct utimbuf times{};
+
+	times.actime = mtime_;
+	times.modtime = mtime_;
+	::utime(vfs_path.c_str(), &times);
+}
+
+/* Remove the current file because it is incomplete */
+bool Import::fail(const __FlashStringHelper *message) {
+	error_ = uuid::read_flash_string(message);
+
+	if (file_) {
+		file_.close();
+		FS_for(filename_).remove(filename_.c_str());
+	}
+
+	return false;
+}
+
+bool Import::fail(const std::string &path, const __FlashStringHelper *message) {
+	fail(message);
+	error_ = path + ": " + error_;
+	return false;
+}
+
+} // namespace fs_archive
+
+} // namespace app
+
+#endif
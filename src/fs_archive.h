@@ -0,0 +1,155 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <CBOR.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "app/allocator.h"
+
+namespace app {
+
+/*
+ * Archive of a directory tree, as a CBOR self-describe tag followed by an
+ * indefinite length array of entries. Each entry is an array of the path
+ * (relative to the directory being archived), the size, the modification
+ * time and either the contents of a file as a byte string or null for a
+ * directory. Directories are always before their contents.
+ */
+namespace fs_archive {
+
+/* Return false to exclude a path from the archive or refuse to write it */
+using Filter = std::function<bool(const std::string &path)>;
+
+class Export {
+public:
+	Export(Print &output, const std::string &path, Filter filter);
+
+	/*
+	 * Returns true when the archive is complete or there is an error. At
+	 * most max_len bytes of file data are output by each step.
+	 */
+	bool step(size_t max_len = SIZE_MAX);
+
+	const std::string &error() const { return error_; }
+	unsigned long files() const { return files_; }
+	unsigned long directories() const { return directories_; }
+	unsigned long skipped() const { return skipped_; }
+	unsigned long long bytes() const { return bytes_; }
+
+private:
+	static constexpr size_t BUFFER_SIZE = 4096;
+
+	void entry(const std::string &path);
+	bool copy(size_t max_len);
+
+	qindesign::cbor::Writer writer_;
+	Filter filter_;
+	std::string root_;
+	std::vector<std::string> pending_;
+	fs::File file_;
+	std::string filename_;
+	size_t remaining_{0};
+	allocator::buffer<allocator::Subsystem::FILESYSTEM> buffer_;
+	bool done_{false};
+	std::string error_;
+	unsigned long files_{0};
+	unsigned long directories_{0};
+	unsigned long skipped_{0};
+	unsigned long long bytes_{0};
+};
+
+/*
+ * Entries are written as they are received. Files are written through a
+ * buffer so that flash is written in large blocks, and a file that is
+ * incomplete because of an error is removed.
+ */
+class Import {
+public:
+	Import(const std::string &path, Filter filter);
+	~Import();
+
+	/* Returns false if there is an error */
+	bool write(const uint8_t *data, size_t len);
+	bool finish();
+
+	const std::string &error() const { return error_; }
+	unsigned long files() const { return files_; }
+	unsigned long directories() const { return directories_; }
+	unsigned long long bytes() const { return bytes_; }
+
+private:
+	static constexpr size_t BUFFER_SIZE = 4096;
+	static constexpr size_t MAX_PATH_LENGTH = 255;
+
+	enum class State : uint8_t {
+		TAG,
+		ARRAY,
+		ENTRY,
+		PATH,
+		PATH_TEXT,
+		SIZE,
+		MTIME,
+		CONTENT,
+		DATA,
+		END,
+	};
+
+	bool header(uint8_t value);
+	bool process();
+	bool end_path();
+	bool begin_content();
+	bool flush();
+	bool end_file();
+	void set_mtime(const std::string &path);
+	bool fail(const __FlashStringHelper *message);
+	bool fail(const std::string &path, const __FlashStringHelper *message);
+
+	Filter filter_;
+	std::string root_;
+	State state_{State::TAG};
+	uint8_t initial_{0};
+	uint8_t header_remaining_{0};
+	uint64_t value_{0};
+	std::string path_;
+	std::string filename_;
+	uint64_t size_{0};
+	time_t mtime_{0};
+	uint64_t remaining_{0};
+	fs::File file_;
+	allocator::buffer<allocator::Subsystem::FILESYSTEM> buffer_;
+	std::string error_;
+	unsigned long files_{0};
+	unsigned long directories_{0};
+	unsigned long long bytes_{0};
+};
+
+} // namespace fs_archive
+
+} // namespace app
+
+#endif
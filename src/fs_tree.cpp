@@ -0,0 +1,296 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/fs_tree.h"
+
+#include <Arduino.h>
+
+#include <string>
+#include <vector>
+
+#include <uuid/common.h>
+
+#include "app/allocator.h"
+#include "app/fs.h"
+#include "app/util.h"
+
+namespace app {
+
+namespace fs_tree {
+
+Job::Job(Operation operation, const std::string &from, const std::string &to, Filter filter)
+		: operation_(operation), from_(from), to_(to), filter_(filter) {
+}
+
+/* Remove the file being copied because it is incomplete */
+Job::~Job() {
+	if (to_file_)
+		fail(filename_, F("interrupted"));
+}
+
+bool Job::step() {
+	uint64_t start_ms = uuid::get_uptime_ms();
+
+	while (phase_ != Phase::DONE) {
+		if (!next()) {
+			phase_ = Phase::DONE;
+		} else if (uuid::get_uptime_ms() - start_ms >= STEP_TIME_MS) {
+			break;
+		}
+	}
+
+	return phase_ == Phase::DONE;
+}
+
+/* Returns false if there is an error */
+bool Job::next() {
+	switch (phase_) {
+	case Phase::START:
+		return start();
+
+	case Phase::COPY:
+		if (to_file_)
+			return copy_data();
+
+		if (stack_.empty()) {
+			if (operation_ == Operation::MOVE)
+				return start_remove();
+
+			phase_ = Phase::DONE;
+			return true;
+		}
+
+		return next_copy();
+
+	case Phase::REMOVE:
+		if (stack_.empty()) {
+			phase_ = Phase::DONE;
+			return true;
+		}
+
+		return next_remove();
+
+	case Phase::DONE:
+		break;
+	}
+
+	return true;
+}
+
+bool Job::start() {
+	switch (operation_) {
+	case Operation::COPY:
+		return start_copy();
+
+	case Operation::MOVE:
+		/* The whole tree can be renamed within a filesystem */
+		if (&FS_for(from_) == &FS_for(to_)) {
+			bool directory = FS_for(from_).open(from_.c_str()).isDirectory();
+
+			if (!FS_for(from_).rename(from_.c_str(), to_.c_str()))
+				return fail(from_, F("error"));
+
+			if (directory) {
+				directories_++;
+			} else {
+				files_++;
+			}
+
+			phase_ = Phase::DONE;
+			return true;
+		}
+
+		return start_copy();
+
+	case Operation::REMOVE:
+		return start_remove();
+	}
+
+	return true;
+}
+
+bool Job::start_copy() {
+	const char mode[2] = { 'r', '\0' };
+	auto file = FS_for(from_).open(from_.c_str(), mode);
+
+	if (!file)
+		return fail(from_, F("file not found"));
+
+	/* The filesystem budget may already be in use by another console */
+	if (allocator::available(allocator::Subsystem::FILESYSTEM) < BUFFER_SIZE)
+		return fail(from_, F("out of memory"));
+
+	buffer_.resize(BUFFER_SIZE);
+	phase_ = Phase::COPY;
+	return copy(from_, to_, file);
+}
+
+bool Job::next_copy() {
+	auto name = stack_.back().dir.getNextFileName();
+
+	if (name.length() == 0) {
+		stack_.pop_back();
+		return true;
+	}
+
+	std::string from = name.c_str();
+	std::string to = stack_.back().to + "/" + base_filename(from);
+	const char mode[2] = { 'r', '\0' };
+	auto file = FS_for(from).open(from.c_str(), mode);
+
+	if (!file)
+		return fail(from, F("file not found"));
+
+	return copy(from, to, file);
+}
+
+bool Job::copy(const std::string &from, const std::string &to, fs::File &file) {
+	if (!filter_(from))
+		return fail(from, F("access denied"));
+
+	if (!filter_(to))
+		return fail(to, F("access denied"));
+
+	if (file.isDirectory()) {
+		auto &to_fs = FS_for(to);
+
+		if (!to_fs.open(to.c_str()).isDirectory() && !to_fs.mkdir(to.c_str()))
+			return fail(to, F("unable to create directory"));
+
+		directories_++;
+		stack_.push_back({from, to, file});
+		return true;
+	}
+
+	const char mode[2] = { 'w', '\0' };
+
+	to_file_ = FS_for(to).open(to.c_str(), mode, true);
+	if (!to_file_)
+		return fail(to, F("open error"));
+
+	from_file_ = file;
+	filename_ = to;
+	files_++;
+	return true;
+}
+
+bool Job::copy_data() {
+	size_t len = from_file_.read(buffer_.data(), buffer_.size());
+
+	if (len > 0) {
+		if (to_file_.write(buffer_.data(), len) != len)
+			return fail(filename_, F("write error"));
+
+		bytes_ += len;
+		return true;
+	}
+
+	from_file_.close();
+	to_file_.close();
+	return true;
+}
+
+bool Job::start_remove() {
+	const char mode[2] = { 'r', '\0' };
+	auto file = FS_for(from_).open(from_.c_str(), mode);
+
+	if (!file)
+		return fail(from_, F("file not found"));
+
+	phase_ = Phase::REMOVE;
+	return remove(from_, file);
+}
+
+/*
+ * Directories are reread from the start after each removal because
+ * LittleFS can skip the next entry when the current one is removed.
+ */
+bool Job::next_remove() {
+	auto name = stack_.back().dir.getNextFileName();
+
+	if (name.length() == 0) {
+		std::string path = std::move(stack_.back().from);
+
+		stack_.pop_back();
+
+		if (path != "/") {
+			if (!FS_for(path).rmdir(path.c_str()))
+				return fail(path, F("error"));
+
+			directories_++;
+		}
+
+		if (!stack_.empty())
+			stack_.back().dir.rewindDirectory();
+
+		return true;
+	}
+
+	std::string path = name.c_str();
+	const char mode[2] = { 'r', '\0' };
+	auto file = FS_for(path).open(path.c_str(), mode);
+
+	if (!file)
+		return fail(path, F("file not found"));
+
+	return remove(path, file);
+}
+
+bool Job::remove(const std::string &path, fs::File &file) {
+	if (!filter_(path))
+		return fail(path, F("access denied"));
+
+	if (file.isDirectory()) {
+		stack_.push_back({path, {}, file});
+		return true;
+	}
+
+	size_t size = file.size();
+
+	file.close();
+
+	if (!FS_for(path).remove(path.c_str()))
+		return fail(path, F("error"));
+
+	files_++;
+	bytes_ += size;
+
+	if (!stack_.empty())
+		stack_.back().dir.rewindDirectory();
+
+	return true;
+}
+
+bool Job::fail(const std::string &path, const __FlashStringHelper *message) {
+	error_ = path + ": " + uuid::read_flash_string(message);
+
+	if (to_file_) {
+		to_file_.close();
+		FS_for(filename_).remove(filename_.c_str());
+	}
+
+	from_file_.close();
+	return false;
+}
+
+} // namespace fs_tree
+
+} // namespace app
+
+#endif
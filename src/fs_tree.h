@@ -0,0 +1,113 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "app/allocator.h"
+
+namespace app {
+
+/*
+ * Recursive copy, move and remove of a directory tree.
+ *
+ * The tree is traversed once using a stack of open directories, so memory
+ * use depends on the depth of the tree and not the number of entries.
+ * Work is done in short steps so that the rest of the application keeps
+ * running, and the operation stops at the first error.
+ */
+namespace fs_tree {
+
+enum class Operation : uint8_t {
+	COPY,
+	MOVE,
+	REMOVE,
+};
+
+/* Return false to refuse access to a path */
+using Filter = std::function<bool(const std::string &path)>;
+
+class Job {
+public:
+	Job(Operation operation, const std::string &from, const std::string &to, Filter filter);
+	~Job();
+
+	/* Returns true when the operation is complete or there is an error */
+	bool step();
+
+	const std::string &error() const { return error_; }
+	unsigned long files() const { return files_; }
+	unsigned long directories() const { return directories_; }
+	unsigned long long bytes() const { return bytes_; }
+
+private:
+	static constexpr uint64_t STEP_TIME_MS = 10;
+	static constexpr size_t BUFFER_SIZE = 4096;
+
+	enum class Phase : uint8_t {
+		START,
+		COPY,
+		REMOVE,
+		DONE,
+	};
+
+	struct Directory {
+		std::string from;
+		std::string to;
+		fs::File dir;
+	};
+
+	bool next();
+	bool start();
+	bool start_copy();
+	bool start_remove();
+	bool next_copy();
+	bool copy(const std::string &from, const std::string &to, fs::File &file);
+	bool copy_data();
+	bool next_remove();
+	bool remove(const std::string &path, fs::File &file);
+	bool fail(const std::string &path, const __FlashStringHelper *message);
+
+	Operation operation_;
+	std::string from_;
+	std::string to_;
+	Filter filter_;
+	Phase phase_{Phase::START};
+	std::vector<Directory> stack_;
+	fs::File from_file_;
+	fs::File to_file_;
+	std::string filename_;
+	allocator::buffer<allocator::Subsystem::FILESYSTEM> buffer_;
+	std::string error_;
+	unsigned long files_{0};
+	unsigned long directories_{0};
+	unsigned long long bytes_{0};
+};
+
+} // namespace fs_tree
+
+} // namespace app
+
+#endif
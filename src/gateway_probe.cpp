@@ -0,0 +1,406 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENV_NATIVE
+#include "app/gateway_probe.h"
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_ESP8266)
+# include <ESP8266WiFi.h>
+# include <lwip/raw.h>
+#elif defined(ARDUINO_ARCH_ESP32)
+# include <WiFi.h>
+# include <esp_pthread.h>
+# include <lwip/sockets.h>
+# include <unistd.h>
+#else
+# error "Unknown arch"
+#endif
+#include <lwip/inet_chksum.h>
+#include <lwip/prot/icmp.h>
+#include <lwip/prot/ip4.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <initializer_list>
+#ifdef ARDUINO_ARCH_ESP32
+# include <thread>
+#endif
+
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+
+MAKE_PSTR(logger_name, "probe")
+
+namespace app {
+
+/* Upper bounds of the histogram buckets (the last one is unbounded) */
+static const std::array<uint32_t, GatewayProbe::HISTOGRAM_BUCKETS - 1> histogram_bounds_ms{
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000
+};
+
+uuid::log::Logger GatewayProbe::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
+
+void GatewayProbe::Window::clear() {
+	sent = 0;
+	received = 0;
+	rtt_min_us = UINT32_MAX;
+	rtt_max_us = 0;
+	rtt_sum_us = 0;
+	histogram.fill(0);
+}
+
+void GatewayProbe::Window::add(const Window &other) {
+	sent += other.sent;
+	received += other.received;
+	rtt_min_us = std::min(rtt_min_us, other.rtt_min_us);
+	rtt_max_us = std::max(rtt_max_us, other.rtt_max_us);
+	rtt_sum_us += other.rtt_sum_us;
+
+	for (size_t i = 0; i < histogram.size(); i++)
+		histogram[i] += other.histogram[i];
+}
+
+GatewayProbe::GatewayProbe() {
+	for (auto &window : minutes_)
+		window.clear();
+
+	total_.clear();
+}
+
+GatewayProbe::~GatewayProbe() {
+	close();
+}
+
+void GatewayProbe::loop() {
+	uint64_t now_ms = uuid::get_uptime_ms();
+
+	rotate(now_ms);
+
+	if (WiFi.status() != WL_CONNECTED) {
+		if (waiting_) {
+			waiting_ = false;
+			record(false, 0);
+		}
+		close();
+		return;
+	}
+
+	receive();
+
+	if (waiting_) {
+		if (replied_) {
+			waiting_ = false;
+			record(true, reply_us_ - sent_us_);
+		} else if (now_ms - last_send_ms_ >= TIMEOUT_MS) {
+			waiting_ = false;
+			record(false, 0);
+		}
+	}
+
+	if (!waiting_ && now_ms - last_send_ms_ >= INTERVAL_MS) {
+		IPAddress gateway = WiFi.gatewayIP();
+
+		if (gateway != IPAddress(0, 0, 0, 0) && open()) {
+			last_send_ms_ = now_ms;
+			send(gateway);
+		}
+	}
+}
+
+void GatewayProbe::rotate(uint64_t now_ms) {
+	if (now_ms - minute_start_ms_ < MINUTE_MS)
+		return;
+
+	const Window &minute = minutes_[current_];
+
+	if (minute.sent > 0) {
+		logger_.trace(F("Gateway sent=%lu received=%lu rtt_min=%luus rtt_avg=%luus rtt_max=%luus"),
+			(unsigned long)minute.sent, (unsigned long)minute.received,
+			(unsigned long)(minute.received ? minute.rtt_min_us : 0),
+			(unsigned long)(minute.received ? minute.rtt_sum_us / minute.received : 0),
+			(unsigned long)minute.rtt_max_us);
+	}
+
+	current_ = (current_ + 1) % minutes_.size();
+	minutes_[current_].clear();
+	minute_start_ms_ = now_ms;
+}
+
+void GatewayProbe::record(bool received, unsigned long rtt_us) {
+	Window &minute = minutes_[current_];
+
+	minute.sent++;
+	total_.sent++;
+
+	if (!received)
+		return;
+
+	size_t bucket = 0;
+
+	while (bucket < histogram_bounds_ms.size() && rtt_us >= histogram_bounds_ms[bucket] * 1000)
+		bucket++;
+
+	for (Window *window : {&minute, &total_}) {
+		window->received++;
+		window->rtt_min_us = std::min(window->rtt_min_us, (uint32_t)rtt_us);
+		window->rtt_max_us = std::max(window->rtt_max_us, (uint32_t)rtt_us);
+		window->rtt_sum_us += rtt_us;
+		window->histogram[bucket]++;
+	}
+}
+
+GatewayProbe::Window GatewayProbe::window(unsigned int minutes) const {
+	Window window;
+
+	window.clear();
+
+	minutes = std::min((size_t)minutes, minutes_.size());
+	for (size_t i = 0; i < minutes; i++)
+		window.add(minutes_[(current_ + minutes_.size() - i) % minutes_.size()]);
+
+	return window;
+}
+
+void GatewayProbe::print_window(uuid::console::Shell &shell, const __FlashStringHelper *name, const Window &window) {
+	unsigned long lost = window.sent - window.received;
+
+	shell.printf(F("Gateway %S: "), name);
+
+	if (window.sent == 0) {
+		shell.println(F("no data"));
+		return;
+	}
+
+	shell.printfln(F("%lu/%lu lost (%lu.%02lu%%)"),
+		lost, (unsigned long)window.sent,
+		(unsigned long)(lost * 100 / window.sent),
+		(unsigned long)(lost * 10000 / window.sent % 100));
+
+	if (window.received == 0)
+		return;
+
+	shell.printfln(F("  RTT min/avg/max: %lu.%03lu/%lu.%03lu/%lu.%03lu ms"),
+		(unsigned long)(window.rtt_min_us / 1000), (unsigned long)(window.rtt_min_us % 1000),
+		(unsigned long)(window.rtt_sum_us / window.received / 1000), (unsigned long)(window.rtt_sum_us / window.received % 1000),
+		(unsigned long)(window.rtt_max_us / 1000), (unsigned long)(window.rtt_max_us % 1000));
+
+	shell.print(F("  Histogram (ms):"));
+	for (size_t i = 0; i < window.histogram.size(); i++) {
+		if (i < histogram_bounds_ms.size()) {
+			shell.printf(F(" <%lu:%lu"), (unsigned long)histogram_bounds_ms[i], (unsigned long)window.histogram[i]);
+		} else {
+			shell.printf(F(" >=%lu:%lu"), (unsigned long)histogram_bounds_ms[i - 1], (unsigned long)window.histogram[i]);
+		}
+	}
+	shell.println();
+}
+
+void GatewayProbe::print_status(uuid::console::Shell &shell) {
+	print_window(shell, F("1 minute"), window(1));
+	print_window(shell, F("15 minutes"), window(MINUTES));
+	print_window(shell, F("total"), total_);
+}
+
+void GatewayProbe::reply(const uint8_t *data, size_t len) {
+	if (len < sizeof(struct ip_hdr))
+		return;
+
+	const struct ip_hdr *iphdr = reinterpret_cast<const struct ip_hdr *>(data);
+	size_t hlen = IPH_HL(iphdr) * 4;
+
+	if (len < hlen + sizeof(struct icmp_echo_hdr))
+		return;
+
+	const struct icmp_echo_hdr *icmp = reinterpret_cast<const struct icmp_echo_hdr *>(data + hlen);
+
+	if (ICMPH_TYPE(icmp) == ICMP_ER && icmp->id == PP_HTONS(ICMP_ID)
+			&& icmp->seqno == lwip_htons(seq_) && waiting_ && !replied_) {
+		reply_us_ = micros();
+		replied_ = true;
+	}
+}
+
+#if defined(ARDUINO_ARCH_ESP8266)
+bool GatewayProbe::open() {
+	if (pcb_)
+		return true;
+
+	pcb_ = raw_new(IP_PROTO_ICMP);
+	if (!pcb_) {
+		return false;
+	}
+
+	raw_recv(pcb_, raw_receive, this);
+	raw_bind(pcb_, IP_ADDR_ANY);
+	return true;
+}
+
+void GatewayProbe::close() {
+	if (pcb_) {
+		raw_remove(pcb_);
+		pcb_ = nullptr;
+	}
+}
+
+uint8_t GatewayProbe::raw_receive(void *arg, struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr) {
+	auto *probe = reinterpret_cast<GatewayProbe *>(arg);
+	std::array<uint8_t, sizeof(struct ip_hdr) + 40 + sizeof(struct icmp_echo_hdr)> buffer;
+	size_t len = pbuf_copy_partial(p, buffer.data(), std::min((size_t)p->tot_len, buffer.size()), 0);
+	bool ours = probe->waiting_ && !probe->replied_;
+
+	probe->reply(buffer.data(), len);
+
+	if (ours && probe->replied_) {
+		pbuf_free(p);
+		return 1;
+	}
+
+	return 0;
+}
+
+void GatewayProbe::send(const IPAddress &gateway) {
+	struct pbuf *p = pbuf_alloc(PBUF_IP, sizeof(struct icmp_echo_hdr) + PAYLOAD_SIZE, PBUF_RAM);
+
+	if (!p)
+		return;
+
+	auto *icmp = reinterpret_cast<struct icmp_echo_hdr *>(p->payload);
+
+	seq_++;
+	ICMPH_TYPE_SET(icmp, ICMP_ECHO);
+	ICMPH_CODE_SET(icmp, 0);
+	icmp->id = PP_HTONS(ICMP_ID);
+	icmp->seqno = lwip_htons(seq_);
+	icmp->chksum = 0;
+	std::memset(reinterpret_cast<uint8_t *>(icmp) + sizeof(*icmp), 0, PAYLOAD_SIZE);
+	icmp->chksum = inet_chksum(icmp, p->len);
+
+	ip_addr_t addr = IPADDR4_INIT((uint32_t)gateway);
+
+	waiting_ = true;
+	replied_ = false;
+	sent_us_ = micros();
+
+	if (raw_sendto(pcb_, p, &addr) != ERR_OK) {
+		waiting_ = false;
+	}
+
+	pbuf_free(p);
+}
+
+void GatewayProbe::receive() {
+	/* Replies are processed by the raw_receive() callback */
+}
+#elif defined(ARDUINO_ARCH_ESP32)
+bool GatewayProbe::open() {
+	if (fd_ >= 0)
+		return true;
+
+	fd_ = ::socket(AF_INET, SOCK_RAW, IP_PROTO_ICMP);
+	if (fd_ < 0) {
+		return false;
+	}
+
+	/* The receive thread checks if it should stop after a timeout */
+	struct timeval timeout{};
+	timeout.tv_usec = RECEIVE_TIMEOUT_MS * 1000;
+	::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	try {
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		/* Run as soon as a reply arrives, instead of when the loop yields */
+		cfg.prio = uxTaskPriorityGet(nullptr) + 1;
+		esp_pthread_set_cfg(&cfg);
+
+		running_ = true;
+		thread_ = std::thread{[this] { this->run(); }};
+	} catch (...) {
+		logger_.emerg("Out of memory");
+		running_ = false;
+		::close(fd_);
+		fd_ = -1;
+		return false;
+	}
+
+	return true;
+}
+
+void GatewayProbe::close() {
+	if (fd_ >= 0) {
+		running_ = false;
+		thread_.join();
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+void GatewayProbe::send(const IPAddress &gateway) {
+	std::array<uint8_t, sizeof(struct icmp_echo_hdr) + PAYLOAD_SIZE> buffer{};
+	auto *icmp = reinterpret_cast<struct icmp_echo_hdr *>(buffer.data());
+	struct sockaddr_in addr{};
+
+	seq_++;
+	ICMPH_TYPE_SET(icmp, ICMP_ECHO);
+	ICMPH_CODE_SET(icmp, 0);
+	icmp->id = PP_HTONS(ICMP_ID);
+	icmp->seqno = lwip_htons(seq_);
+	icmp->chksum = inet_chksum(buffer.data(), buffer.size());
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = (uint32_t)gateway;
+
+	waiting_ = true;
+	replied_ = false;
+	sent_us_ = micros();
+
+	if (::sendto(fd_, buffer.data(), buffer.size(), 0,
+			reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+		waiting_ = false;
+	}
+}
+
+void GatewayProbe::receive() {
+	/* Replies are processed by the run() thread */
+}
+
+/* Wait for replies so that they're timestamped when they arrive */
+void GatewayProbe::run() {
+	std::array<uint8_t, 128> buffer;
+
+	while (running_) {
+		ssize_t len = ::recv(fd_, buffer.data(), buffer.size(), 0);
+
+		if (len > 0)
+			reply(buffer.data(), len);
+	}
+}
+#else
+# error "Unknown arch"
+#endif
+
+} // namespace app
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef ENV_NATIVE
+
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP8266
+# include <ESP8266WiFi.h>
+#else
+# include <WiFi.h>
+#endif
+
+#include <array>
+#include <atomic>
+#ifdef ARDUINO_ARCH_ESP32
+# include <thread>
+#endif
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#ifdef ARDUINO_ARCH_ESP8266
+struct raw_pcb;
+struct pbuf;
+#endif
+
+namespace app {
+
+/*
+ * Sends an ICMP echo request to the gateway every second and records the
+ * round trip time in a histogram, with loss and RTT statistics over sliding
+ * windows of the last minute and the last 15 minutes.
+ *
+ * Replies are timestamped as soon as they're received (by the lwIP callback
+ * or a receive thread) so the RTT doesn't include main loop latency.
+ */
+class GatewayProbe {
+public:
+	static constexpr size_t HISTOGRAM_BUCKETS = 11;
+
+	struct Window {
+		void clear();
+		void add(const Window &other);
+
+		uint32_t sent;
+		uint32_t received;
+		uint32_t rtt_min_us;
+		uint32_t rtt_max_us;
+		uint64_t rtt_sum_us;
+		std::array<uint32_t, HISTOGRAM_BUCKETS> histogram;
+	};
+
+	GatewayProbe();
+	~GatewayProbe();
+
+	void loop();
+	void print_status(uuid::console::Shell &shell);
+
+	Window window(unsigned int minutes) const;
+	const Window &total() const { return total_; }
+
+private:
+	static constexpr unsigned long INTERVAL_MS = 1000;
+	static constexpr unsigned long TIMEOUT_MS = 1000;
+	static constexpr unsigned long MINUTE_MS = 60 * 1000;
+	static constexpr size_t MINUTES = 15;
+	static constexpr uint16_t ICMP_ID = 0xAFAF;
+	static constexpr size_t PAYLOAD_SIZE = 32;
+
+	static uuid::log::Logger logger_;
+
+	bool open();
+	void close();
+	void send(const IPAddress &gateway);
+	void receive();
+	void reply(const uint8_t *data, size_t len);
+	void record(bool received, unsigned long rtt_us);
+	void rotate(uint64_t now_ms);
+	static void print_window(uuid::console::Shell &shell, const __FlashStringHelper *name, const Window &window);
+
+#ifdef ARDUINO_ARCH_ESP8266
+	static uint8_t raw_receive(void *arg, struct raw_pcb *pcb, struct pbuf *p, const ip_addr_t *addr);
+
+	struct raw_pcb *pcb_{nullptr};
+#else
+	static constexpr size_t TASK_STACK_SIZE = 3 * 1024;
+	static constexpr unsigned long RECEIVE_TIMEOUT_MS = 100;
+
+	void run();
+
+	int fd_{-1};
+	std::atomic<bool> running_{false};
+	std::thread thread_;
+#endif
+	std::atomic<uint16_t> seq_{0};
+	std::atomic<bool> waiting_{false};
+	std::atomic<bool> replied_{false};
+	unsigned long sent_us_{0};
+	std::atomic<unsigned long> reply_us_{0};
+	uint64_t last_send_ms_{0};
+	uint64_t minute_start_ms_{0};
+	size_t current_{0};
+	std::array<Window, MINUTES> minutes_;
+	Window total_;
+};
+
+} // namespace app
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "app/isr_log.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+
+MAKE_PSTR(logger_name, "isr")
+
+namespace app {
+
+namespace isr_log {
+
+static_assert((APP_ISR_LOG_QUEUE_SIZE & (APP_ISR_LOG_QUEUE_SIZE - 1)) == 0,
+	"APP_ISR_LOG_QUEUE_SIZE must be a power of 2");
+
+static constexpr uint32_t QUEUE_SIZE = APP_ISR_LOG_QUEUE_SIZE;
+static constexpr uint32_t QUEUE_MASK = QUEUE_SIZE - 1;
+static constexpr size_t TEXT_SIZE = 160;
+
+struct Record {
+	uuid::log::Logger *logger;
+	const __FlashStringHelper *format;
+	std::array<uint32_t, 4> args;
+	uuid::log::Level level;
+};
+
+/*
+ * Bounded multiple producer, single consumer queue. Each slot has a
+ * sequence number that is equal to the producer position when the slot is
+ * free and one more than that when the record is ready. The slot index is
+ * subtracted from the stored sequence number so that the queue is valid
+ * when zero-initialised (it can be used before static initialisation).
+ */
+struct Slot {
+	std::atomic<uint32_t> sequence;
+	Record record;
+};
+
+static uuid::log::Logger queue_logger{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
+static std::array<Slot, QUEUE_SIZE> slots;
+static std::atomic<uint32_t> head;
+static uint32_t tail;
+static std::atomic<unsigned long> overruns;
+static unsigned long reported_overruns;
+static std::atomic<unsigned long> discards;
+static unsigned long reported_discards;
+static unsigned long logged;
+static uint32_t peak;
+
+IRAM_ATTR bool in_interrupt() {
+#if defined(ARDUINO_ARCH_ESP8266) || defined(CONFIG_IDF_TARGET_ARCH_XTENSA)
+	uint32_t ps;
+
+	__asm__ __volatile__("rsr %0, ps" : "=r"(ps));
+
+	/* In an interrupt handler or with interrupts disabled */
+	return (ps & 0xF) != 0;
+#else
+	return false;
+#endif
+}
+
+IRAM_ATTR bool log(uuid::log::Logger &logger, uuid::log::Level level,
+		const __FlashStringHelper *format, uint32_t arg0, uint32_t arg1,
+		uint32_t arg2, uint32_t arg3) {
+	uint32_t pos = head.load(std::memory_order_relaxed);
+	Slot *slot;
+
+	while (true) {
+		slot = &slots[pos & QUEUE_MASK];
+
+		int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire)
+			+ (pos & QUEUE_MASK) - pos);
+
+		if (diff == 0) {
+			if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			overruns.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		} else {
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->record.logger = &logger;
+	slot->record.format = format;
+	slot->record.args = {arg0, arg1, arg2, arg3};
+	slot->record.level = level;
+	slot->sequence.store(pos + 1 - (pos & QUEUE_MASK), std::memory_order_release);
+	return true;
+}
+
+IRAM_ATTR void discard() {
+	discards.fetch_add(1, std::memory_order_relaxed);
+}
+
+void loop() {
+	std::array<char, TEXT_SIZE> text;
+	unsigned long dropped = overruns.load(std::memory_order_relaxed);
+	unsigned long discarded = discards.load(std::memory_order_relaxed);
+
+	peak = std::max(peak, head.load(std::memory_order_relaxed) - tail);
+
+	while (true) {
+		Slot &slot = slots[tail & QUEUE_MASK];
+
+		if (slot.sequence.load(std::memory_order_acquire) + (tail & QUEUE_MASK) != tail + 1)
+			break;
+
+		Record record = slot.record;
+
+		slot.sequence.store(tail + QUEUE_SIZE - (tail & QUEUE_MASK), std::memory_order_release);
+		tail++;
+
+		int len = snprintf_P(text.data(), text.size(), reinterpret_cast<PGM_P>(record.format),
+			record.args[0], record.args[1], record.args[2], record.args[3]);
+
+		len = std::min(len, (int)text.size() - 1);
+
+		while (len > 0 && (text[len - 1] == '\r' || text[len - 1] == '\n'))
+			text[--len] = '\0';
+
+		if (len > 0)
+			record.logger->logp(record.level, text.data());
+
+		logged++;
+	}
+
+	if (dropped != reported_overruns) {
+		queue_logger.warning(F("Dropped %lu log messages from interrupts"), dropped - reported_overruns);
+		reported_overruns = dropped;
+	}
+
+	if (discarded != reported_discards) {
+		queue_logger.warning(F("Discarded %lu unformatted messages from interrupts"), discarded - reported_discards);
+		reported_discards = discarded;
+	}
+}
+
+void show(uuid::console::Shell &shell) {
+	shell.printfln(F("Interrupt log queue: %lu logged, %lu dropped, %lu discarded, peak %lu/%lu"),
+		logged, overruns.load(std::memory_order_relaxed),
+		discards.load(std::memory_order_relaxed),
+		(unsigned long)peak, (unsigned long)QUEUE_SIZE);
+}
+
+} // namespace isr_log
+
+} // namespace app
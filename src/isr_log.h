@@ -0,0 +1,71 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstdint>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+/* Number of log records that can be queued (must be a power of 2) */
+#ifndef APP_ISR_LOG_QUEUE_SIZE
+# if defined(ARDUINO_ARCH_ESP8266)
+#  define APP_ISR_LOG_QUEUE_SIZE 16
+# else
+#  define APP_ISR_LOG_QUEUE_SIZE 64
+# endif
+#endif
+
+namespace app {
+
+/*
+ * Logging from interrupt handlers and critical sections, where the logger
+ * can't be used because it allocates memory and takes locks.
+ *
+ * A fixed-size record (the logger, format string and up to 4 integer
+ * arguments) is added to a lock-free queue without formatting it. The
+ * queue is emptied by loop() and the records are formatted and logged
+ * normally. Records are dropped (and counted) if the queue is full.
+ *
+ * The format string and logger must be static. Arguments for "%s" must
+ * point to static strings.
+ */
+namespace isr_log {
+
+bool log(uuid::log::Logger &logger, uuid::log::Level level,
+	const __FlashStringHelper *format, uint32_t arg0 = 0, uint32_t arg1 = 0,
+	uint32_t arg2 = 0, uint32_t arg3 = 0);
+
+/*
+ * Count a message that can't be logged because it wasn't made with log(),
+ * e.g. a variadic printf() where the argument types are unknown.
+ */
+void discard();
+
+/* Check if the current code can't use the logger */
+bool in_interrupt();
+
+void loop();
+void show(uuid::console::Shell &shell);
+
+} // namespace isr_log
+
+} // namespace app
@@ -18,12 +18,33 @@
 
 #ifdef ARDUINO_ARCH_ESP32
 
+#include "app/littlefs_block_cache.h"
+
 #include <Arduino.h>
+#include <esp_pthread.h>
 #include <esp_timer.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/fs.h"
+#include "app/pstr.h"
+#include "app/util.h"
+
+namespace cbor = qindesign::cbor;
 
 struct lfs_config;
 typedef uint32_t lfs_block_t;
@@ -33,6 +54,9 @@ typedef uint32_t lfs_size_t;
 extern "C" int __real_littlefs_api_read(const struct lfs_config *c,
 	lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
 
+MAKE_PSTR(logger_name, "fs")
+MAKE_PSTR(snapshot_filename, "/fscache.cbor")
+
 namespace app {
 
 namespace filesystem_cache {
@@ -49,11 +73,38 @@ static constexpr size_t FILESYSTEM_CACHE_SIZE = 2 * 1024 * 1024;
 
 static constexpr size_t FILESYSTEM_BLOCKS = FILESYSTEM_SIZE / FILESYSTEM_BLOCK_SIZE;
 static constexpr size_t FILESYSTEM_CACHE_BLOCKS = FILESYSTEM_CACHE_SIZE / FILESYSTEM_BLOCK_SIZE;
+static constexpr unsigned long BENCHMARK_DURATION_MS = 1000;
+static constexpr unsigned long BENCHMARK_STEP_MS = 10;
+static constexpr size_t BENCHMARK_CACHE_BLOCKS = 16;
+static constexpr unsigned long BENCHMARK_SLOW_US = 10;
+static constexpr size_t BENCHMARK_READ_SIZE = 16;
+static constexpr size_t PREFETCH_TASK_STACK_SIZE = 3 * 1024;
+static constexpr uint64_t SNAPSHOT_IDLE_MS = 60 * 1000;
+static uuid::log::Logger logger{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
 static uint8_t* cache = nullptr;
 static uint16_t* block_index = nullptr;
 static uint16_t* cache_index = nullptr;
 static int used_cache_size = 0;
 
+/* Blocks read between mount and the first write (the allocation scan) */
+static std::array<uint8_t, FILESYSTEM_BLOCKS / 8> read_before_write{};
+static std::array<uint8_t, FILESYSTEM_BLOCKS / 8> loaded_snapshot{};
+static const struct lfs_config *config = nullptr;
+/* Held while a block is loaded into the cache or a prefetched block could be written */
+static std::mutex fill_mutex;
+static std::atomic<bool> tracking{false};
+static bool bypassed = false;
+static bool snapshot_saved = false;
+static uint64_t mount_us = 0;
+static uint64_t first_write_us = 0;
+static uint64_t first_write_ms = 0;
+static std::thread prefetch_thread;
+static std::atomic<bool> prefetch_running{false};
+static std::atomic<unsigned long> prefetch_blocks{0};
+static uint64_t prefetch_us = 0;
+static unsigned long misses_before_write = 0;
+static uint64_t miss_us_before_write = 0;
+
 static void init() {
 	if (!cache) {
 		cache = reinterpret_cast<uint8_t*>(::heap_caps_malloc(FILESYSTEM_CACHE_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
@@ -62,13 +113,84 @@ static void init() {
 		memset(block_index, 0xFF, FILESYSTEM_BLOCKS * sizeof(uint16_t));
 
 		cache_index = reinterpret_cast<uint16_t*>(::heap_caps_malloc(FILESYSTEM_CACHE_BLOCKS * sizeof(uint16_t), MALLOC_CAP_DMA | MALLOC_CAP_8BIT));
-		memset(block_index, 0xFF, FILESYSTEM_CACHE_BLOCKS * sizeof(uint16_t));
+		memset(cache_index, 0xFF, FILESYSTEM_CACHE_BLOCKS * sizeof(uint16_t));
 	}
 }
 
-static int read(const struct lfs_config *c,
+/*
+ * The block is only added to the index once its data has been read, so
+ * read() doesn't need to lock anything for a cache hit.
+ */
+static int load(const struct lfs_config *c, lfs_block_t block, uint16_t pos) {
+	int ret = __real_littlefs_api_read(c, block, 0,
+		cache + pos * FILESYSTEM_BLOCK_SIZE, FILESYSTEM_BLOCK_SIZE);
+
+	if (!ret) {
+		std::atomic_thread_fence(std::memory_order_release);
+		cache_index[pos] = block;
+		block_index[block] = pos;
+	}
+
+	return ret;
+}
+
+static int fill(const struct lfs_config *c, lfs_block_t block) {
+	std::lock_guard<std::mutex> lock{fill_mutex};
+	uint16_t pos;
+
+	/* Prefetched while waiting for the lock */
+	if (block_index[block] != UINT16_MAX)
+		return 0;
+
+	if (used_cache_size >= FILESYSTEM_CACHE_BLOCKS) {
+		pos = rand() % FILESYSTEM_CACHE_BLOCKS;
+
+		if (cache_index[pos] != UINT16_MAX) {
+			block_index[cache_index[pos]] = UINT16_MAX;
+			cache_index[pos] = UINT16_MAX;
+		}
+	} else {
+		pos = used_cache_size++;
+	}
+
+	uint64_t start_us = tracking ? esp_timer_get_time() : 0;
+	int ret = load(c, block, pos);
+
+	if (tracking) {
+		misses_before_write++;
+		miss_us_before_write += esp_timer_get_time() - start_us;
+	}
+
+	return ret;
+}
+
+/*
+ * Cache hits only use IRAM code (and the ROM memcpy) so that they're not
+ * delayed by instruction cache misses; the miss path can stay in flash.
+ * They still can't run during flash writes because the data is in PSRAM.
+ */
+static __attribute__((noinline)) MCU_APP_HOT_IRAM bool read_cached(
+		const uint16_t *index, const uint8_t *data,
+		lfs_block_t block, lfs_off_t off, uint8_t *buffer, lfs_size_t size) {
+	uint16_t pos = index[block];
+
+	if (pos == UINT16_MAX)
+		return false;
+
+	std::memcpy(buffer, data + pos * FILESYSTEM_BLOCK_SIZE + off, size);
+	return true;
+}
+
+static MCU_APP_HOT_IRAM int read(const struct lfs_config *c,
 		lfs_block_t block, lfs_off_t off, uint8_t *buffer, lfs_size_t size) {
-	init();
+	if (!cache) {
+		init();
+		config = c;
+		tracking = true;
+	}
+
+	if (bypassed)
+		return __real_littlefs_api_read(c, block, off, buffer, size);
 
 	while (off >= FILESYSTEM_BLOCK_SIZE) {
 		off -= FILESYSTEM_BLOCK_SIZE;
@@ -76,38 +198,26 @@ static int read(const struct lfs_config *c,
 	}
 
 	while (size > 0) {
-		size_t available = std::min(FILESYSTEM_BLOCK_SIZE - off, size);
+		size_t available = FILESYSTEM_BLOCK_SIZE - off;
+
+		if (available > size)
+			available = size;
 
 		if (block >= FILESYSTEM_BLOCKS)
 			return __real_littlefs_api_read(c, block, off, buffer, size);
 
-		if (block_index[block] == UINT16_MAX) {
-			if (used_cache_size >= FILESYSTEM_CACHE_BLOCKS) {
-				uint16_t pos = rand() % FILESYSTEM_CACHE_BLOCKS;
-
-				if (cache_index[pos] != UINT16_MAX) {
-					block_index[cache_index[pos]] = UINT16_MAX;
-				}
-				block_index[block] = pos;
-				cache_index[block_index[block]] = block;
-			} else {
-				block_index[block] = used_cache_size;
-				cache_index[block_index[block]] = block;
-				used_cache_size++;
-			}
-
-			int ret = __real_littlefs_api_read(c, block, 0,
-				cache + block_index[block] * FILESYSTEM_BLOCK_SIZE,
-				FILESYSTEM_BLOCK_SIZE);
-
-			if (ret) {
-				block_index[block] = UINT16_MAX;
-				cache_index[block_index[block]] = block;
+		if (tracking)
+			read_before_write[block / 8] |= 1 << (block % 8);
+
+		if (!read_cached(block_index, cache, block, off, buffer, available)) {
+			int ret = fill(c, block);
+
+			if (ret)
 				return ret;
-			}
+
+			read_cached(block_index, cache, block, off, buffer, available);
 		}
 
-		std::memcpy(buffer, cache + block_index[block] * FILESYSTEM_BLOCK_SIZE + off, available);
 		buffer += available;
 		size -= available;
 		off = 0;
@@ -143,13 +253,310 @@ static void evict(lfs_block_t block, lfs_off_t off, lfs_size_t size) {
 	}
 }
 
+static void first_write() {
+	if (!tracking)
+		return;
+
+	/* Wait for a block being prefetched so that it's evicted before the write */
+	std::lock_guard<std::mutex> lock{fill_mutex};
+
+	if (!tracking)
+		return;
+
+	tracking = false;
+	first_write_us = esp_timer_get_time();
+	first_write_ms = uuid::get_uptime_ms();
+}
+
+/*
+ * Prefetched blocks only use unused cache slots (so that no blocks that
+ * are being read are replaced) and it stops at the first write.
+ */
+static void prefetch(std::array<uint8_t, FILESYSTEM_BLOCKS / 8> snapshot) {
+	uint64_t start_us = esp_timer_get_time();
+
+	for (lfs_block_t block = 0; block < FILESYSTEM_BLOCKS; block++) {
+		if (!(snapshot[block / 8] & (1 << (block % 8))))
+			continue;
+
+		std::lock_guard<std::mutex> lock{fill_mutex};
+
+		if (!tracking || used_cache_size >= FILESYSTEM_CACHE_BLOCKS)
+			break;
+
+		if (block_index[block] == UINT16_MAX) {
+			if (load(config, block, used_cache_size))
+				break;
+
+			used_cache_size++;
+			prefetch_blocks++;
+		}
+	}
+
+	prefetch_us = esp_timer_get_time() - start_us;
+	logger.debug(F("Prefetched %lu blocks in %lums"), prefetch_blocks.load(),
+		(unsigned long)(prefetch_us / 1000));
+	prefetch_running = false;
+}
+
+void mounted() {
+	std::array<uint8_t, FILESYSTEM_BLOCKS / 8> snapshot{};
+	std::string filename = uuid::read_flash_string(FPSTR(__pstr__snapshot_filename));
+	const char mode[2] = {'r', '\0'};
+
+	mount_us = esp_timer_get_time();
+
+	if (!cache || !config)
+		return;
+
+	auto file = FS.open(filename.c_str(), mode);
+	if (!file)
+		return;
+
+	cbor::Reader reader{file};
+	uint64_t blocks;
+	uint64_t length;
+	bool indefinite;
+
+	if (!cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag)
+			|| !cbor::expectUnsignedInt(reader, &blocks) || blocks != FILESYSTEM_BLOCKS
+			|| !cbor::expectBytes(reader, &length, &indefinite) || indefinite
+			|| length != snapshot.size()
+			|| reader.readBytes(snapshot.data(), snapshot.size()) != snapshot.size()) {
+		logger.notice(F("Ignoring invalid cache snapshot"));
+		return;
+	}
+
+	file.close();
+	loaded_snapshot = snapshot;
+
+	/*
+	 * The snapshot only affects which blocks are cached (the data is read
+	 * from flash) so an out of date snapshot can't cause corruption. The
+	 * blocks are read in the background so that startup isn't delayed.
+	 */
+	try {
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = PREFETCH_TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+
+		prefetch_running = true;
+		prefetch_thread = std::thread{[snapshot] { prefetch(snapshot); }};
+	} catch (...) {
+		logger.emerg("Out of memory");
+		prefetch_running = false;
+	}
+}
+
+void loop() {
+	if (!prefetch_running && prefetch_thread.joinable())
+		prefetch_thread.join();
+
+	if (snapshot_saved || tracking || !first_write_ms)
+		return;
+
+	if (uuid::get_uptime_ms() - first_write_ms >= SNAPSHOT_IDLE_MS)
+		save_snapshot();
+}
+
+/* Only written when it changes, to avoid unnecessary flash writes */
+void save_snapshot() {
+	if (!cache || tracking || snapshot_saved)
+		return;
+
+	snapshot_saved = true;
+
+	if (read_before_write == loaded_snapshot)
+		return;
+
+	std::string filename = uuid::read_flash_string(FPSTR(__pstr__snapshot_filename));
+	const char mode[2] = {'w', '\0'};
+	auto file = FS.open(filename.c_str(), mode);
+
+	if (!file) {
+		logger.err(F("Unable to open %s for writing"), filename.c_str());
+		return;
+	}
+
+	cbor::Writer writer{file};
+
+	writer.writeTag(cbor::kSelfDescribeTag);
+	writer.writeUnsignedInt(FILESYSTEM_BLOCKS);
+	writer.beginBytes(read_before_write.size());
+	writer.writeBytes(read_before_write.data(), read_before_write.size());
+
+	if (file.getWriteError()) {
+		logger.err(F("Failed to write %s: %u"), filename.c_str(), file.getWriteError());
+	} else {
+		loaded_snapshot = read_before_write;
+	}
+}
+
+void show(uuid::console::Shell &shell) {
+	if (!cache)
+		return;
+
+	if (prefetch_running) {
+		shell.printfln(F("FS prefetch:   %lu blocks (running)"), prefetch_blocks.load());
+	} else {
+		shell.printfln(F("FS prefetch:   %lu blocks in %lums"), prefetch_blocks.load(),
+			(unsigned long)(prefetch_us / 1000));
+	}
+
+	if (tracking) {
+		shell.printfln(F("FS 1st write:  none (%lu flash reads, %lums)"),
+			misses_before_write, (unsigned long)(miss_us_before_write / 1000));
+	} else {
+		shell.printfln(F("FS 1st write:  %lums after mount (%lu flash reads, %lums)"),
+			(unsigned long)((first_write_us - mount_us) / 1000),
+			misses_before_write, (unsigned long)(miss_us_before_write / 1000));
+	}
+}
+
+void bypass(bool enabled) {
+	bypassed = enabled;
+}
+
+struct Latency {
+	void add(uint32_t cycles) {
+		calls++;
+		total += cycles;
+		min = std::min(min, cycles);
+		max = std::max(max, cycles);
+		if (cycles >= slow_cycles)
+			slow++;
+	}
+
+	void print(uuid::console::Shell &shell, const __FlashStringHelper *name) const {
+		if (calls == 0) {
+			shell.printfln(F("%S no cached blocks"), name);
+			return;
+		}
+
+		shell.printfln(F("%S %lu reads, min/avg/max %lu/%lu/%lu cycles, %lu over %luus"),
+			name, (unsigned long)calls, (unsigned long)min,
+			(unsigned long)(total / calls), (unsigned long)max,
+			(unsigned long)slow, BENCHMARK_SLOW_US);
+	}
+
+	uint32_t slow_cycles;
+	uint32_t calls{0};
+	uint32_t min{UINT32_MAX};
+	uint32_t max{0};
+	uint32_t slow{0};
+	uint64_t total{0};
+};
+
+/*
+ * Cache hits are measured on a private copy of the cache structures (in the
+ * same types of memory) so that the LittleFS task can fill and evict blocks
+ * in the real cache at the same time.
+ *
+ * This only shows the effect of instruction cache misses (compare builds with
+ * and without APP_IRAM_HOT_PATHS). Nothing is measured during flash writes
+ * because this task is suspended while they happen and the cached data in
+ * PSRAM can't be accessed then anyway.
+ */
+class Benchmark {
+public:
+	~Benchmark();
+
+	bool start(uuid::console::Shell &shell);
+
+	/* Returns true when the benchmark has finished */
+	bool step(uuid::console::Shell &shell, bool stop);
+
+private:
+	void measure();
+
+	uint8_t *data_{nullptr};
+	uint16_t *index_{nullptr};
+	lfs_block_t block_{0};
+	unsigned long elapsed_ms_{0};
+	Latency latency_{static_cast<uint32_t>(getCpuFrequencyMhz() * BENCHMARK_SLOW_US)};
+};
+
+Benchmark::~Benchmark() {
+	::heap_caps_free(data_);
+	::heap_caps_free(index_);
+}
+
+bool Benchmark::start(uuid::console::Shell &shell) {
+	data_ = reinterpret_cast<uint8_t*>(::heap_caps_malloc(BENCHMARK_CACHE_BLOCKS * FILESYSTEM_BLOCK_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+	index_ = reinterpret_cast<uint16_t*>(::heap_caps_malloc(FILESYSTEM_BLOCKS * sizeof(uint16_t), MALLOC_CAP_DMA | MALLOC_CAP_8BIT));
+
+	if (!data_ || !index_) {
+		shell.println(F("Out of memory"));
+		return false;
+	}
+
+	std::memset(data_, 0x55, BENCHMARK_CACHE_BLOCKS * FILESYSTEM_BLOCK_SIZE);
+
+	for (lfs_block_t block = 0; block < FILESYSTEM_BLOCKS; block++)
+		index_[block] = block % BENCHMARK_CACHE_BLOCKS;
+
+	shell.printfln(F("IRAM hot paths: %S"), APP_IRAM_HOT_PATHS ? F("enabled") : F("disabled"));
+	return true;
+}
+
+bool Benchmark::step(uuid::console::Shell &shell, bool stop) {
+	if (stop) {
+		shell.println(F("Interrupted"));
+		return true;
+	}
+
+	measure();
+
+	if (elapsed_ms_ < BENCHMARK_DURATION_MS)
+		return false;
+
+	latency_.print(shell, F("Cache hits:"));
+	return true;
+}
+
+/* Measure for a short time so that the rest of the application keeps running */
+void Benchmark::measure() {
+	uint8_t buffer[BENCHMARK_READ_SIZE];
+	unsigned long start_ms = millis();
+
+	do {
+		for (unsigned int i = 0; i < FILESYSTEM_BLOCKS; i++) {
+			uint32_t start = ESP.getCycleCount();
+
+			if (read_cached(index_, data_, block_, 0, buffer, sizeof(buffer)))
+				latency_.add(ESP.getCycleCount() - start);
+
+			block_ = (block_ + 1) % FILESYSTEM_BLOCKS;
+		}
+	} while (millis() - start_ms < BENCHMARK_STEP_MS);
+
+	elapsed_ms_ += millis() - start_ms;
+}
+
+void benchmark(uuid::console::Shell &shell) {
+	if (!cache) {
+		shell.println(F("Filesystem cache not initialised"));
+		return;
+	}
+
+	auto benchmark = std::make_shared<Benchmark>();
+
+	if (!benchmark->start(shell))
+		return;
+
+	shell.block_with([benchmark] (uuid::console::Shell &shell, bool stop) -> bool {
+		return benchmark->step(shell, stop);
+	});
+}
+
 } // namespace filesystem_cache
 
 } // namespace app
 
 extern "C" {
 
-int __wrap_littlefs_api_read(const struct lfs_config *c, lfs_block_t block,
+MCU_APP_HOT_IRAM int __wrap_littlefs_api_read(const struct lfs_config *c, lfs_block_t block,
 		lfs_off_t off, void *buffer, lfs_size_t size) {
 	return app::filesystem_cache::read(c, block, off,
 		reinterpret_cast<uint8_t*>(buffer), size);
@@ -160,6 +567,7 @@ int __real_littlefs_api_prog(const struct lfs_config *c, lfs_block_t block,
 
 int __wrap_littlefs_api_prog(const struct lfs_config *c, lfs_block_t block,
 		lfs_off_t off, const void *buffer, lfs_size_t size) {
+	app::filesystem_cache::first_write();
 	app::filesystem_cache::evict(block, off, size);
 	return __real_littlefs_api_prog(c, block, off, buffer, size);
 }
@@ -167,6 +575,7 @@ int __wrap_littlefs_api_prog(const struct lfs_config *c, lfs_block_t block,
 int __real_littlefs_api_erase(const struct lfs_config *c, lfs_block_t block);
 
 int __wrap_littlefs_api_erase(const struct lfs_config *c, lfs_block_t block) {
+	app::filesystem_cache::first_write();
 	app::filesystem_cache::evict(block, 0,
 		app::filesystem_cache::FILESYSTEM_BLOCK_SIZE);
 	return __real_littlefs_api_erase(c, block);
@@ -0,0 +1,55 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <uuid/console.h>
+
+namespace app {
+
+namespace filesystem_cache {
+
+/*
+ * Load the blocks that were read before the first write after the last
+ * mount (in a background task), so that LittleFS can scan the filesystem
+ * for free blocks (on the first allocation) without waiting for flash reads.
+ */
+void mounted();
+
+/* Save the set of blocks to prefetch, a while after the first write */
+void loop();
+void save_snapshot();
+
+/* Output prefetch and mount to first write statistics */
+void show(uuid::console::Shell &shell);
+
+/* Read directly from flash (the cache is still updated by writes) */
+void bypass(bool enabled);
+
+/*
+ * Measure the latency of filesystem cache hits to show the effect of
+ * instruction cache misses (in steps, blocking the shell).
+ */
+void benchmark(uuid::console::Shell &shell);
+
+} // namespace filesystem_cache
+
+} // namespace app
+
+#endif
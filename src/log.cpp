@@ -19,27 +19,20 @@
 #include <Arduino.h>
 
 #include <cstdarg>
+#include <vector>
 
 #include <uuid/log.h>
 
-#ifndef PSTR_ALIGN
-# define PSTR_ALIGN 4
-#endif
+#include "app/isr_log.h"
+#include "app/pstr.h"
 
-static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "espressif";
+MAKE_PSTR(logger_name, "espressif")
 
 static uuid::log::Logger logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
 
-extern "C" {
-
-int ets_printf(const char *format, ...) {
+static int ets_printf_log(const char *format, va_list ap) {
 	std::vector<char> text(256);
-	va_list ap;
-	int ret;
-
-	va_start(ap, format);
-	ret = vsnprintf(text.data(), text.size(), format, ap);
-	va_end(ap);
+	int ret = vsnprintf(text.data(), text.size(), format, ap);
 
 	while (ret > 0) {
 		if (text[ret - 1] == '\r' || text[ret - 1] == '\n') {
@@ -57,4 +50,28 @@ int ets_printf(const char *format, ...) {
 	return ret;
 }
 
+extern "C" {
+
+/*
+ * This must be in IRAM because it can be called from an interrupt handler
+ * while the flash cache is disabled. The format string and arguments can't
+ * be used safely in that case (the types of the arguments are unknown) so
+ * the message is only counted. Interrupt handlers in the application use
+ * isr_log::log() instead.
+ */
+IRAM_ATTR int ets_printf(const char *format, ...) {
+	va_list ap;
+	int ret;
+
+	if (app::isr_log::in_interrupt()) {
+		app::isr_log::discard();
+		return 0;
+	}
+
+	va_start(ap, format);
+	ret = ets_printf_log(format, ap);
+	va_end(ap);
+	return ret;
+}
+
 }
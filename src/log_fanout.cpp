@@ -0,0 +1,116 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "app/log_fanout.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <memory>
+#if MCU_APP_THREAD_SAFE
+# include <mutex>
+#endif
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/util.h"
+
+namespace app {
+
+namespace log_fanout {
+
+#if MCU_APP_THREAD_SAFE
+static std::mutex mutex;
+#endif
+/* Most recent message, to detect the start of the next one */
+static std::weak_ptr<uuid::log::Message> last_message;
+static unsigned int last_sinks = 0;
+static unsigned int max_sinks = 0;
+static unsigned long messages = 0;
+static unsigned long console_deliveries = 0;
+static unsigned long syslog_deliveries = 0;
+static unsigned long long shared_bytes = 0;
+
+/*
+ * Every handler receives the same message in turn when it is logged, so a
+ * different message means that the previous one has been delivered to all
+ * of its sinks. Messages logged concurrently by other threads may be
+ * counted more than once.
+ */
+void delivered(const std::shared_ptr<uuid::log::Message> &message, Sink sink) {
+#if MCU_APP_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex};
+#endif
+
+	if (last_message.lock() != message) {
+		last_message = message;
+		last_sinks = 0;
+		messages++;
+	} else {
+		shared_bytes += message->text.length();
+	}
+
+	last_sinks++;
+	max_sinks = std::max(max_sinks, last_sinks);
+
+	switch (sink) {
+	case Sink::CONSOLE:
+		console_deliveries++;
+		break;
+
+	case Sink::SYSLOG:
+		syslog_deliveries++;
+		break;
+	}
+}
+
+void show(uuid::console::Shell &shell) {
+#if MCU_APP_THREAD_SAFE
+	std::unique_lock<std::mutex> lock{mutex};
+#endif
+	unsigned long messages_copy = messages;
+	unsigned long console_copy = console_deliveries;
+	unsigned long syslog_copy = syslog_deliveries;
+	unsigned int max_sinks_copy = max_sinks;
+	unsigned long long shared_bytes_copy = shared_bytes;
+#if MCU_APP_THREAD_SAFE
+	lock.unlock();
+#endif
+	unsigned long deliveries = console_copy + syslog_copy;
+
+	shell.printfln(F("Messages:      %lu formatted"), messages_copy);
+	shell.printfln(F("Deliveries:    %lu (%lu console, %lu syslog)"), deliveries, console_copy, syslog_copy);
+	if (messages_copy > 0) {
+		shell.printfln(F("Sinks:         %lu.%02lu average, %u maximum"),
+			deliveries / messages_copy, (deliveries % messages_copy) * 100 / messages_copy,
+			max_sinks_copy);
+	}
+	shell.printfln(F("Shared text:   %llu bytes"), shared_bytes_copy);
+}
+
+} // namespace log_fanout
+
+#ifndef ENV_NATIVE
+void AppSyslog::operator<<(std::shared_ptr<uuid::log::Message> message) {
+	log_fanout::delivered(message, log_fanout::Sink::SYSLOG);
+	uuid::syslog::SyslogService::operator<<(std::move(message));
+}
+#endif
+
+} // namespace app
@@ -0,0 +1,56 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+#ifndef ENV_NATIVE
+# include <uuid/syslog.h>
+#endif
+
+namespace app {
+
+/*
+ * Log messages are formatted once by the logger and the same
+ * (reference-counted) message is queued by every console and the syslog
+ * service. These counters show how many messages were formatted and how
+ * many times they were delivered.
+ */
+namespace log_fanout {
+
+enum class Sink : uint8_t {
+	CONSOLE,
+	SYSLOG,
+};
+
+void delivered(const std::shared_ptr<uuid::log::Message> &message, Sink sink);
+void show(uuid::console::Shell &shell);
+
+} // namespace log_fanout
+
+#ifndef ENV_NATIVE
+class AppSyslog: public uuid::syslog::SyslogService {
+public:
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override;
+};
+#endif
+
+} // namespace app
@@ -0,0 +1,855 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(ARDUINO_ARCH_ESP32) || defined(ENV_NATIVE)
+#include "app/net_bench.h"
+
+#include <Arduino.h>
+
+#ifdef ENV_NATIVE
+# include <arpa/inet.h>
+# include <netdb.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <sys/resource.h>
+# include <sys/select.h>
+# include <sys/socket.h>
+#else
+# include <lwip/netdb.h>
+# include <lwip/sockets.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+using ::uuid::console::Shell;
+
+MAKE_PSTR(logger_name, "bench")
+
+namespace app {
+
+static constexpr size_t HEADER_SIZE = 16;
+static constexpr size_t RESULT_SIZE = 16;
+static constexpr size_t TCP_BUFFER_SIZE = 4096;
+static constexpr size_t UDP_DATAGRAM_SIZE = 1400;
+static constexpr unsigned long STEP_TIME_US = 10000;
+static constexpr uint64_t CONNECT_TIMEOUT_MS = 5000;
+static constexpr uint64_t RESULT_TIMEOUT_MS = 5000;
+static constexpr unsigned long MAXIMUM_SECONDS = 3600;
+
+uuid::log::Logger NetworkBenchmark::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+static void put_u16(uint8_t *buf, uint16_t value) {
+	buf[0] = value >> 8;
+	buf[1] = value;
+}
+
+static void put_u32(uint8_t *buf, uint32_t value) {
+	put_u16(&buf[0], value >> 16);
+	put_u16(&buf[2], value);
+}
+
+static void put_u64(uint8_t *buf, uint64_t value) {
+	put_u32(&buf[0], value >> 32);
+	put_u32(&buf[4], value);
+}
+
+static uint16_t get_u16(const uint8_t *buf) {
+	return (buf[0] << 8) | buf[1];
+}
+
+static uint32_t get_u32(const uint8_t *buf) {
+	return ((uint32_t)get_u16(&buf[0]) << 16) | get_u16(&buf[2]);
+}
+
+static uint64_t get_u64(const uint8_t *buf) {
+	return ((uint64_t)get_u32(&buf[0]) << 32) | get_u32(&buf[4]);
+}
+
+static bool would_block() {
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == ENOBUFS;
+}
+
+static bool set_nonblocking(int fd) {
+	int flags = ::fcntl(fd, F_GETFL, 0);
+
+	return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void close_socket(int &fd) {
+	if (fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+static std::string address_string(const struct sockaddr_in &addr) {
+	std::array<char, INET_ADDRSTRLEN + 8> text;
+	std::array<char, INET_ADDRSTRLEN> ip;
+
+	::inet_ntop(AF_INET, &addr.sin_addr, ip.data(), ip.size());
+	::snprintf_P(text.data(), text.size(), PSTR("%s:%u"), ip.data(), ntohs(addr.sin_port));
+	return text.data();
+}
+
+static const __FlashStringHelper *protocol_string(NetworkBenchmark::Protocol protocol) {
+	return protocol == NetworkBenchmark::Protocol::TCP ? F("TCP") : F("UDP");
+}
+
+/*
+ * Measures time spent in the benchmark itself as a proportion of the
+ * elapsed time (on the main loop task, so it excludes the network stack)
+ * or the process CPU time on native builds.
+ */
+class CPUUsage {
+public:
+	void start() {
+		start_us_ = micros();
+		busy_us_ = 0;
+#ifdef ENV_NATIVE
+		::getrusage(RUSAGE_SELF, &start_usage_);
+#endif
+	}
+
+	void enter() {
+		enter_us_ = micros();
+	}
+
+	void leave() {
+		busy_us_ += micros() - enter_us_;
+	}
+
+	void print(Shell &shell) const {
+		unsigned long elapsed_us = std::max(1UL, micros() - start_us_);
+
+#ifdef ENV_NATIVE
+		struct rusage usage;
+
+		::getrusage(RUSAGE_SELF, &usage);
+
+		uint64_t cpu_us = (usage.ru_utime.tv_sec - start_usage_.ru_utime.tv_sec) * 1000000ULL
+			+ (usage.ru_utime.tv_usec - start_usage_.ru_utime.tv_usec)
+			+ (usage.ru_stime.tv_sec - start_usage_.ru_stime.tv_sec) * 1000000ULL
+			+ (usage.ru_stime.tv_usec - start_usage_.ru_stime.tv_usec);
+
+		shell.printfln(F("CPU usage:   %llu%% (process), %llu%% (benchmark)"),
+			(unsigned long long)(cpu_us * 100 / elapsed_us),
+			(unsigned long long)(busy_us_ * 100 / elapsed_us));
+#else
+		shell.printfln(F("CPU usage:   %llu%% (benchmark)"),
+			(unsigned long long)(busy_us_ * 100 / elapsed_us));
+#endif
+	}
+
+private:
+	unsigned long start_us_{0};
+	unsigned long enter_us_{0};
+	uint64_t busy_us_{0};
+#ifdef ENV_NATIVE
+	struct rusage start_usage_{};
+#endif
+};
+
+static void print_rate(Shell &shell, const __FlashStringHelper *what,
+		uint64_t bytes, uint64_t elapsed_ms) {
+	elapsed_ms = std::max((uint64_t)1, elapsed_ms);
+
+	shell.printfln(F("%S %llu bytes in %llu.%03llus = %llu kbit/s"), what,
+		(unsigned long long)bytes,
+		(unsigned long long)(elapsed_ms / 1000), (unsigned long long)(elapsed_ms % 1000),
+		(unsigned long long)(bytes * 8 / elapsed_ms));
+}
+
+static void print_packets(Shell &shell, uint32_t packets, uint32_t lost) {
+	uint64_t total = (uint64_t)packets + lost;
+
+	shell.printfln(F("Packets:     %lu received, %lu lost (%llu.%02llu%%)"),
+		(unsigned long)packets, (unsigned long)lost,
+		(unsigned long long)(total ? lost * 100 / total : 0),
+		(unsigned long long)(total ? lost * 10000 / total % 100 : 0));
+}
+
+static void print_retransmits(Shell &shell, int fd) {
+#ifdef TCP_INFO
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+
+	if (::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+		shell.printfln(F("Retransmits: %lu"), (unsigned long)info.tcpi_total_retrans);
+	}
+#endif
+}
+
+/* Send datagrams at the requested rate until the socket buffer is full */
+static bool udp_send_paced(int fd, const struct sockaddr_in *to,
+		std::vector<uint8_t> &buffer, uint64_t elapsed_ms,
+		unsigned long rate_kbps, unsigned long step_start_us,
+		uint32_t &packets, uint64_t &bytes) {
+	uint64_t allowed = elapsed_ms * rate_kbps / 8;
+
+	while (bytes < allowed && micros() - step_start_us < STEP_TIME_US) {
+		put_u32(buffer.data(), packets);
+
+		ssize_t len = to
+			? ::sendto(fd, buffer.data(), buffer.size(), 0,
+				reinterpret_cast<const struct sockaddr *>(to), sizeof(*to))
+			: ::send(fd, buffer.data(), buffer.size(), 0);
+
+		if (len < 0) {
+			return would_block();
+		}
+
+		packets++;
+		bytes += len;
+	}
+
+	return true;
+}
+
+class NetworkBenchmark::Client {
+public:
+	Client(Protocol protocol, Direction direction, unsigned long seconds, unsigned long rate_kbps)
+			: protocol_(protocol), direction_(direction),
+			  duration_ms_(std::min(seconds, MAXIMUM_SECONDS) * 1000),
+			  rate_kbps_(rate_kbps) {
+	}
+
+	~Client() {
+		close_socket(tcp_fd_);
+		close_socket(udp_fd_);
+	}
+
+	bool start(Shell &shell, const std::string &host, uint16_t port) {
+		struct addrinfo hints{};
+		struct addrinfo *result = nullptr;
+
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+
+		int ret = ::getaddrinfo(host.c_str(), nullptr, &hints, &result);
+		if (ret != 0 || !result) {
+			shell.printfln(F("%s: unable to resolve host (%d)"), host.c_str(), ret);
+			return false;
+		}
+
+		std::memcpy(&server_, result->ai_addr, sizeof(server_));
+		server_.sin_port = htons(port);
+		::freeaddrinfo(result);
+
+		tcp_fd_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (tcp_fd_ < 0 || !set_nonblocking(tcp_fd_)) {
+			shell.printfln(F("Unable to create TCP socket (%d)"), errno);
+			return false;
+		}
+
+		if (protocol_ == Protocol::UDP) {
+			struct sockaddr_in local{};
+			socklen_t len = sizeof(local);
+
+			local.sin_family = AF_INET;
+
+			udp_fd_ = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+			if (udp_fd_ < 0 || !set_nonblocking(udp_fd_)
+					|| ::bind(udp_fd_, reinterpret_cast<struct sockaddr *>(&local), sizeof(local))
+					|| ::getsockname(udp_fd_, reinterpret_cast<struct sockaddr *>(&local), &len)) {
+				shell.printfln(F("Unable to create UDP socket (%d)"), errno);
+				return false;
+			}
+
+			udp_port_ = ntohs(local.sin_port);
+
+			if (direction_ == Direction::SEND
+					&& ::connect(udp_fd_, reinterpret_cast<struct sockaddr *>(&server_), sizeof(server_))) {
+				shell.printfln(F("Unable to connect UDP socket (%d)"), errno);
+				return false;
+			}
+		}
+
+		if (::connect(tcp_fd_, reinterpret_cast<struct sockaddr *>(&server_), sizeof(server_))
+				&& errno != EINPROGRESS) {
+			shell.printfln(F("%s: connect failed (%d)"), address_string(server_).c_str(), errno);
+			return false;
+		}
+
+		shell.printfln(F("Connecting to %s for %S %S test (%lus)..."),
+			address_string(server_).c_str(), protocol_string(protocol_),
+			direction_ == Direction::SEND ? F("send") : F("receive"),
+			(unsigned long)(duration_ms_ / 1000));
+
+		buffer_.resize(protocol_ == Protocol::TCP ? TCP_BUFFER_SIZE : UDP_DATAGRAM_SIZE);
+		state_ = State::CONNECTING;
+		state_ms_ = uuid::get_uptime_ms();
+		return true;
+	}
+
+	/* Returns true when the test has finished */
+	bool loop(Shell &shell, bool stop) {
+		if (stop) {
+			shell.println(F("Interrupted"));
+			return true;
+		}
+
+		usage_.enter();
+		bool done = step(shell);
+		usage_.leave();
+		return done;
+	}
+
+private:
+	enum class State : uint8_t {
+		CONNECTING,
+		RUNNING,
+		RESULT,
+	};
+
+	bool step(Shell &shell) {
+		switch (state_) {
+		case State::CONNECTING:
+			return connecting(shell);
+
+		case State::RUNNING:
+			return running(shell);
+
+		case State::RESULT:
+			return result(shell);
+		}
+
+		return true;
+	}
+
+	bool connecting(Shell &shell) {
+		struct timeval timeout{};
+		fd_set wfds;
+
+		FD_ZERO(&wfds);
+		FD_SET(tcp_fd_, &wfds);
+
+		if (::select(tcp_fd_ + 1, nullptr, &wfds, nullptr, &timeout) <= 0) {
+			if (uuid::get_uptime_ms() - state_ms_ >= CONNECT_TIMEOUT_MS) {
+				shell.printfln(F("%s: connect timeout"), address_string(server_).c_str());
+				return true;
+			}
+			return false;
+		}
+
+		int error = 0;
+		socklen_t len = sizeof(error);
+
+		if (::getsockopt(tcp_fd_, SOL_SOCKET, SO_ERROR, &error, &len) || error) {
+			shell.printfln(F("%s: connect failed (%d)"), address_string(server_).c_str(), error);
+			return true;
+		}
+
+		int one = 1;
+		::setsockopt(tcp_fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		std::array<uint8_t, HEADER_SIZE> header{'M', 'C', 'U', 'B'};
+
+		header[4] = (static_cast<uint8_t>(protocol_) << 1) | static_cast<uint8_t>(direction_);
+		put_u16(&header[6], udp_port_);
+		put_u32(&header[8], duration_ms_ / 1000);
+		put_u32(&header[12], rate_kbps_);
+
+		if (::send(tcp_fd_, header.data(), header.size(), MSG_NOSIGNAL) != (ssize_t)header.size()) {
+			shell.printfln(F("%s: send failed (%d)"), address_string(server_).c_str(), errno);
+			return true;
+		}
+
+		state_ = State::RUNNING;
+		state_ms_ = uuid::get_uptime_ms();
+		usage_.start();
+		return false;
+	}
+
+	bool running(Shell &shell) {
+		unsigned long step_start_us = micros();
+		uint64_t elapsed_ms = uuid::get_uptime_ms() - state_ms_;
+
+		if (protocol_ == Protocol::TCP && direction_ == Direction::SEND) {
+			while (elapsed_ms < duration_ms_ && micros() - step_start_us < STEP_TIME_US) {
+				ssize_t len = ::send(tcp_fd_, buffer_.data(), buffer_.size(), MSG_NOSIGNAL);
+
+				if (len < 0) {
+					if (would_block())
+						break;
+
+					shell.printfln(F("Send failed (%d)"), errno);
+					return true;
+				}
+
+				bytes_ += len;
+			}
+		} else if (protocol_ == Protocol::TCP) {
+			while (micros() - step_start_us < STEP_TIME_US) {
+				ssize_t len = ::recv(tcp_fd_, buffer_.data(), buffer_.size(), 0);
+
+				if (len < 0) {
+					if (would_block())
+						break;
+
+					shell.printfln(F("Receive failed (%d)"), errno);
+					return true;
+				} else if (len == 0) {
+					print_rate(shell, F("Received:   "), bytes_, elapsed_ms);
+					print_retransmits(shell, tcp_fd_);
+					usage_.print(shell);
+					return true;
+				}
+
+				bytes_ += len;
+			}
+			return false;
+		} else if (direction_ == Direction::SEND) {
+			if (elapsed_ms < duration_ms_
+					&& !udp_send_paced(udp_fd_, nullptr, buffer_, elapsed_ms,
+						rate_kbps_, step_start_us, packets_, bytes_)) {
+				shell.printfln(F("Send failed (%d)"), errno);
+				return true;
+			}
+		} else {
+			receive_datagrams(step_start_us);
+
+			if (elapsed_ms < duration_ms_)
+				return false;
+		}
+
+		if (elapsed_ms >= duration_ms_) {
+			elapsed_ms_ = elapsed_ms;
+
+			if (direction_ == Direction::SEND) {
+				::shutdown(tcp_fd_, SHUT_WR);
+			}
+
+			state_ = State::RESULT;
+			state_ms_ = uuid::get_uptime_ms();
+		}
+
+		return false;
+	}
+
+	void receive_datagrams(unsigned long step_start_us) {
+		while (micros() - step_start_us < STEP_TIME_US) {
+			ssize_t len = ::recv(udp_fd_, buffer_.data(), buffer_.size(), 0);
+
+			if (len < 4)
+				break;
+
+			uint32_t seq = get_u32(buffer_.data());
+
+			if (!packets_ || seq > max_seq_)
+				max_seq_ = seq;
+
+			packets_++;
+			bytes_ += len;
+		}
+	}
+
+	bool result(Shell &shell) {
+		if (protocol_ == Protocol::UDP && direction_ == Direction::RECEIVE) {
+			receive_datagrams(micros());
+		}
+
+		while (result_len_ < result_.size()) {
+			ssize_t len = ::recv(tcp_fd_, &result_[result_len_], result_.size() - result_len_, 0);
+
+			if (len < 0 && would_block()) {
+				if (uuid::get_uptime_ms() - state_ms_ >= RESULT_TIMEOUT_MS) {
+					shell.println(F("Timeout waiting for result"));
+					return true;
+				}
+				return false;
+			} else if (len <= 0) {
+				shell.println(F("Connection closed before result"));
+				return true;
+			}
+
+			result_len_ += len;
+		}
+
+		uint64_t peer_bytes = get_u64(&result_[0]);
+		uint32_t peer_packets = get_u32(&result_[8]);
+		uint32_t peer_lost = get_u32(&result_[12]);
+
+		if (direction_ == Direction::SEND) {
+			print_rate(shell, F("Sent:       "), bytes_, elapsed_ms_);
+			print_rate(shell, F("Received:   "), peer_bytes, elapsed_ms_);
+
+			if (protocol_ == Protocol::UDP) {
+				print_packets(shell, peer_packets, peer_lost);
+			} else {
+				print_retransmits(shell, tcp_fd_);
+			}
+		} else {
+			print_rate(shell, F("Sent:       "), peer_bytes, elapsed_ms_);
+			print_rate(shell, F("Received:   "), bytes_, elapsed_ms_);
+			print_packets(shell, packets_, peer_packets > packets_ ? peer_packets - packets_ : 0);
+		}
+
+		usage_.print(shell);
+		return true;
+	}
+
+	const Protocol protocol_;
+	const Direction direction_;
+	const uint64_t duration_ms_;
+	const unsigned long rate_kbps_;
+	State state_{State::CONNECTING};
+	struct sockaddr_in server_{};
+	int tcp_fd_{-1};
+	int udp_fd_{-1};
+	uint16_t udp_port_{0};
+	std::vector<uint8_t> buffer_;
+	std::array<uint8_t, RESULT_SIZE> result_{};
+	size_t result_len_{0};
+	uint64_t state_ms_{0};
+	uint64_t elapsed_ms_{0};
+	uint64_t bytes_{0};
+	uint32_t packets_{0};
+	uint32_t max_seq_{0};
+	CPUUsage usage_;
+};
+
+class NetworkBenchmark::Server {
+public:
+	~Server() {
+		close_socket(listen_fd_);
+		close_socket(udp_fd_);
+		close_socket(tcp_fd_);
+	}
+
+	bool start(Shell &shell, uint32_t address, uint16_t port) {
+		struct sockaddr_in local{};
+		int one = 1;
+
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl(address);
+		local.sin_port = htons(port);
+
+		listen_fd_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listen_fd_ < 0 || !set_nonblocking(listen_fd_)) {
+			shell.printfln(F("Unable to create TCP socket (%d)"), errno);
+			return false;
+		}
+
+		::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+		if (::bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&local), sizeof(local))
+				|| ::listen(listen_fd_, 1)) {
+			shell.printfln(F("Unable to listen on TCP port %u (%d)"), port, errno);
+			return false;
+		}
+
+		udp_fd_ = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (udp_fd_ < 0 || !set_nonblocking(udp_fd_)
+				|| ::bind(udp_fd_, reinterpret_cast<struct sockaddr *>(&local), sizeof(local))) {
+			shell.printfln(F("Unable to listen on UDP port %u (%d)"), port, errno);
+			return false;
+		}
+
+		shell.printfln(F("Listening on %s"), address_string(local).c_str());
+		return true;
+	}
+
+	void loop(Shell &shell) {
+		switch (state_) {
+		case State::LISTENING:
+			accept(shell);
+			break;
+
+		case State::HEADER:
+			header(shell);
+			break;
+
+		case State::RUNNING:
+			running(shell);
+			break;
+		}
+	}
+
+private:
+	enum class State : uint8_t {
+		LISTENING,
+		HEADER,
+		RUNNING,
+	};
+
+	void accept(Shell &shell) {
+		socklen_t len = sizeof(peer_);
+
+		tcp_fd_ = ::accept(listen_fd_, reinterpret_cast<struct sockaddr *>(&peer_), &len);
+		if (tcp_fd_ < 0)
+			return;
+
+		if (!set_nonblocking(tcp_fd_)) {
+			close_socket(tcp_fd_);
+			return;
+		}
+
+		int one = 1;
+		::setsockopt(tcp_fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		header_len_ = 0;
+		state_ = State::HEADER;
+		state_ms_ = uuid::get_uptime_ms();
+	}
+
+	void header(Shell &shell) {
+		while (header_len_ < header_.size()) {
+			ssize_t len = ::recv(tcp_fd_, &header_[header_len_], header_.size() - header_len_, 0);
+
+			if (len < 0 && would_block()) {
+				if (uuid::get_uptime_ms() - state_ms_ >= CONNECT_TIMEOUT_MS) {
+					shell.printfln(F("%s: timeout waiting for header"), address_string(peer_).c_str());
+					finish();
+				}
+				return;
+			} else if (len <= 0) {
+				finish();
+				return;
+			}
+
+			header_len_ += len;
+		}
+
+		if (std::memcmp(header_.data(), "MCUB", 4) || header_[4] > 3) {
+			shell.printfln(F("%s: invalid header"), address_string(peer_).c_str());
+			finish();
+			return;
+		}
+
+		protocol_ = static_cast<Protocol>(header_[4] >> 1);
+		direction_ = static_cast<Direction>(header_[4] & 1);
+		duration_ms_ = std::min((unsigned long)get_u32(&header_[8]), MAXIMUM_SECONDS) * 1000;
+		rate_kbps_ = get_u32(&header_[12]);
+		udp_peer_ = peer_;
+		udp_peer_.sin_port = htons(get_u16(&header_[6]));
+
+		/* Directions are relative to the client */
+		shell.printfln(F("%s: %S %S test (%lus)"), address_string(peer_).c_str(),
+			protocol_string(protocol_),
+			direction_ == Direction::SEND ? F("receive") : F("send"),
+			(unsigned long)(duration_ms_ / 1000));
+
+		buffer_.resize(protocol_ == Protocol::TCP ? TCP_BUFFER_SIZE : UDP_DATAGRAM_SIZE);
+		bytes_ = 0;
+		packets_ = 0;
+		max_seq_ = 0;
+		elapsed_ms_ = 0;
+		state_ = State::RUNNING;
+		state_ms_ = uuid::get_uptime_ms();
+		usage_.start();
+	}
+
+	void running(Shell &shell) {
+		unsigned long step_start_us = micros();
+		uint64_t elapsed_ms = uuid::get_uptime_ms() - state_ms_;
+
+		usage_.enter();
+
+		if (direction_ == Direction::RECEIVE) {
+			if (elapsed_ms < duration_ms_) {
+				if (protocol_ == Protocol::TCP) {
+					while (micros() - step_start_us < STEP_TIME_US) {
+						ssize_t len = ::send(tcp_fd_, buffer_.data(), buffer_.size(), MSG_NOSIGNAL);
+
+						if (len < 0) {
+							if (!would_block()) {
+								shell.printfln(F("%s: send failed (%d)"), address_string(peer_).c_str(), errno);
+								usage_.leave();
+								finish();
+								return;
+							}
+							break;
+						}
+
+						bytes_ += len;
+					}
+				} else if (!udp_send_paced(udp_fd_, &udp_peer_, buffer_, elapsed_ms,
+						rate_kbps_, step_start_us, packets_, bytes_)) {
+					shell.printfln(F("%s: send failed (%d)"), address_string(udp_peer_).c_str(), errno);
+				}
+			} else {
+				usage_.leave();
+				print_rate(shell, F("Sent:       "), bytes_, elapsed_ms);
+				if (protocol_ == Protocol::TCP) {
+					print_retransmits(shell, tcp_fd_);
+				} else {
+					send_result(packets_, 0);
+				}
+				usage_.print(shell);
+				finish();
+				return;
+			}
+		} else {
+			if (protocol_ == Protocol::UDP) {
+				while (micros() - step_start_us < STEP_TIME_US) {
+					ssize_t len = ::recv(udp_fd_, buffer_.data(), buffer_.size(), 0);
+
+					if (len < 4)
+						break;
+
+					uint32_t seq = get_u32(buffer_.data());
+
+					if (!packets_ || seq > max_seq_)
+						max_seq_ = seq;
+
+					packets_++;
+					bytes_ += len;
+				}
+			}
+
+			/* Wait for the client to shutdown its side of the connection */
+			while (micros() - step_start_us < STEP_TIME_US) {
+				ssize_t len = ::recv(tcp_fd_, buffer_.data(), buffer_.size(), 0);
+
+				if (len < 0 && would_block()) {
+					break;
+				} else if (len <= 0) {
+					usage_.leave();
+
+					uint32_t lost = packets_ ? (max_seq_ + 1) - std::min(packets_, max_seq_ + 1) : 0;
+
+					print_rate(shell, F("Received:   "), bytes_, elapsed_ms);
+					if (protocol_ == Protocol::UDP) {
+						print_packets(shell, packets_, lost);
+					}
+					send_result(packets_, lost);
+					usage_.print(shell);
+					finish();
+					return;
+				} else if (protocol_ == Protocol::TCP) {
+					bytes_ += len;
+				}
+			}
+
+			if (elapsed_ms >= duration_ms_ + RESULT_TIMEOUT_MS) {
+				usage_.leave();
+				shell.printfln(F("%s: timeout waiting for end of test"), address_string(peer_).c_str());
+				finish();
+				return;
+			}
+		}
+
+		usage_.leave();
+	}
+
+	void send_result(uint32_t packets, uint32_t lost) {
+		std::array<uint8_t, RESULT_SIZE> result;
+
+		put_u64(&result[0], bytes_);
+		put_u32(&result[8], packets);
+		put_u32(&result[12], lost);
+
+		::send(tcp_fd_, result.data(), result.size(), MSG_NOSIGNAL);
+	}
+
+	void finish() {
+		close_socket(tcp_fd_);
+		state_ = State::LISTENING;
+	}
+
+	State state_{State::LISTENING};
+	int listen_fd_{-1};
+	int udp_fd_{-1};
+	int tcp_fd_{-1};
+	struct sockaddr_in peer_{};
+	struct sockaddr_in udp_peer_{};
+	std::array<uint8_t, HEADER_SIZE> header_{};
+	size_t header_len_{0};
+	Protocol protocol_{Protocol::TCP};
+	Direction direction_{Direction::SEND};
+	uint64_t duration_ms_{0};
+	unsigned long rate_kbps_{0};
+	std::vector<uint8_t> buffer_;
+	uint64_t state_ms_{0};
+	uint64_t elapsed_ms_{0};
+	uint64_t bytes_{0};
+	uint32_t packets_{0};
+	uint32_t max_seq_{0};
+	CPUUsage usage_;
+};
+
+void NetworkBenchmark::client(Shell &shell, const std::string &host,
+		Protocol protocol, Direction direction, unsigned long seconds,
+		unsigned long rate_kbps) {
+	auto client = std::make_shared<Client>(protocol, direction, seconds, rate_kbps);
+
+	if (!client->start(shell, host, DEFAULT_PORT))
+		return;
+
+	shell.block_with([client] (Shell &shell, bool stop) -> bool {
+		return client->loop(shell, stop);
+	});
+}
+
+void NetworkBenchmark::server(Shell &shell) {
+	auto server = std::make_shared<Server>();
+
+	if (!server->start(shell, INADDR_ANY, DEFAULT_PORT))
+		return;
+
+	logger_.info(F("Server started"));
+
+	shell.block_with([server] (Shell &shell, bool stop) -> bool {
+		if (stop) {
+			logger_.info(F("Server stopped"));
+			return true;
+		}
+
+		server->loop(shell);
+		return false;
+	});
+}
+
+void NetworkBenchmark::loopback(Shell &shell, Protocol protocol,
+		Direction direction, unsigned long seconds, unsigned long rate_kbps) {
+	auto server = std::make_shared<Server>();
+	auto client = std::make_shared<Client>(protocol, direction, seconds, rate_kbps);
+
+	if (!server->start(shell, INADDR_LOOPBACK, DEFAULT_PORT))
+		return;
+
+	if (!client->start(shell, uuid::read_flash_string(F("127.0.0.1")), DEFAULT_PORT))
+		return;
+
+	shell.block_with([server, client] (Shell &shell, bool stop) -> bool {
+		server->loop(shell);
+		return client->loop(shell, stop);
+	});
+}
+
+} // namespace app
+
+#endif
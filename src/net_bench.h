@@ -0,0 +1,78 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#if defined(ARDUINO_ARCH_ESP32) || defined(ENV_NATIVE)
+
+#include <Arduino.h>
+
+#include <memory>
+#include <string>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+namespace app {
+
+/*
+ * TCP/UDP throughput test compatible with pio/net-bench.py.
+ *
+ * The client connects to the server's TCP port and sends a 16 byte header:
+ *   "MCUB", mode (u8), reserved (u8), client UDP port (u16), seconds (u32),
+ *   UDP rate in kbit/s (u32)
+ *
+ * Data is then transferred in the requested direction over the TCP
+ * connection (or UDP datagrams prefixed with a u32 sequence number). At the
+ * end of every test other than TCP receive the server sends a 16 byte result
+ * of bytes (u64), packets (u32) and lost packets (u32). All values are in
+ * network byte order.
+ */
+class NetworkBenchmark {
+public:
+	enum class Protocol : uint8_t {
+		TCP = 0,
+		UDP = 1,
+	};
+
+	/* Direction relative to the client */
+	enum class Direction : uint8_t {
+		SEND = 0,
+		RECEIVE = 1,
+	};
+
+	static constexpr uint16_t DEFAULT_PORT = 5202;
+	static constexpr unsigned long DEFAULT_SECONDS = 10;
+	static constexpr unsigned long DEFAULT_UDP_RATE_KBPS = 10000;
+
+	static void client(uuid::console::Shell &shell, const std::string &host,
+		Protocol protocol, Direction direction, unsigned long seconds,
+		unsigned long rate_kbps);
+	static void server(uuid::console::Shell &shell);
+	static void loopback(uuid::console::Shell &shell, Protocol protocol,
+		Direction direction, unsigned long seconds, unsigned long rate_kbps);
+
+private:
+	class Client;
+	class Server;
+
+	static uuid::log::Logger logger_;
+};
+
+} // namespace app
+
+#endif
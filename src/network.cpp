@@ -46,13 +46,11 @@
 
 #include <functional>
 
+#include "app/command_arena.h"
 #include "app/config.h"
+#include "app/pstr.h"
 
-#ifndef PSTR_ALIGN
-# define PSTR_ALIGN 4
-#endif
-
-static const char __pstr__logger_name[] __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "wifi";
+MAKE_PSTR(logger_name, "wifi")
 
 namespace app {
 
@@ -200,6 +198,10 @@ void Network::configure_ntp() {
 # error "Unknown arch"
 #endif
 
+void Network::loop() {
+	probe_.loop();
+}
+
 void Network::connect() {
 	Config config;
 
@@ -299,13 +301,18 @@ void Network::print_status(uuid::console::Shell &shell) {
 			shell.printfln(F("IPv4 nameserver: %s"),
 					uuid::printable_to_string(WiFi.dnsIP()).c_str());
 
+			shell.println();
+			probe_.print_status(shell);
+
 #ifdef ARDUINO_ARCH_ESP8266
 # if LWIP_IPV6
+			CommandArena &arena = command_arena(shell);
+
 			shell.println();
 			for (size_t i = 0; i < LWIP_IPV6_NUM_ADDRESSES; i++) {
 				if (ip6_addr_isvalid(netif_ip6_addr_state(netif_default, i))) {
 					shell.printfln(F("IPv6 address: %s"),
-							uuid::printable_to_string(IPAddress(netif_ip_addr6(netif_default, i))).c_str());
+							arena.printable_to_string(IPAddress(netif_ip_addr6(netif_default, i))));
 				}
 			}
 # endif
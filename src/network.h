@@ -29,11 +29,14 @@
 #include <uuid/console.h>
 #include <uuid/log.h>
 
+#include "gateway_probe.h"
+
 namespace app {
 
 class Network {
 public:
 	void start();
+	void loop();
 	void connect();
 	void reconnect();
 	void disconnect();
@@ -64,6 +67,7 @@ private:
 #endif
 
 	bool connect_{false};
+	GatewayProbe probe_;
 };
 
 } // namespace app
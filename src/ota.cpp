@@ -0,0 +1,768 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/ota.h"
+
+#include <Arduino.h>
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-enum"
+#include <esp_crt_bundle.h>
+#pragma GCC diagnostic pop
+#include <esp_http_client.h>
+#include <esp_image_format.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <esp_timer.h>
+#include <mbedtls/sha256.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+#include <CBOR_streams.h>
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/allocator.h"
+#include "app/fs.h"
+#include "app/pstr.h"
+#include "app/util.h"
+
+namespace cbor = qindesign::cbor;
+
+MAKE_PSTR(logger_name, "ota")
+MAKE_PSTR(state_filename, "/ota.cbor")
+
+namespace app {
+
+uuid::log::Logger OTAWriter::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
+uuid::log::Logger OTADownload::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
+std::atomic<bool> OTAWriter::in_progress_{false};
+
+OTAWriter::OTAWriter() {
+	mbedtls_sha256_init(&sha256_);
+}
+
+OTAWriter::~OTAWriter() {
+	abort();
+	mbedtls_sha256_free(&sha256_);
+}
+
+bool OTAWriter::begin(size_t image_size) {
+	if (!start(esp_ota_get_next_update_partition(nullptr), image_size))
+		return false;
+
+	logger_.info(F("Writing %zu byte image to partition %s"), image_size, partition_->label);
+	return true;
+}
+
+bool OTAWriter::resume(const std::string &partition_label, size_t image_size, size_t offset) {
+	if (!start(esp_ota_get_next_update_partition(nullptr), image_size))
+		return false;
+
+	if (partition_label != partition_->label)
+		return fail(F("OTA partition has changed"));
+
+	/* Data after the last saved offset may have been written */
+	offset -= offset % SPI_FLASH_SEC_SIZE;
+
+	if (offset > partition_->size || (image_size > 0 && offset > image_size))
+		return fail(F("Invalid resume offset"));
+
+	allocator::buffer<allocator::Subsystem::OTA> buffer;
+
+	try {
+		buffer.resize(SPI_FLASH_SEC_SIZE);
+	} catch (...) {
+		return fail(F("Out of memory"));
+	}
+
+	while (written_ < offset) {
+		size_t len = std::min(offset - written_, (size_t)SPI_FLASH_SEC_SIZE);
+		uint64_t start_us = esp_timer_get_time();
+		esp_err_t err = esp_partition_read(partition_, written_, buffer.data(), len);
+
+		if (err) {
+			logger_.err(F("Read failed at offset %zu: %d"), written_, err);
+			return fail(F("Flash read failed"));
+		}
+
+		if (!header(buffer.data(), len))
+			return false;
+
+		hash(buffer.data(), len);
+		hash_us_ += esp_timer_get_time() - start_us;
+		written_ += len;
+	}
+
+	flash_offset_ = offset;
+	erased_ = offset;
+	logger_.info(F("Resuming %zu byte image at offset %zu on partition %s"),
+		image_size, offset, partition_->label);
+	return true;
+}
+
+bool OTAWriter::start(const esp_partition_t *partition, size_t image_size) {
+	abort();
+
+	partition_ = partition;
+	error_ = nullptr;
+	tail_len_ = 0;
+	pending_len_ = 0;
+	image_size_ = image_size;
+	written_ = 0;
+	flash_offset_ = 0;
+	erased_ = 0;
+	hash_appended_ = false;
+	write_us_ = 0;
+	hash_us_ = 0;
+	verify_us_ = 0;
+
+	if (!partition_)
+		return fail(F("No OTA partition"));
+
+	if (image_size > partition_->size)
+		return fail(F("Image too large for partition"));
+
+	if (in_progress_.exchange(true))
+		return fail(F("OTA update already in progress"));
+
+	mbedtls_sha256_starts_ret(&sha256_, 0);
+	running_ = true;
+	return true;
+}
+
+bool OTAWriter::write(const uint8_t *data, size_t len) {
+	if (!running_)
+		return false;
+
+	if (written_ + len > partition_->size || (image_size_ > 0 && written_ + len > image_size_))
+		return fail(F("Image too large"));
+
+	if (!header(data, len))
+		return false;
+
+	uint64_t start_us = esp_timer_get_time();
+	hash(data, len);
+	uint64_t hash_end_us = esp_timer_get_time();
+	bool ok = program(data, len);
+
+	hash_us_ += hash_end_us - start_us;
+	write_us_ += esp_timer_get_time() - hash_end_us;
+
+	if (!ok)
+		return false;
+
+	written_ += len;
+	return true;
+}
+
+/* Copy the header (at the current offset) and check it when it's complete */
+bool OTAWriter::header(const uint8_t *data, size_t len) {
+	if (written_ >= HEADER_LEN)
+		return true;
+
+	size_t header_len = std::min(len, HEADER_LEN - written_);
+
+	std::memcpy(&header_[written_], data, header_len);
+
+	if (written_ + header_len < HEADER_LEN)
+		return true;
+
+	return check_header();
+}
+
+/*
+ * Reject an image for the wrong chip or without an application description
+ * before the rest of it is downloaded.
+ */
+bool OTAWriter::check_header() {
+	esp_image_header_t header;
+	esp_app_desc_t app_desc;
+
+	std::memcpy(&header, &header_[0], sizeof(header));
+	std::memcpy(&app_desc, &header_[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], sizeof(app_desc));
+
+	if (header.magic != ESP_IMAGE_HEADER_MAGIC)
+		return fail(F("Invalid image header"));
+
+	if (header.chip_id != CONFIG_IDF_FIRMWARE_CHIP_ID)
+		return fail(F("Image is for a different chip"));
+
+	if (app_desc.magic_word != ESP_APP_DESC_MAGIC_WORD)
+		return fail(F("Invalid application description"));
+
+#ifdef CONFIG_SECURE_SIGNED_ON_UPDATE
+	/*
+	 * Signed images end with a signature block after the appended hash, so
+	 * it's not the last 32 bytes of the image. The whole image (including
+	 * the hash) is verified when the boot partition is set instead.
+	 */
+	hash_appended_ = false;
+#else
+	hash_appended_ = header.hash_appended == 1;
+#endif
+	logger_.info(F("Image: %.32s %.32s (%.16s %.16s)"),
+		app_desc.project_name, app_desc.version, app_desc.date, app_desc.time);
+	return true;
+}
+
+/*
+ * The last 32 bytes of the image may be the appended hash, so they're held
+ * back until more data is written.
+ */
+void OTAWriter::hash(const uint8_t *data, size_t len) {
+	if (tail_len_ + len <= HASH_LEN) {
+		std::memcpy(&tail_[tail_len_], data, len);
+		tail_len_ += len;
+		return;
+	}
+
+	size_t hash_len = tail_len_ + len - HASH_LEN;
+	size_t from_tail = std::min(hash_len, tail_len_);
+
+	mbedtls_sha256_update_ret(&sha256_, tail_.data(), from_tail);
+	mbedtls_sha256_update_ret(&sha256_, data, hash_len - from_tail);
+
+	std::memmove(&tail_[0], &tail_[from_tail], tail_len_ - from_tail);
+	tail_len_ -= from_tail;
+	std::memcpy(&tail_[tail_len_], &data[hash_len - from_tail], len - (hash_len - from_tail));
+	tail_len_ = HASH_LEN;
+}
+
+/* Encrypted partitions must be written in 16 byte blocks */
+bool OTAWriter::program(const uint8_t *data, size_t len) {
+	if (!partition_->encrypted)
+		return flash_write(data, len);
+
+	if (pending_len_ > 0) {
+		size_t copy_len = std::min(len, ENCRYPTED_BLOCK_LEN - pending_len_);
+
+		std::memcpy(&pending_[pending_len_], data, copy_len);
+		pending_len_ += copy_len;
+		data += copy_len;
+		len -= copy_len;
+
+		if (pending_len_ < ENCRYPTED_BLOCK_LEN)
+			return true;
+
+		if (!flash_write(pending_.data(), pending_len_))
+			return false;
+
+		pending_len_ = 0;
+	}
+
+	size_t aligned_len = len - len % ENCRYPTED_BLOCK_LEN;
+
+	if (aligned_len > 0 && !flash_write(data, aligned_len))
+		return false;
+
+	std::memcpy(pending_.data(), &data[aligned_len], len - aligned_len);
+	pending_len_ = len - aligned_len;
+	return true;
+}
+
+/* Erase sectors as they're needed */
+bool OTAWriter::flash_write(const uint8_t *data, size_t len) {
+	size_t end = flash_offset_ + len;
+
+	if (end > erased_) {
+		size_t erase_end = std::min((end + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE,
+			(size_t)partition_->size);
+		esp_err_t err = esp_partition_erase_range(partition_, erased_, erase_end - erased_);
+
+		if (err) {
+			logger_.err(F("Erase failed at offset %zu: %d"), erased_, err);
+			return fail(F("Flash erase failed"));
+		}
+
+		erased_ = erase_end;
+	}
+
+	esp_err_t err = esp_partition_write(partition_, flash_offset_, data, len);
+
+	if (err) {
+		logger_.err(F("Write failed at offset %zu: %d"), flash_offset_, err);
+		return fail(F("Flash write failed"));
+	}
+
+	flash_offset_ = end;
+	return true;
+}
+
+bool OTAWriter::finish() {
+	if (!running_)
+		return false;
+
+	if (written_ < HEADER_LEN + HASH_LEN)
+		return fail(F("Image too short"));
+
+	if (image_size_ > 0 && written_ != image_size_)
+		return fail(F("Image incomplete"));
+
+	if (pending_len_ > 0) {
+		std::fill(pending_.begin() + pending_len_, pending_.end(), 0xFF);
+
+		if (!flash_write(pending_.data(), pending_.size()))
+			return false;
+
+		pending_len_ = 0;
+	}
+
+	uint64_t start_us = esp_timer_get_time();
+
+	if (hash_appended_) {
+		std::array<uint8_t, HASH_LEN> digest;
+
+		mbedtls_sha256_finish_ret(&sha256_, digest.data());
+
+		if (digest != tail_) {
+			verify_us_ += esp_timer_get_time() - start_us;
+			return fail(F("Image hash mismatch"));
+		}
+	}
+
+	running_ = false;
+
+	esp_err_t err = esp_ota_set_boot_partition(partition_);
+	verify_us_ += esp_timer_get_time() - start_us;
+	in_progress_ = false;
+
+	if (err) {
+		logger_.err(F("Unable to set boot partition %s: %d"), partition_->label, err);
+		return fail(F("Image verification failed"));
+	}
+
+	logger_.notice(F("Wrote %zu byte image to partition %s"), written_, partition_->label);
+	return true;
+}
+
+void OTAWriter::abort() {
+	if (running_) {
+		running_ = false;
+		in_progress_ = false;
+		logger_.notice(F("Update stopped after %zu bytes"), written_);
+	}
+}
+
+bool OTAWriter::fail(const __FlashStringHelper *error) {
+	error_ = error;
+	logger_.err(F("%S"), error);
+	abort();
+	return false;
+}
+
+void OTAWriter::print_timing(uuid::console::Shell &shell) const {
+	shell.printfln(F("Flash write:   %lums"), (unsigned long)(write_us_ / 1000));
+	shell.printfln(F("Hash:          %lums (%S)"), (unsigned long)(hash_us_ / 1000),
+		hash_appended_ ? F("appended hash checked") : F("appended hash not checked"));
+	shell.printfln(F("Verify:        %lums"), (unsigned long)(verify_us_ / 1000));
+}
+
+class OTADownload::Client {
+public:
+	~Client();
+
+	bool start(uuid::console::Shell &shell, const std::string &url);
+	bool loop(uuid::console::Shell &shell, bool stop);
+
+private:
+	static constexpr size_t BUFFER_SIZE = 4096;
+	static constexpr size_t SAVE_INTERVAL = 64 * 1024;
+	static constexpr uint64_t RETRY_INTERVAL_MS = 5000;
+	static constexpr unsigned int MAX_RETRIES = 60;
+
+	static esp_err_t http_event(esp_http_client_event_t *event);
+
+	bool connect(uuid::console::Shell &shell);
+	void interrupted(uuid::console::Shell &shell);
+	bool load_state(std::string &url, std::string &etag, size_t &size,
+		size_t &written, std::string &partition);
+	void save_state();
+	void remove_state();
+	void progress(uuid::console::Shell &shell, bool force);
+	void cleanup();
+
+	std::string url_;
+	std::string etag_;
+	std::string response_etag_;
+	std::string content_range_;
+	esp_http_client_handle_t client_{nullptr};
+	OTAWriter writer_;
+	std::array<char, BUFFER_SIZE> buffer_;
+	size_t size_{0};
+	size_t saved_{0};
+	uint64_t start_ms_{0};
+	uint64_t last_update_ms_{0};
+	uint64_t retry_ms_{0};
+	unsigned int retries_{0};
+	int last_progress_{-1};
+	uint64_t download_us_{0};
+};
+
+OTADownload::Client::~Client() {
+	cleanup();
+}
+
+bool OTADownload::Client::start(uuid::console::Shell &shell, const std::string &url) {
+	std::string state_url;
+	std::string etag;
+	std::string partition;
+	size_t size;
+	size_t written;
+
+	/* Don't discard the saved state of a download that can't be resumed yet */
+	if (OTAWriter::in_progress()) {
+		shell.printfln(F("OTA failed: %S"), F("OTA update already in progress"));
+		return false;
+	}
+
+	url_ = url;
+	start_ms_ = uuid::get_uptime_ms();
+	last_update_ms_ = start_ms_;
+
+	if (load_state(state_url, etag, size, written, partition)) {
+		if (state_url == url_ && !etag.empty() && writer_.resume(partition, size, written)) {
+			etag_ = etag;
+			size_ = size;
+			saved_ = writer_.written();
+			shell.printfln(F("OTA resuming at %zu of %zu"), writer_.written(), size_);
+		} else {
+			remove_state();
+		}
+	}
+
+	return connect(shell);
+}
+
+esp_err_t OTADownload::Client::http_event(esp_http_client_event_t *event) {
+	if (event->event_id == HTTP_EVENT_ON_HEADER) {
+		auto *client = reinterpret_cast<Client *>(event->user_data);
+
+		if (!strcasecmp(event->header_key, "ETag")) {
+			client->response_etag_ = event->header_value;
+		} else if (!strcasecmp(event->header_key, "Content-Range")) {
+			client->content_range_ = event->header_value;
+		}
+	}
+
+	return ESP_OK;
+}
+
+bool OTADownload::Client::connect(uuid::console::Shell &shell) {
+	esp_http_client_config_t http_config{};
+
+	cleanup();
+
+	http_config.url = url_.c_str();
+	http_config.buffer_size = BUFFER_SIZE;
+	http_config.crt_bundle_attach = arduino_esp_crt_bundle_attach;
+	http_config.keep_alive_enable = true;
+	http_config.disable_auto_redirect = true;
+	http_config.event_handler = http_event;
+	http_config.user_data = this;
+
+	client_ = esp_http_client_init(&http_config);
+	if (!client_) {
+		shell.println(F("OTA failed: unable to create HTTP client"));
+		return false;
+	}
+
+	bool resume = writer_.running() && writer_.written() > 0 && !etag_.empty();
+
+	response_etag_.clear();
+	content_range_.clear();
+
+	if (resume) {
+		std::string range = "bytes=" + std::to_string(writer_.written()) + "-";
+
+		esp_http_client_set_header(client_, "Range", range.c_str());
+		esp_http_client_set_header(client_, "If-Range", etag_.c_str());
+	}
+
+	uint64_t start_us = esp_timer_get_time();
+	esp_err_t err = esp_http_client_open(client_, 0);
+	if (err) {
+		download_us_ += esp_timer_get_time() - start_us;
+		shell.printfln(F("OTA connection failed: %d"), err);
+		cleanup();
+		return false;
+	}
+
+	int64_t length = esp_http_client_fetch_headers(client_);
+	int status = esp_http_client_get_status_code(client_);
+	download_us_ += esp_timer_get_time() - start_us;
+
+	if (resume && status == 206) {
+		size_t first, last, total;
+
+		if (std::sscanf(content_range_.c_str(), "bytes %zu-%zu/%zu", &first, &last, &total) != 3
+				|| first != writer_.written() || (size_ > 0 && total != size_)) {
+			shell.printfln(F("OTA failed: unexpected range \"%s\""), content_range_.c_str());
+			cleanup();
+			return false;
+		}
+
+		logger_.info(F("Resuming download of %s at %zu"), url_.c_str(), first);
+		return true;
+	} else if (status != 200) {
+		shell.printfln(F("OTA failed: HTTP status %d"), status);
+		cleanup();
+		return false;
+	}
+
+	/* The image has changed (or the server doesn't support ranges) */
+	size_ = length > 0 ? length : 0;
+	etag_ = response_etag_;
+	shell.printfln(F("OTA size: %zu"), size_);
+
+	if (!writer_.begin(size_)) {
+		shell.printfln(F("OTA failed: %S"), writer_.error());
+		remove_state();
+		cleanup();
+		return false;
+	}
+
+	save_state();
+	logger_.info(F("Downloading %s"), url_.c_str());
+	return true;
+}
+
+bool OTADownload::Client::loop(uuid::console::Shell &shell, bool stop) {
+	if (stop) {
+		writer_.abort();
+		save_state();
+		cleanup();
+		shell.println(F("OTA aborted"));
+		return true;
+	}
+
+	if (!client_) {
+		if (uuid::get_uptime_ms() < retry_ms_)
+			return false;
+
+		if (retries_ >= MAX_RETRIES) {
+			shell.println(F("OTA failed: too many retries"));
+			writer_.abort();
+			return true;
+		}
+
+		retries_++;
+		shell.printfln(F("OTA retry %u/%u at %zu"), retries_, MAX_RETRIES, writer_.written());
+
+		if (!connect(shell)) {
+			if (!writer_.running())
+				return true;
+
+			retry_ms_ = uuid::get_uptime_ms() + RETRY_INTERVAL_MS;
+		}
+		return false;
+	}
+
+	uint64_t start_us = esp_timer_get_time();
+	int len = esp_http_client_read(client_, buffer_.data(), buffer_.size());
+	download_us_ += esp_timer_get_time() - start_us;
+
+	if (len < 0 || (len == 0 && !esp_http_client_is_complete_data_received(client_))) {
+		interrupted(shell);
+		return false;
+	} else if (len == 0) {
+		progress(shell, true);
+		cleanup();
+		remove_state();
+
+		if (!writer_.finish()) {
+			shell.printfln(F("OTA failed: %S"), writer_.error());
+			return true;
+		}
+
+		shell.printfln(F("OTA finished (%lums)"), (unsigned long)(uuid::get_uptime_ms() - start_ms_));
+		shell.printfln(F("Download:      %lums"), (unsigned long)(download_us_ / 1000));
+		writer_.print_timing(shell);
+		return true;
+	}
+
+	if (!writer_.write(reinterpret_cast<const uint8_t *>(buffer_.data()), len)) {
+		shell.printfln(F("OTA failed: %S"), writer_.error());
+		remove_state();
+		cleanup();
+		return true;
+	}
+
+	retries_ = 0;
+
+	if (writer_.written() - saved_ >= SAVE_INTERVAL)
+		save_state();
+
+	progress(shell, false);
+	return false;
+}
+
+/* Keep the data that has been written and try again later */
+void OTADownload::Client::interrupted(uuid::console::Shell &shell) {
+	shell.printfln(F("OTA download interrupted at %zu"), writer_.written());
+	logger_.warning(F("Download interrupted at %zu"), writer_.written());
+	save_state();
+	cleanup();
+	retry_ms_ = uuid::get_uptime_ms() + RETRY_INTERVAL_MS;
+}
+
+bool OTADownload::Client::load_state(std::string &url, std::string &etag,
+		size_t &size, size_t &written, std::string &partition) {
+	std::string filename = uuid::read_flash_string(FPSTR(__pstr__state_filename));
+	const char mode[2] = {'r', '\0'};
+	auto file = FS.open(filename.c_str(), mode);
+
+	if (!file)
+		return false;
+
+	cbor::Reader reader{file};
+	uint64_t length;
+	bool indefinite;
+
+	if (!cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag)
+			|| !cbor::expectMap(reader, &length, &indefinite) || indefinite)
+		return false;
+
+	size = 0;
+	written = 0;
+
+	while (length-- > 0) {
+		std::string key;
+		uint64_t value;
+
+		if (!read_text(reader, key))
+			return false;
+
+		if (key == "url") {
+			if (!read_text(reader, url, 1024))
+				return false;
+		} else if (key == "etag") {
+			if (!read_text(reader, etag))
+				return false;
+		} else if (key == "partition") {
+			if (!read_text(reader, partition))
+				return false;
+		} else if (key == "size") {
+			if (!cbor::expectUnsignedInt(reader, &value))
+				return false;
+
+			size = value;
+		} else if (key == "written") {
+			if (!cbor::expectUnsignedInt(reader, &value))
+				return false;
+
+			written = value;
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Progress can only be resumed if the server provides an ETag */
+void OTADownload::Client::save_state() {
+	if (etag_.empty() || !writer_.partition() || writer_.written() == 0) {
+		remove_state();
+		return;
+	}
+
+	std::string filename = uuid::read_flash_string(FPSTR(__pstr__state_filename));
+	const char mode[2] = {'w', '\0'};
+	auto file = FS.open(filename.c_str(), mode);
+
+	if (!file) {
+		logger_.err(F("Unable to open %s for writing"), filename.c_str());
+		return;
+	}
+
+	cbor::Writer writer{file};
+
+	writer.writeTag(cbor::kSelfDescribeTag);
+	writer.beginMap(5);
+	write_text(writer, "url");
+	write_text(writer, url_);
+	write_text(writer, "etag");
+	write_text(writer, etag_);
+	write_text(writer, "size");
+	writer.writeUnsignedInt(size_);
+	write_text(writer, "written");
+	writer.writeUnsignedInt(writer_.written());
+	write_text(writer, "partition");
+	write_text(writer, writer_.partition()->label);
+
+	if (file.getWriteError()) {
+		logger_.err(F("Failed to write %s: %u"), filename.c_str(), file.getWriteError());
+	} else {
+		saved_ = writer_.written();
+	}
+}
+
+void OTADownload::Client::remove_state() {
+	std::string filename = uuid::read_flash_string(FPSTR(__pstr__state_filename));
+
+	if (FS.exists(filename.c_str()))
+		FS.remove(filename.c_str());
+
+	saved_ = 0;
+}
+
+void OTADownload::Client::progress(uuid::console::Shell &shell, bool force) {
+	uint64_t now_ms = uuid::get_uptime_ms();
+	int progress = size_ > 0 ? (writer_.written() * 100) / size_ : 0;
+
+	if (force || (now_ms - last_update_ms_ >= 1000 && (size_ == 0 || progress != last_progress_))) {
+		shell.printfln(F("OTA progress: %3d%% (%zu)"), progress, writer_.written());
+		last_progress_ = progress;
+		last_update_ms_ = now_ms;
+	}
+}
+
+void OTADownload::Client::cleanup() {
+	if (client_) {
+		esp_http_client_close(client_);
+		esp_http_client_cleanup(client_);
+		client_ = nullptr;
+	}
+}
+
+void OTADownload::update(uuid::console::Shell &shell, const std::string &url) {
+	auto client = std::make_shared<Client>();
+
+	if (!client->start(shell, url))
+		return;
+
+	shell.block_with([client] (uuid::console::Shell &shell, bool stop) -> bool {
+		return client->loop(shell, stop);
+	});
+}
+
+} // namespace app
+
+#endif
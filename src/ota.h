@@ -0,0 +1,140 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <esp_image_format.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+namespace app {
+
+/*
+ * Writes an application image to the next OTA partition.
+ *
+ * The image is hashed as it is written (using the SHA accelerator) and the
+ * header is checked as soon as it has been received, so that an invalid
+ * image is rejected without having to read it back from flash. If the
+ * image has an appended SHA-256 hash then it is compared to the hash of
+ * the data that was written.
+ *
+ * Flash sectors are erased as they're written instead of using the
+ * esp_ota_begin()/esp_ota_end() API, so that an interrupted update can be
+ * resumed and the image is only read back once (when it is verified by
+ * esp_ota_set_boot_partition()).
+ *
+ * Only one writer can be running at a time because they would all write to
+ * the same partition.
+ */
+class OTAWriter {
+public:
+	OTAWriter();
+	~OTAWriter();
+
+	OTAWriter(const OTAWriter&) = delete;
+	OTAWriter& operator=(const OTAWriter&) = delete;
+
+	/* The image size is 0 if it is not known */
+	bool begin(size_t image_size);
+
+	/*
+	 * Continue writing an image from the start of the sector containing
+	 * the offset, hashing the data that has already been written.
+	 */
+	bool resume(const std::string &partition_label, size_t image_size, size_t offset);
+
+	bool write(const uint8_t *data, size_t len);
+	bool finish();
+	void abort();
+
+	/* An image is being written by any writer */
+	static inline bool in_progress() { return in_progress_; }
+
+	inline bool running() const { return running_; }
+	inline size_t written() const { return written_; }
+	inline const esp_partition_t *partition() const { return partition_; }
+	inline const __FlashStringHelper *error() const { return error_; }
+
+	/* Output the time spent writing, hashing and verifying the image */
+	void print_timing(uuid::console::Shell &shell) const;
+
+private:
+	static constexpr size_t HASH_LEN = 32;
+	static constexpr size_t HEADER_LEN = sizeof(esp_image_header_t)
+		+ sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t);
+	static constexpr size_t ENCRYPTED_BLOCK_LEN = 16;
+
+	static uuid::log::Logger logger_;
+	static std::atomic<bool> in_progress_;
+
+	bool start(const esp_partition_t *partition, size_t image_size);
+	bool header(const uint8_t *data, size_t len);
+	bool check_header();
+	void hash(const uint8_t *data, size_t len);
+	bool program(const uint8_t *data, size_t len);
+	bool flash_write(const uint8_t *data, size_t len);
+	bool fail(const __FlashStringHelper *error);
+
+	const esp_partition_t *partition_{nullptr};
+	bool running_{false};
+	mbedtls_sha256_context sha256_;
+	std::array<uint8_t, HEADER_LEN> header_;
+	std::array<uint8_t, HASH_LEN> tail_;
+	size_t tail_len_{0};
+	std::array<uint8_t, ENCRYPTED_BLOCK_LEN> pending_;
+	size_t pending_len_{0};
+	size_t image_size_{0};
+	size_t written_{0};
+	size_t flash_offset_{0};
+	size_t erased_{0};
+	bool hash_appended_{false};
+	const __FlashStringHelper *error_{nullptr};
+	uint64_t write_us_{0};
+	uint64_t hash_us_{0};
+	uint64_t verify_us_{0};
+};
+
+/*
+ * Download and write an application image over HTTPS.
+ *
+ * Progress is saved to a file so that the download can be resumed (using
+ * an HTTP Range request if the ETag of the image has not changed) after
+ * the connection is lost or the device is restarted.
+ */
+class OTADownload {
+public:
+	static void update(uuid::console::Shell &shell, const std::string &url);
+
+private:
+	class Client;
+
+	static uuid::log::Logger logger_;
+};
+
+} // namespace app
+
+#endif
@@ -0,0 +1,498 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/ota_server.h"
+
+#include <Arduino.h>
+#include <esp_pthread.h>
+#include <esp_random.h>
+#include <esp_spi_flash.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <mbedtls/md.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <uuid/common.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+
+MAKE_PSTR(logger_name, "ota")
+
+namespace app {
+
+uuid::log::Logger OTAServer::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
+
+static bool would_block() {
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static bool set_nonblocking(int fd) {
+	int flags = ::fcntl(fd, F_GETFL, 0);
+
+	return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void close_socket(int &fd) {
+	if (fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+static uint32_t get_u32(const uint8_t *buf) {
+	return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16)
+		| ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+OTAServer::~OTAServer() {
+	stop();
+}
+
+void OTAServer::config(bool enabled, const std::string &password) {
+	enabled = enabled && !password.empty();
+	password_ = password;
+
+	if (enabled && !enabled_) {
+		enabled_ = true;
+		start();
+	} else if (!enabled && enabled_) {
+		enabled_ = false;
+		stop();
+		logger_.info(F("OTA disabled"));
+	}
+}
+
+void OTAServer::start() {
+	struct sockaddr_in local{};
+	int one = 1;
+
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(PORT);
+
+	listen_fd_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listen_fd_ < 0 || !set_nonblocking(listen_fd_)) {
+		logger_.err(F("Unable to create TCP socket (%d)"), errno);
+		close_socket(listen_fd_);
+		return;
+	}
+
+	::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if (::bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&local), sizeof(local))
+			|| ::listen(listen_fd_, 1)) {
+		logger_.err(F("Unable to listen on TCP port %u (%d)"), PORT, errno);
+		close_socket(listen_fd_);
+		return;
+	}
+
+	logger_.info(F("OTA enabled on port %u"), PORT);
+}
+
+void OTAServer::stop() {
+	disconnect();
+	close_socket(listen_fd_);
+}
+
+void OTAServer::loop() {
+	if (restart_ms_ && uuid::get_uptime_ms() >= restart_ms_) {
+		ESP.restart();
+		return;
+	}
+
+	switch (state_) {
+	case State::LISTENING:
+		accept();
+		break;
+
+	case State::AUTH:
+		auth();
+		break;
+
+	case State::RECEIVING:
+		receive();
+		break;
+
+	case State::FINISHING:
+		finish();
+		break;
+	}
+}
+
+void OTAServer::accept() {
+	if (listen_fd_ < 0 || restart_ms_)
+		return;
+
+	socklen_t len = sizeof(peer_);
+
+	client_fd_ = ::accept(listen_fd_, reinterpret_cast<struct sockaddr *>(&peer_), &len);
+	if (client_fd_ < 0)
+		return;
+
+	if (!set_nonblocking(client_fd_)) {
+		close_socket(client_fd_);
+		return;
+	}
+
+	std::array<uint8_t, 4 + NONCE_LEN> challenge;
+
+	esp_fill_random(nonce_.data(), nonce_.size());
+	std::memcpy(&challenge[0], "MCUO", 4);
+	std::memcpy(&challenge[4], nonce_.data(), nonce_.size());
+
+	if (::send(client_fd_, challenge.data(), challenge.size(), 0) != (ssize_t)challenge.size()) {
+		close_socket(client_fd_);
+		return;
+	}
+
+	request_len_ = 0;
+	state_ = State::AUTH;
+	state_ms_ = uuid::get_uptime_ms();
+}
+
+void OTAServer::auth() {
+	while (request_len_ < request_.size()) {
+		ssize_t len = ::recv(client_fd_, &request_[request_len_], request_.size() - request_len_, 0);
+
+		if (len < 0 && would_block()) {
+			if (uuid::get_uptime_ms() - state_ms_ >= AUTH_TIMEOUT_MS)
+				fail(F("Timeout waiting for request"));
+			return;
+		} else if (len <= 0) {
+			disconnect();
+			return;
+		}
+
+		request_len_ += len;
+	}
+
+	std::array<uint8_t, 4 + NONCE_LEN> message;
+	std::array<uint8_t, MAC_LEN> mac;
+	uint8_t difference = 0;
+
+	std::memcpy(&message[0], nonce_.data(), nonce_.size());
+	std::memcpy(&message[NONCE_LEN], &request_[4], 4);
+
+	if (std::memcmp(request_.data(), "MCUO", 4)
+			|| mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+				reinterpret_cast<const unsigned char *>(password_.data()), password_.length(),
+				message.data(), message.size(), mac.data())) {
+		fail(F("Invalid request"));
+		return;
+	}
+
+	/* Constant time comparison */
+	for (size_t i = 0; i < MAC_LEN; i++)
+		difference |= mac[i] ^ request_[8 + i];
+
+	if (difference) {
+		fail(F("Authentication failed"));
+		return;
+	}
+
+	image_size_ = get_u32(&request_[4]);
+	if (!image_size_) {
+		fail(F("Invalid image size"));
+		return;
+	}
+
+	/* The image is authenticated separately, before it can be booted */
+	mbedtls_md_init(&hmac_);
+	if (mbedtls_md_setup(&hmac_, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1)
+			|| mbedtls_md_hmac_starts(&hmac_,
+				reinterpret_cast<const unsigned char *>(password_.data()), password_.length())
+			|| mbedtls_md_hmac_update(&hmac_, message.data(), message.size())) {
+		fail(F("Out of memory"));
+		return;
+	}
+
+	/* The writer also checks this, but avoid allocating the buffers */
+	if (OTAWriter::in_progress()) {
+		fail(F("OTA update already in progress"));
+		return;
+	}
+
+	try {
+		for (auto &buffer : buffers_)
+			buffer.resize(BUFFER_SIZE);
+	} catch (...) {
+		fail(F("Out of memory"));
+		return;
+	}
+
+	std::array<char, INET_ADDRSTRLEN> address;
+
+	::inet_ntop(AF_INET, &peer_.sin_addr, address.data(), address.size());
+	logger_.notice(F("Receiving %zu byte image from %s"), image_size_, address.data());
+
+	if (!writer_.begin(image_size_)) {
+		fail(writer_.error());
+		return;
+	}
+
+	if (!writer_start()) {
+		fail(F("Unable to start writer"));
+		return;
+	}
+
+	reply("OK");
+
+	fill_ = 0;
+	fill_len_ = 0;
+	received_ = 0;
+	image_mac_len_ = 0;
+	wait_start_us_ = 0;
+	wait_us_ = 0;
+	start_us_ = esp_timer_get_time();
+	state_ = State::RECEIVING;
+	state_ms_ = uuid::get_uptime_ms();
+}
+
+/*
+ * Read as much as possible while the other buffer is being written so that
+ * the TCP receive window stays open.
+ */
+void OTAServer::receive() {
+	unsigned long step_start_us = micros();
+
+	while (micros() - step_start_us < STEP_TIME_US) {
+		if (fill_len_ == BUFFER_SIZE || received_ == image_size_) {
+			if (!submit())
+				return;
+
+			if (received_ == image_size_) {
+				state_ = State::FINISHING;
+				state_ms_ = uuid::get_uptime_ms();
+				return;
+			}
+		}
+
+		ssize_t len = ::recv(client_fd_, &buffers_[fill_][fill_len_],
+			std::min(BUFFER_SIZE - fill_len_, image_size_ - received_), 0);
+
+		if (len < 0 && would_block()) {
+			if (uuid::get_uptime_ms() - state_ms_ >= IDLE_TIMEOUT_MS)
+				fail(F("Timeout receiving image"));
+			return;
+		} else if (len <= 0) {
+			fail(F("Connection lost"));
+			return;
+		}
+
+		mbedtls_md_hmac_update(&hmac_, &buffers_[fill_][fill_len_], len);
+		fill_len_ += len;
+		received_ += len;
+		state_ms_ = uuid::get_uptime_ms();
+	}
+}
+
+/*
+ * Wait for the last buffer to be written and the HMAC of the image, then
+ * verify the image. The boot partition is only changed if both are valid.
+ */
+void OTAServer::finish() {
+	if (!writer_idle())
+		return;
+
+	writer_stop();
+
+	while (image_mac_len_ < image_mac_.size()) {
+		ssize_t len = ::recv(client_fd_, &image_mac_[image_mac_len_], image_mac_.size() - image_mac_len_, 0);
+
+		if (len < 0 && would_block()) {
+			if (uuid::get_uptime_ms() - state_ms_ >= IDLE_TIMEOUT_MS)
+				fail(F("Timeout waiting for image HMAC"));
+			return;
+		} else if (len <= 0) {
+			fail(F("Connection lost"));
+			return;
+		}
+
+		image_mac_len_ += len;
+	}
+
+	std::array<uint8_t, MAC_LEN> mac;
+	uint8_t difference = 0;
+
+	if (mbedtls_md_hmac_finish(&hmac_, mac.data())) {
+		fail(F("Unable to authenticate image"));
+		return;
+	}
+
+	/* Constant time comparison */
+	for (size_t i = 0; i < MAC_LEN; i++)
+		difference |= mac[i] ^ image_mac_[i];
+
+	if (difference) {
+		fail(F("Image authentication failed"));
+		return;
+	}
+
+	if (!writer_.finish()) {
+		fail(writer_.error());
+		return;
+	}
+
+	unsigned long elapsed_ms = (esp_timer_get_time() - start_us_) / 1000;
+	unsigned long rate_kbps = (uint64_t)received_ * 8 / std::max(elapsed_ms, 1UL);
+
+	logger_.notice(F("Received %zu bytes in %lums (%lu kbit/s, waited %lums for flash writes)"),
+		received_, elapsed_ms, rate_kbps, (unsigned long)(wait_us_ / 1000));
+
+	reply("OK " + std::to_string(received_) + " " + std::to_string(elapsed_ms));
+	disconnect();
+
+	logger_.notice(F("Restarting"));
+	restart_ms_ = uuid::get_uptime_ms() + 1000;
+}
+
+/* Pass the current buffer to the writer if it has finished the other one */
+bool OTAServer::submit() {
+	if (!writer_idle()) {
+		if (!wait_start_us_)
+			wait_start_us_ = esp_timer_get_time();
+		return false;
+	}
+
+	if (wait_start_us_) {
+		wait_us_ += esp_timer_get_time() - wait_start_us_;
+		wait_start_us_ = 0;
+	}
+
+	if (!writer_.running()) {
+		fail(writer_.error());
+		return false;
+	}
+
+	if (fill_len_ > 0) {
+		std::lock_guard<std::mutex> lock{mutex_};
+
+		write_buffer_ = fill_;
+		write_len_ = fill_len_;
+		cv_.notify_all();
+
+		fill_ ^= 1;
+		fill_len_ = 0;
+	}
+
+	return true;
+}
+
+bool OTAServer::writer_idle() {
+	std::lock_guard<std::mutex> lock{mutex_};
+
+	return write_buffer_ < 0;
+}
+
+bool OTAServer::writer_start() {
+	exit_ = false;
+	write_buffer_ = -1;
+
+	try {
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+
+		thread_ = std::thread{[this] {
+			writer_run();
+		}};
+	} catch (...) {
+		return false;
+	}
+
+	return true;
+}
+
+void OTAServer::writer_stop() {
+	if (thread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock{mutex_};
+
+			exit_ = true;
+			cv_.notify_all();
+		}
+
+		thread_.join();
+	}
+}
+
+void OTAServer::writer_run() {
+	std::unique_lock<std::mutex> lock{mutex_};
+
+	while (true) {
+		cv_.wait(lock, [this] { return exit_ || write_buffer_ >= 0; });
+
+		if (write_buffer_ < 0)
+			break;
+
+		const uint8_t *data = buffers_[write_buffer_].data();
+		size_t len = write_len_;
+
+		lock.unlock();
+		writer_.write(data, len);
+		lock.lock();
+
+		write_buffer_ = -1;
+	}
+}
+
+void OTAServer::reply(const std::string &text) {
+	std::string line = text + "\n";
+
+	::send(client_fd_, line.c_str(), line.length(), 0);
+}
+
+void OTAServer::fail(const __FlashStringHelper *reason) {
+	logger_.warning(F("OTA failed: %S"), reason);
+
+	if (client_fd_ >= 0)
+		reply("ERROR " + uuid::read_flash_string(reason));
+
+	disconnect();
+}
+
+void OTAServer::disconnect() {
+	writer_stop();
+	writer_.abort();
+	mbedtls_md_free(&hmac_);
+	close_socket(client_fd_);
+
+	for (auto &buffer : buffers_) {
+		buffer.clear();
+		buffer.shrink_to_fit();
+	}
+
+	state_ = State::LISTENING;
+}
+
+} // namespace app
+
+#endif
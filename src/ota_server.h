@@ -0,0 +1,134 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <lwip/sockets.h>
+#include <mbedtls/md.h>
+
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <uuid/log.h>
+
+#include "allocator.h"
+#include "ota.h"
+
+namespace app {
+
+/*
+ * Receive application images pushed over TCP by pio/ota-push.py.
+ *
+ * The server sends "MCUO" and a 32 byte nonce. The client sends "MCUO",
+ * the image size (u32, network byte order) and the HMAC-SHA256 of the
+ * nonce and image size using the OTA password as the key. The server
+ * replies with a line of "OK" or "ERROR <reason>". The client sends the
+ * image followed by the HMAC-SHA256 of the nonce, image size and image.
+ * The server replies with a line of "OK <bytes> <ms>" or "ERROR <reason>"
+ * and the image is only made bootable if the HMAC is correct.
+ *
+ * The image is received into one buffer while the other is written to
+ * flash by a separate thread, so that network receive and flash writes
+ * overlap. Every write other than the last is a whole number of flash
+ * sectors.
+ */
+class OTAServer {
+public:
+	static constexpr uint16_t PORT = 3232;
+
+	~OTAServer();
+
+	void config(bool enabled, const std::string &password);
+	void loop();
+
+private:
+	enum class State : uint8_t {
+		LISTENING,
+		AUTH,
+		RECEIVING,
+		FINISHING,
+	};
+
+	static constexpr size_t NONCE_LEN = 32;
+	static constexpr size_t MAC_LEN = 32;
+	static constexpr size_t REQUEST_LEN = 4 + 4 + MAC_LEN;
+	static constexpr size_t BUFFER_SIZE = 32 * 1024;
+	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+	static constexpr unsigned long STEP_TIME_US = 10000;
+	static constexpr uint64_t AUTH_TIMEOUT_MS = 5000;
+	static constexpr uint64_t IDLE_TIMEOUT_MS = 10000;
+
+	static uuid::log::Logger logger_;
+
+	void start();
+	void stop();
+	void accept();
+	void auth();
+	void receive();
+	void finish();
+	bool submit();
+	bool writer_idle();
+	bool writer_start();
+	void writer_stop();
+	void writer_run();
+	void reply(const std::string &text);
+	void fail(const __FlashStringHelper *reason);
+	void disconnect();
+
+	bool enabled_{false};
+	std::string password_;
+	State state_{State::LISTENING};
+	int listen_fd_{-1};
+	int client_fd_{-1};
+	struct sockaddr_in peer_{};
+	std::array<uint8_t, NONCE_LEN> nonce_;
+	std::array<uint8_t, REQUEST_LEN> request_;
+	size_t request_len_{0};
+	mbedtls_md_context_t hmac_{};
+	std::array<uint8_t, MAC_LEN> image_mac_;
+	size_t image_mac_len_{0};
+	uint64_t state_ms_{0};
+	uint64_t start_us_{0};
+	uint64_t wait_start_us_{0};
+	uint64_t wait_us_{0};
+	uint64_t restart_ms_{0};
+	size_t image_size_{0};
+	size_t received_{0};
+
+	OTAWriter writer_;
+	std::array<allocator::buffer<allocator::Subsystem::OTA>, 2> buffers_;
+	unsigned int fill_{0};
+	size_t fill_len_{0};
+
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	int write_buffer_{-1};
+	size_t write_len_{0};
+	bool exit_{false};
+};
+
+} // namespace app
+
+#endif
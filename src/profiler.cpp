@@ -0,0 +1,282 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/profiler.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#ifdef __XTENSA__
+# include <freertos/xtensa_context.h>
+#else
+# error "Unknown arch"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/fs.h"
+#include "app/pstr.h"
+
+MAKE_PSTR(logger_name, "profiler")
+
+namespace app {
+
+uuid::log::Logger Profiler::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::KERN};
+Profiler *Profiler::instance_{nullptr};
+
+Profiler::~Profiler() {
+	release();
+}
+
+bool Profiler::start(uuid::console::Shell &shell, unsigned long frequency_hz) {
+	if (running()) {
+		shell.println(F("Profiler already running"));
+		return false;
+	}
+
+	if (frequency_hz == 0 || frequency_hz > MAX_FREQUENCY_HZ) {
+		shell.printfln(F("Invalid frequency (maximum %lu Hz)"), MAX_FREQUENCY_HZ);
+		return false;
+	}
+
+	capacity_ = PSRAM_SAMPLES;
+	samples_ = reinterpret_cast<Sample *>(heap_caps_malloc(capacity_ * sizeof(Sample), MALLOC_CAP_SPIRAM));
+
+	if (!samples_) {
+		capacity_ = INTERNAL_SAMPLES;
+		samples_ = reinterpret_cast<Sample *>(heap_caps_malloc(capacity_ * sizeof(Sample), MALLOC_CAP_INTERNAL));
+	}
+
+	if (!samples_) {
+		capacity_ = 0;
+		shell.println(F("Out of memory"));
+		return false;
+	}
+
+	task_count_ = 0;
+	count_ = 0;
+	dropped_ = 0;
+	interval_us_ = 1000000UL / frequency_hz;
+	start_ms_ = uuid::get_uptime_ms();
+	instance_ = this;
+
+	/* APB clock is 80MHz, so this counts in µs */
+	timer_ = timerBegin(TIMER, 80, true);
+	if (!timer_) {
+		shell.println(F("Unable to allocate timer"));
+		release();
+		return false;
+	}
+
+	timerAttachInterrupt(timer_, timer_interrupt, true);
+	timerAlarmWrite(timer_, interval_us_, true);
+	timerAlarmEnable(timer_);
+
+	logger_.info(F("Started sampling at %lu Hz on core %d (capacity %zu samples)"),
+		frequency_hz, xPortGetCoreID(), capacity_);
+	shell.printfln(F("Sampling at %lu Hz for up to %lus"), frequency_hz,
+		(unsigned long)(capacity_ / frequency_hz));
+	return true;
+}
+
+void IRAM_ATTR Profiler::timer_interrupt() {
+	Profiler *profiler = instance_;
+
+	if (!profiler)
+		return;
+
+	size_t count = profiler->count_;
+
+	if (count >= profiler->capacity_) {
+		profiler->dropped_ = profiler->dropped_ + 1;
+		return;
+	}
+
+	/*
+	 * The outermost interrupt handler saves the interrupted context on
+	 * the task's stack and stores the stack pointer in the first field
+	 * of the TCB (pxTopOfStack) before switching to the interrupt stack.
+	 */
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	const XtExcFrame *frame = *reinterpret_cast<XtExcFrame *const *>(task);
+	size_t task_count = profiler->task_count_;
+	uint16_t index = UNKNOWN_TASK;
+
+	for (size_t i = 0; i < task_count; i++) {
+		if (profiler->tasks_[i].handle == task) {
+			index = i;
+			break;
+		}
+	}
+
+	if (index == UNKNOWN_TASK && task_count < MAX_TASKS) {
+		const char *name = pcTaskGetName(task);
+		auto &entry = profiler->tasks_[task_count];
+
+		entry.handle = task;
+		for (size_t i = 0; i < TASK_NAME_LENGTH; i++) {
+			entry.name[i] = *name;
+			if (*name)
+				name++;
+		}
+
+		index = task_count;
+		profiler->task_count_ = task_count + 1;
+	}
+
+	profiler->samples_[count].pc = frame->pc;
+	profiler->samples_[count].task = index;
+	profiler->count_ = count + 1;
+}
+
+void Profiler::stop(uuid::console::Shell &shell, const std::string &filename) {
+	if (!running()) {
+		shell.println(F("Profiler not running"));
+		return;
+	}
+
+	timerAlarmDisable(timer_);
+	timerDetachInterrupt(timer_);
+	timerEnd(timer_);
+	timer_ = nullptr;
+	instance_ = nullptr;
+
+	size_t count = count_;
+	size_t task_count = task_count_;
+	uint64_t elapsed_ms = uuid::get_uptime_ms() - start_ms_;
+
+	logger_.info(F("Stopped sampling with %zu samples (%lu dropped)"),
+		count, (unsigned long)dropped_);
+	shell.printfln(F("Samples: %zu in %lu.%03lus (%lu dropped)"), count,
+		(unsigned long)(elapsed_ms / 1000), (unsigned long)(elapsed_ms % 1000),
+		(unsigned long)dropped_);
+
+	if (count > 0) {
+		std::array<size_t, MAX_TASKS + 1> task_samples{};
+
+		for (size_t i = 0; i < count; i++) {
+			task_samples[std::min(static_cast<size_t>(samples_[i].task), MAX_TASKS)]++;
+		}
+
+		shell.println();
+		for (size_t i = 0; i <= task_count && i <= MAX_TASKS; i++) {
+			if (task_samples[i] == 0)
+				continue;
+
+			if (i < task_count) {
+				shell.printfln(F("%08x %3u%% %.16s"), (uintptr_t)tasks_[i].handle,
+					(unsigned int)(task_samples[i] * 100 / count), tasks_[i].name);
+			} else {
+				shell.printfln(F("         %3u%% (other tasks)"),
+					(unsigned int)(task_samples[i] * 100 / count));
+			}
+		}
+		shell.println();
+
+		if (write(filename, count, task_count)) {
+			shell.printfln(F("%s: write %zu"), filename.c_str(),
+				16 + task_count * (4 + TASK_NAME_LENGTH) + count * 6);
+		} else {
+			shell.printfln(F("%s: write error"), filename.c_str());
+		}
+	}
+
+	release();
+}
+
+static void write_le16(uint8_t *buf, uint16_t value) {
+	buf[0] = value;
+	buf[1] = value >> 8;
+}
+
+static void write_le32(uint8_t *buf, uint32_t value) {
+	write_le16(&buf[0], value);
+	write_le16(&buf[2], value >> 16);
+}
+
+bool Profiler::write(const std::string &filename, size_t count, size_t task_count) {
+	const char mode[2] = { 'w', '\0' };
+	auto file = FS.open(filename.c_str(), mode, true);
+
+	if (!file)
+		return false;
+
+	uint8_t buf[6 * 64];
+
+	std::memcpy(&buf[0], "MCUP", 4);
+	buf[4] = FORMAT_VERSION;
+	buf[5] = 0;
+	write_le16(&buf[6], task_count);
+	write_le32(&buf[8], interval_us_);
+	write_le32(&buf[12], count);
+
+	if (file.write(buf, 16) != 16)
+		return false;
+
+	for (size_t i = 0; i < task_count; i++) {
+		write_le32(&buf[0], (uintptr_t)tasks_[i].handle);
+		std::memcpy(&buf[4], tasks_[i].name, TASK_NAME_LENGTH);
+
+		if (file.write(buf, 4 + TASK_NAME_LENGTH) != 4 + TASK_NAME_LENGTH)
+			return false;
+	}
+
+	size_t len = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		write_le32(&buf[len], samples_[i].pc);
+		write_le16(&buf[len + 4], samples_[i].task);
+		len += 6;
+
+		if (len == sizeof(buf) || i == count - 1) {
+			if (file.write(buf, len) != len)
+				return false;
+
+			len = 0;
+		}
+	}
+
+	return true;
+}
+
+void Profiler::release() {
+	if (timer_) {
+		timerAlarmDisable(timer_);
+		timerDetachInterrupt(timer_);
+		timerEnd(timer_);
+		timer_ = nullptr;
+		instance_ = nullptr;
+	}
+
+	heap_caps_free(samples_);
+	samples_ = nullptr;
+	capacity_ = 0;
+}
+
+} // namespace app
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+
+#include <array>
+#include <string>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+namespace app {
+
+/*
+ * Samples the program counter and current task of the interrupted code
+ * from a hardware timer interrupt on the core that started the profiler.
+ *
+ * Samples are stored in PSRAM (if available) and written to a file when
+ * stopped, which can be symbolised using pio/app-profile.py and the
+ * firmware ELF file:
+ *
+ * Header (16 bytes, little endian):
+ *   char[4]  "MCUP"
+ *   uint8_t  version (1)
+ *   uint8_t  reserved
+ *   uint16_t number of tasks
+ *   uint32_t sample interval (µs)
+ *   uint32_t number of samples
+ *
+ * Tasks (20 bytes each):
+ *   uint32_t handle
+ *   char[16] name (null padded)
+ *
+ * Samples (6 bytes each):
+ *   uint32_t program counter
+ *   uint16_t task index (0xFFFF if there were too many tasks)
+ */
+class Profiler {
+public:
+	static constexpr unsigned long DEFAULT_FREQUENCY_HZ = 1000;
+	static constexpr unsigned long MAX_FREQUENCY_HZ = 10000;
+
+	~Profiler();
+
+	inline bool running() const { return timer_ != nullptr; }
+
+	bool start(uuid::console::Shell &shell, unsigned long frequency_hz);
+	void stop(uuid::console::Shell &shell, const std::string &filename);
+
+private:
+	static constexpr uint8_t TIMER = 3;
+	static constexpr size_t PSRAM_SAMPLES = 64 * 1024;
+	static constexpr size_t INTERNAL_SAMPLES = 2 * 1024;
+	static constexpr uint8_t FORMAT_VERSION = 1;
+	static constexpr size_t MAX_TASKS = 32;
+	static constexpr size_t TASK_NAME_LENGTH = 16;
+	static constexpr uint16_t UNKNOWN_TASK = 0xFFFF;
+
+	struct Sample {
+		uint32_t pc;
+		uint16_t task;
+	};
+
+	/*
+	 * Task names are recorded by the interrupt handler while the task is
+	 * running because the task may have been deleted by the time the
+	 * profiler is stopped.
+	 */
+	struct Task {
+		void *handle;
+		char name[TASK_NAME_LENGTH];
+	};
+
+	static uuid::log::Logger logger_;
+	static Profiler *instance_;
+
+	static void timer_interrupt();
+
+	bool write(const std::string &filename, size_t count, size_t task_count);
+	void release();
+
+	hw_timer_t *timer_{nullptr};
+	Sample *samples_{nullptr};
+	size_t capacity_{0};
+	std::array<Task, MAX_TASKS> tasks_;
+	volatile size_t task_count_{0};
+	volatile size_t count_{0};
+	volatile uint32_t dropped_{0};
+	uint32_t interval_us_{0};
+	uint64_t start_ms_{0};
+};
+
+} // namespace app
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef PSTR_ALIGN
+# define PSTR_ALIGN 4
+#endif
+
+/*
+ * Named flash strings are placed in a mergeable string section (the same
+ * way that the ESP8266 core does for PSTR()) so that the linker pools
+ * identical strings across the whole firmware, including strings from F().
+ *
+ * The "#" comments out the section flags that the compiler appends.
+ */
+#if defined(ARDUINO_ARCH_ESP8266)
+# define MCU_APP_PSTR_SECTION __attribute__((__section__("\".irom.text.mcu_app.pstr\", \"aSM\", @progbits, 1 #")))
+#elif defined(ARDUINO_ARCH_ESP32)
+# define MCU_APP_PSTR_SECTION __attribute__((__section__("\".rodata.mcu_app.pstr\", \"aMS\", @progbits, 1 #")))
+#else
+# define MCU_APP_PSTR_SECTION
+#endif
+
+#define MAKE_PSTR(string_name, string_literal) static const char __pstr__##string_name[] __attribute__((__aligned__(PSTR_ALIGN))) MCU_APP_PSTR_SECTION = string_literal;
+#define MAKE_PSTR_WORD(string_name) MAKE_PSTR(string_name, #string_name)
+#define F_(string_name) FPSTR(__pstr__##string_name)
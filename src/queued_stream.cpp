@@ -0,0 +1,197 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENV_NATIVE
+#include "app/queued_stream.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+#include "app/util.h"
+
+MAKE_PSTR(logger_name, "telnet")
+
+namespace app {
+
+static uuid::log::Logger logger{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+std::set<QueuedStream*> QueuedStream::streams_;
+
+QueuedStream::QueuedStream(::Stream &stream) : stream_(stream) {
+	streams_.insert(this);
+}
+
+QueuedStream::~QueuedStream() {
+	streams_.erase(this);
+}
+
+void QueuedStream::owner(const std::shared_ptr<uuid::console::Shell> &shell, const std::string &name) {
+	owner_ = shell;
+	name_ = name;
+}
+
+void QueuedStream::loop_all() {
+	std::vector<std::shared_ptr<uuid::console::Shell>> stalled;
+
+	for (auto *stream : streams_) {
+		stream->drain();
+
+		if (stream->overflowed_) {
+			auto shell = stream->owner_.lock();
+
+			if (shell && shell->running()) {
+				logger.warning(F("Output queue full on console %s, disconnecting"), stream->name_.c_str());
+				stalled.push_back(std::move(shell));
+			}
+		}
+	}
+
+	/* Stopping a shell may remove its stream */
+	for (auto &shell : stalled)
+		shell->stop();
+}
+
+void QueuedStream::show_all(uuid::console::Shell &shell) {
+	shell.printfln(F("Console  Queued  Peak    Logs dropped  Short writes  Written"));
+
+	for (auto *stream : streams_) {
+		shell.printfln(F("%-7s  %6zu  %6zu  %12lu  %12lu  %llu"),
+			stream->name_.c_str(), stream->queued(), stream->peak_,
+			stream->logs_dropped_.load(), stream->short_writes_, stream->bytes_written_);
+	}
+}
+
+bool QueuedStream::accept_log(const uuid::log::Message &message) {
+	if (queued_size_ + LOG_HEADER_SIZE + message.text.length() > APP_TELNET_QUEUE_LOG_LIMIT) {
+		logs_dropped_++;
+		return false;
+	}
+
+	return true;
+}
+
+size_t QueuedStream::output_available() const {
+	size_t queued = queued_size_;
+
+	return overflowed_ || queued >= APP_TELNET_QUEUE_LOG_LIMIT ? 0 : APP_TELNET_QUEUE_LOG_LIMIT - queued;
+}
+
+int QueuedStream::available() {
+	return stream_.available();
+}
+
+int QueuedStream::read() {
+	return stream_.read();
+}
+
+int QueuedStream::peek() {
+	return stream_.peek();
+}
+
+int QueuedStream::availableForWrite() {
+	return overflowed_ ? 0 : APP_TELNET_QUEUE_SIZE - queued();
+}
+
+size_t QueuedStream::write(uint8_t data) {
+	return write(&data, 1);
+}
+
+size_t QueuedStream::write(const uint8_t *buffer, size_t size) {
+	if (!overflowed_ && queued() + size > APP_TELNET_QUEUE_SIZE) {
+		/*
+		 * Don't wait for the client. Commands that produce a lot of output
+		 * check availableForWrite() and continue on the next loop.
+		 */
+		retry_ms_ = 0;
+		drain();
+
+		if (queued() + size > APP_TELNET_QUEUE_SIZE)
+			overflowed_ = true;
+	}
+
+	if (overflowed_)
+		return 0;
+
+	if (head_ > 0 && head_ >= queue_.size() / 2) {
+		queue_.erase(queue_.begin(), queue_.begin() + head_);
+		head_ = 0;
+	}
+
+	queue_.insert(queue_.end(), buffer, buffer + size);
+	peak_ = std::max(peak_, queued());
+	queued_size_ = queued();
+
+	if (queued() >= WRITE_CHUNK_SIZE)
+		drain();
+
+	return size;
+}
+
+void QueuedStream::flush() {
+	drain();
+}
+
+/*
+ * Write whatever the client will accept. After a short write the client
+ * is left alone for a while so that it can't repeatedly block the loop
+ * until the write timeout.
+ */
+void QueuedStream::drain() {
+	if (queued() == 0 || (retry_ms_ && uuid::get_uptime_ms() < retry_ms_))
+		return;
+
+	retry_ms_ = 0;
+
+	while (queued() > 0) {
+		size_t len = std::min(queued(), WRITE_CHUNK_SIZE);
+		size_t written = stream_.write(&queue_[head_], len);
+
+		head_ += written;
+		bytes_written_ += written;
+
+		if (written < len) {
+			short_writes_++;
+			retry_ms_ = uuid::get_uptime_ms() + RETRY_INTERVAL_MS;
+			break;
+		}
+	}
+
+	if (queued() == 0) {
+		queue_.clear();
+		head_ = 0;
+
+		if (queue_.capacity() > 2 * WRITE_CHUNK_SIZE)
+			queue_.shrink_to_fit();
+	}
+
+	queued_size_ = queued();
+}
+
+} // namespace app
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef ENV_NATIVE
+
+#include "util.h"
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+/*
+ * Output is queued so the socket write timeout only needs to be long
+ * enough to avoid short writes when the client is keeping up.
+ */
+#ifndef APP_TELNET_WRITE_TIMEOUT_MS
+# define APP_TELNET_WRITE_TIMEOUT_MS 10
+#endif
+
+/* Maximum output queued for a telnet session before it is disconnected */
+#ifndef APP_TELNET_QUEUE_SIZE
+# if defined(ARDUINO_ARCH_ESP8266)
+#  define APP_TELNET_QUEUE_SIZE 2048
+# else
+#  define APP_TELNET_QUEUE_SIZE 8192
+# endif
+#endif
+
+/* Log messages are dropped if they would make more than this queued */
+#ifndef APP_TELNET_QUEUE_LOG_LIMIT
+# define APP_TELNET_QUEUE_LOG_LIMIT (APP_TELNET_QUEUE_SIZE / 2)
+#endif
+
+/* Log messages accepted but not yet written by the shell of a telnet session */
+#ifndef APP_TELNET_LOG_MESSAGES
+# define APP_TELNET_LOG_MESSAGES ((APP_TELNET_QUEUE_SIZE - APP_TELNET_QUEUE_LOG_LIMIT) / 128)
+#endif
+
+namespace app {
+
+/*
+ * Output queue for a network console session, so that a slow client
+ * doesn't block the main loop every time the shell writes to it.
+ *
+ * Output is written to the underlying stream from loop_all() (after the
+ * shells have run) and that is skipped for a while after a short write.
+ *
+ * Log messages are dropped before they're given to the shell if they would
+ * fill the queue more than half full. The shell writes them later, so it
+ * is limited to APP_TELNET_LOG_MESSAGES that haven't been written yet and
+ * commands leave the other half of the queue for them.
+ *
+ * Writes never wait for the client. Commands that produce a lot of output
+ * must check output_available() and produce it in steps. If output doesn't
+ * fit in the queue then the session is stopped.
+ */
+class QueuedStream: public ::Stream {
+public:
+	explicit QueuedStream(::Stream &stream);
+	~QueuedStream() override;
+
+	static void loop_all();
+	static void show_all(uuid::console::Shell &shell);
+
+	void owner(const std::shared_ptr<uuid::console::Shell> &shell, const std::string &name);
+
+	/* Check if there's space for a log message before the shell queues it */
+	bool accept_log(const uuid::log::Message &message);
+
+	/* Space for command output that leaves room for accepted log messages */
+	size_t output_available() const;
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	int availableForWrite() override;
+	size_t write(uint8_t data) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	void flush() override;
+
+private:
+	static constexpr size_t WRITE_CHUNK_SIZE = 536;
+	static constexpr uint64_t RETRY_INTERVAL_MS = 100;
+	static constexpr size_t LOG_HEADER_SIZE = 48; /* Timestamp, level and name */
+
+	static std::set<QueuedStream*> streams_;
+
+	void drain();
+	inline size_t queued() const { return queue_.size() - head_; }
+
+	::Stream &stream_;
+	std::weak_ptr<uuid::console::Shell> owner_;
+	std::string name_;
+	std::vector<uint8_t> queue_;
+	size_t head_{0};
+	std::atomic<size_t> queued_size_{0}; /* For log messages from other threads */
+	uint64_t retry_ms_{0};
+	bool overflowed_{false};
+	size_t peak_{0};
+	unsigned long short_writes_{0};
+	std::atomic<unsigned long> logs_dropped_{0};
+	unsigned long long bytes_written_{0};
+};
+
+} // namespace app
+
+#endif
@@ -0,0 +1,613 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/ram_fs.h"
+
+#include <Arduino.h>
+#include <FS.h>
+#include <FSImpl.h>
+#include <esp_heap_caps.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace app {
+
+RamFS TMPFS{"/tmp"};
+
+class RamFSImpl: public fs::FSImpl, public std::enable_shared_from_this<RamFSImpl> {
+	friend class RamFileImpl;
+
+public:
+	explicit RamFSImpl(const char *root);
+
+	bool begin(size_t size_limit);
+	void end();
+
+	bool mounted() const;
+	inline const std::string& root() const { return root_; }
+	size_t limit() const;
+	size_t used() const;
+
+	fs::FileImplPtr open(const char *path, const char *mode, const bool create) override;
+	bool exists(const char *path) override;
+	bool rename(const char *path_from, const char *path_to) override;
+	bool remove(const char *path) override;
+	bool mkdir(const char *path) override;
+	bool rmdir(const char *path) override;
+
+private:
+	static constexpr size_t MIN_CAPACITY = 256;
+
+	struct Node {
+		explicit Node(bool directory) : directory(directory), mtime(::time(nullptr)) {}
+		~Node() { heap_caps_free(data); }
+
+		void release();
+
+		const bool directory;
+		bool removed{false};
+		uint8_t *data{nullptr};
+		size_t size{0};
+		size_t capacity{0};
+		time_t mtime;
+	};
+
+	using Nodes = std::map<std::string, std::shared_ptr<Node>>;
+
+	std::string normalise(const char *path) const;
+	static std::string parent(const std::string &path);
+	bool is_child(const std::string &dir, const std::string &path) const;
+	bool has_children(const std::string &dir) const;
+	bool make_parents(const std::string &path, bool create);
+	bool reserve(Node &node, size_t size);
+	void erase(Nodes::iterator it);
+	std::string next_child(const std::string &dir, const std::string &previous);
+
+	mutable std::mutex mutex_;
+	const std::string root_;
+	Nodes nodes_;
+	size_t limit_{0};
+	size_t used_{0};
+	bool mounted_{false};
+};
+
+class RamFileImpl: public fs::FileImpl {
+public:
+	RamFileImpl(std::shared_ptr<RamFSImpl> fs, const std::string &path,
+		std::shared_ptr<RamFSImpl::Node> node, bool readable, bool writable, bool append);
+
+	size_t write(const uint8_t *buf, size_t size) override;
+	size_t read(uint8_t *buf, size_t size) override;
+	void flush() override {}
+	bool seek(uint32_t pos, fs::SeekMode mode) override;
+	size_t position() const override { return pos_; }
+	size_t size() const override;
+	bool setBufferSize(size_t size) override { return true; }
+	void close() override;
+	time_t getLastWrite() override;
+	const char *path() const override { return path_.c_str(); }
+	const char *name() const override;
+	boolean isDirectory() override { return node_ && node_->directory; }
+	fs::FileImplPtr openNextFile(const char *mode) override;
+	boolean seekDir(long position) override;
+	String getNextFileName() override;
+	void rewindDirectory() override { previous_.clear(); }
+	operator bool() override { return (bool)node_; }
+
+private:
+	std::shared_ptr<RamFSImpl> fs_;
+	const std::string path_;
+	std::shared_ptr<RamFSImpl::Node> node_;
+	const bool readable_;
+	const bool writable_;
+	const bool append_;
+	size_t pos_{0};
+	std::string previous_;
+};
+
+void RamFSImpl::Node::release() {
+	removed = true;
+	heap_caps_free(data);
+	data = nullptr;
+	size = 0;
+	capacity = 0;
+}
+
+RamFSImpl::RamFSImpl(const char *root) : root_(root) {
+	mountpoint(root);
+}
+
+bool RamFSImpl::begin(size_t size_limit) {
+	std::lock_guard<std::mutex> lock{mutex_};
+
+	if (!mounted_) {
+		nodes_.emplace(root_, std::make_shared<Node>(true));
+		limit_ = size_limit;
+		used_ = 0;
+		mounted_ = true;
+	}
+
+	return true;
+}
+
+void RamFSImpl::end() {
+	std::lock_guard<std::mutex> lock{mutex_};
+
+	for (auto &node : nodes_)
+		node.second->release();
+
+	nodes_.clear();
+	limit_ = 0;
+	used_ = 0;
+	mounted_ = false;
+}
+
+bool RamFSImpl::mounted() const {
+	std::lock_guard<std::mutex> lock{mutex_};
+
+	return mounted_;
+}
+
+size_t RamFSImpl::limit() const {
+	std::lock_guard<std::mutex> lock{mutex_};
+
+	return limit_;
+}
+
+size_t RamFSImpl::used() const {
+	std::lock_guard<std::mutex> lock{mutex_};
+
+	return used_;
+}
+
+/*
+ * Paths must be absolute and under the root directory, without any empty,
+ * "." or ".." components. Trailing slashes are removed.
+ */
+std::string RamFSImpl::normalise(const char *path) const {
+	std::string name{path};
+
+	while (name.length() > 1 && name.back() == '/')
+		name.pop_back();
+
+	if (name != root_ && name.rfind(root_ + "/", 0) != 0)
+		return "";
+
+	if (name.find("//") != std::string::npos
+			|| name.find("/./") != std::string::npos
+			|| name.find("/../") != std::string::npos)
+		return "";
+
+	size_t pos = name.find_last_of('/');
+
+	if (name.compare(pos, std::string::npos, "/.") == 0
+			|| name.compare(pos, std::string::npos, "/..") == 0)
+		return "";
+
+	return name;
+}
+
+std::string RamFSImpl::parent(const std::string &path) {
+	return path.substr(0, path.find_last_of('/'));
+}
+
+bool RamFSImpl::is_child(const std::string &dir, const std::string &path) const {
+	return path.length() > dir.length() + 1
+		&& path.compare(0, dir.length(), dir) == 0
+		&& path[dir.length()] == '/'
+		&& path.find('/', dir.length() + 1) == std::string::npos;
+}
+
+bool RamFSImpl::has_children(const std::string &dir) const {
+	auto it = nodes_.upper_bound(dir + "/");
+
+	return it != nodes_.end() && it->first.rfind(dir + "/", 0) == 0;
+}
+
+/* Check that the parent directories exist, creating them if allowed */
+bool RamFSImpl::make_parents(const std::string &path, bool create) {
+	if (path == root_)
+		return true;
+
+	std::string dir = parent(path);
+	auto it = nodes_.find(dir);
+
+	if (it != nodes_.end())
+		return it->second->directory;
+
+	if (!create || !make_parents(dir, create))
+		return false;
+
+	nodes_.emplace(dir, std::make_shared<Node>(true));
+	return true;
+}
+
+bool RamFSImpl::reserve(Node &node, size_t size) {
+	if (size <= node.capacity)
+		return true;
+
+	size_t capacity = std::max(std::min(std::max(node.capacity * 2, MIN_CAPACITY),
+		node.size + (limit_ - used_)), size);
+	uint8_t *data = reinterpret_cast<uint8_t *>(heap_caps_realloc(node.data, capacity,
+		MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+
+	if (!data && capacity > size) {
+		capacity = size;
+		data = reinterpret_cast<uint8_t *>(heap_caps_realloc(node.data, capacity,
+			MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+	}
+
+	if (!data)
+		return false;
+
+	node.data = data;
+	node.capacity = capacity;
+	return true;
+}
+
+void RamFSImpl::erase(Nodes::iterator it) {
+	used_ -= it->second->size;
+	it->second->release();
+	nodes_.erase(it);
+}
+
+std::string RamFSImpl::next_child(const std::string &dir, const std::string &previous) {
+	std::lock_guard<std::mutex> lock{mutex_};
+
+	for (auto it = nodes_.upper_bound(previous.empty() ? dir + "/" : previous);
+			it != nodes_.end() && it->first.rfind(dir + "/", 0) == 0; ++it) {
+		if (is_child(dir, it->first))
+			return it->first;
+	}
+
+	return "";
+}
+
+fs::FileImplPtr RamFSImpl::open(const char *path, const char *mode, const bool create) {
+	std::lock_guard<std::mutex> lock{mutex_};
+	std::string name = normalise(path);
+
+	if (!mounted_ || name.empty())
+		return fs::FileImplPtr();
+
+	bool read = mode[0] == 'r';
+	bool write = mode[0] == 'w';
+	bool append = mode[0] == 'a';
+	bool update = mode[0] != '\0' && mode[1] == '+';
+	auto it = nodes_.find(name);
+	std::shared_ptr<Node> node;
+
+	if (it != nodes_.end()) {
+		node = it->second;
+
+		if (node->directory) {
+			if (!read || update)
+				return fs::FileImplPtr();
+		} else if (write) {
+			used_ -= node->size;
+			node->size = 0;
+			node->mtime = ::time(nullptr);
+		}
+	} else {
+		if (read || !(write || append) || !make_parents(name, create))
+			return fs::FileImplPtr();
+
+		node = std::make_shared<Node>(false);
+		nodes_.emplace(name, node);
+	}
+
+	return std::make_shared<RamFileImpl>(shared_from_this(), name, node,
+		read || update, write || append || update, append);
+}
+
+bool RamFSImpl::exists(const char *path) {
+	std::lock_guard<std::mutex> lock{mutex_};
+	std::string name = normalise(path);
+
+	return mounted_ && !name.empty() && nodes_.find(name) != nodes_.end();
+}
+
+bool RamFSImpl::rename(const char *path_from, const char *path_to) {
+	std::lock_guard<std::mutex> lock{mutex_};
+	std::string from = normalise(path_from);
+	std::string to = normalise(path_to);
+
+	if (!mounted_ || from.empty() || to.empty() || from == root_ || to == root_)
+		return false;
+
+	if (from == to)
+		return nodes_.find(from) != nodes_.end();
+
+	if (to.rfind(from + "/", 0) == 0)
+		return false;
+
+	auto from_it = nodes_.find(from);
+
+	if (from_it == nodes_.end() || !make_parents(to, false))
+		return false;
+
+	auto to_it = nodes_.find(to);
+
+	if (to_it != nodes_.end()) {
+		if (from_it->second->directory || to_it->second->directory)
+			return false;
+
+		erase(to_it);
+	}
+
+	std::string prefix = from + "/";
+	auto node = nodes_.extract(from_it);
+
+	node.key() = to;
+	nodes_.insert(std::move(node));
+
+	/* Move the contents of a directory */
+	auto it = nodes_.upper_bound(prefix);
+
+	while (it != nodes_.end() && it->first.rfind(prefix, 0) == 0) {
+		auto child = nodes_.extract(it++);
+
+		child.key().replace(0, from.length(), to);
+		nodes_.insert(std::move(child));
+	}
+
+	return true;
+}
+
+bool RamFSImpl::remove(const char *path) {
+	std::lock_guard<std::mutex> lock{mutex_};
+	std::string name = normalise(path);
+	auto it = nodes_.find(name);
+
+	if (!mounted_ || it == nodes_.end() || it->second->directory)
+		return false;
+
+	erase(it);
+	return true;
+}
+
+bool RamFSImpl::mkdir(const char *path) {
+	std::lock_guard<std::mutex> lock{mutex_};
+	std::string name = normalise(path);
+
+	if (!mounted_ || name.empty() || nodes_.find(name) != nodes_.end()
+			|| !make_parents(name, false))
+		return false;
+
+	nodes_.emplace(name, std::make_shared<Node>(true));
+	return true;
+}
+
+bool RamFSImpl::rmdir(const char *path) {
+	std::lock_guard<std::mutex> lock{mutex_};
+	std::string name = normalise(path);
+	auto it = nodes_.find(name);
+
+	if (!mounted_ || name == root_ || it == nodes_.end()
+			|| !it->second->directory || has_children(name))
+		return false;
+
+	erase(it);
+	return true;
+}
+
+RamFileImpl::RamFileImpl(std::shared_ptr<RamFSImpl> fs, const std::string &path,
+		std::shared_ptr<RamFSImpl::Node> node, bool readable, bool writable, bool append)
+		: fs_(fs), path_(path), node_(node), readable_(readable),
+		writable_(writable), append_(append) {
+}
+
+size_t RamFileImpl::write(const uint8_t *buf, size_t size) {
+	if (!node_ || node_->directory || !writable_)
+		return 0;
+
+	std::lock_guard<std::mutex> lock{fs_->mutex_};
+
+	if (node_->removed)
+		return 0;
+
+	if (append_)
+		pos_ = node_->size;
+
+	size_t end = pos_ + size;
+
+	if (end > node_->size) {
+		size_t available = fs_->limit_ - fs_->used_;
+
+		if (end - node_->size > available) {
+			if (pos_ >= node_->size + available)
+				return 0;
+
+			end = node_->size + available;
+			size = end - pos_;
+		}
+
+		if (!fs_->reserve(*node_, end))
+			return 0;
+
+		if (pos_ > node_->size)
+			std::memset(&node_->data[node_->size], 0, pos_ - node_->size);
+
+		fs_->used_ += end - node_->size;
+		node_->size = end;
+	}
+
+	std::memcpy(&node_->data[pos_], buf, size);
+	pos_ += size;
+	node_->mtime = ::time(nullptr);
+	return size;
+}
+
+size_t RamFileImpl::read(uint8_t *buf, size_t size) {
+	if (!node_ || node_->directory || !readable_)
+		return 0;
+
+	std::lock_guard<std::mutex> lock{fs_->mutex_};
+
+	if (pos_ >= node_->size)
+		return 0;
+
+	size = std::min(size, node_->size - pos_);
+	std::memcpy(buf, &node_->data[pos_], size);
+	pos_ += size;
+	return size;
+}
+
+bool RamFileImpl::seek(uint32_t pos, fs::SeekMode mode) {
+	if (!node_ || node_->directory)
+		return false;
+
+	std::lock_guard<std::mutex> lock{fs_->mutex_};
+	size_t base;
+
+	switch (mode) {
+	case fs::SeekSet:
+		base = 0;
+		break;
+
+	case fs::SeekCur:
+		base = pos_;
+		break;
+
+	case fs::SeekEnd:
+		base = node_->size;
+		break;
+
+	default:
+		return false;
+	}
+
+	if (base + pos > node_->size)
+		return false;
+
+	pos_ = base + pos;
+	return true;
+}
+
+size_t RamFileImpl::size() const {
+	if (!node_)
+		return 0;
+
+	std::lock_guard<std::mutex> lock{fs_->mutex_};
+
+	return node_->size;
+}
+
+void RamFileImpl::close() {
+	node_.reset();
+}
+
+time_t RamFileImpl::getLastWrite() {
+	if (!node_)
+		return 0;
+
+	std::lock_guard<std::mutex> lock{fs_->mutex_};
+
+	return node_->mtime;
+}
+
+const char *RamFileImpl::name() const {
+	return &path_[path_.find_last_of('/') + 1];
+}
+
+fs::FileImplPtr RamFileImpl::openNextFile(const char *mode) {
+	if (!isDirectory())
+		return fs::FileImplPtr();
+
+	previous_ = fs_->next_child(path_, previous_);
+
+	if (previous_.empty())
+		return fs::FileImplPtr();
+
+	return fs_->open(previous_.c_str(), mode, false);
+}
+
+boolean RamFileImpl::seekDir(long position) {
+	if (!isDirectory())
+		return false;
+
+	previous_.clear();
+
+	while (position-- > 0) {
+		previous_ = fs_->next_child(path_, previous_);
+
+		if (previous_.empty())
+			return false;
+	}
+
+	return true;
+}
+
+String RamFileImpl::getNextFileName() {
+	if (!isDirectory())
+		return "";
+
+	previous_ = fs_->next_child(path_, previous_);
+	return previous_.c_str();
+}
+
+RamFS::RamFS(const char *mountpoint) : RamFS(std::make_shared<RamFSImpl>(mountpoint)) {
+}
+
+RamFS::RamFS(std::shared_ptr<RamFSImpl> impl) : fs::FS(impl), impl_(impl) {
+}
+
+bool RamFS::begin(size_t size_limit) {
+	if (!psramFound())
+		return false;
+
+	return impl_->begin(std::min(size_limit, (size_t)ESP.getFreePsram() / 2));
+}
+
+void RamFS::end() {
+	impl_->end();
+}
+
+bool RamFS::mounted() const {
+	return impl_->mounted();
+}
+
+bool RamFS::contains(const std::string &path) const {
+	const std::string &root = impl_->root();
+
+	return path.rfind(root, 0) == 0
+		&& (path.length() == root.length() || path[root.length()] == '/');
+}
+
+const char *RamFS::mountpoint() const {
+	return impl_->root().c_str();
+}
+
+size_t RamFS::totalBytes() const {
+	return impl_->limit();
+}
+
+size_t RamFS::usedBytes() const {
+	return impl_->used();
+}
+
+} // namespace app
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <memory>
+#include <string>
+
+/* Maximum size of file content in /tmp (limited to half of the free PSRAM) */
+#ifndef APP_TMPFS_SIZE
+# define APP_TMPFS_SIZE (1024 * 1024)
+#endif
+
+namespace app {
+
+class RamFSImpl;
+
+/*
+ * Filesystem with file content stored in PSRAM, for temporary files that
+ * would otherwise cause unnecessary flash writes.
+ *
+ * Paths include the mount point (which is the root directory) so that
+ * they can be used in the same way as paths on the main filesystem.
+ */
+class RamFS: public fs::FS {
+public:
+	explicit RamFS(const char *mountpoint);
+
+	bool begin(size_t size_limit);
+	void end();
+
+	bool mounted() const;
+	bool contains(const std::string &path) const;
+	const char *mountpoint() const;
+
+	size_t totalBytes() const;
+	size_t usedBytes() const;
+
+private:
+	explicit RamFS(std::shared_ptr<RamFSImpl> impl);
+
+	std::shared_ptr<RamFSImpl> impl_;
+};
+
+extern RamFS TMPFS;
+
+} // namespace app
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENV_NATIVE
+#include "app/resolver.h"
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_ESP8266)
+# include <ESP8266WiFi.h>
+# include <lwip/dns.h>
+#elif defined(ARDUINO_ARCH_ESP32)
+# include <WiFi.h>
+# include <esp_pthread.h>
+# include <lwip/netdb.h>
+#else
+# error "Unknown arch"
+#endif
+
+#include <string>
+#ifdef ARDUINO_ARCH_ESP32
+# include <thread>
+#endif
+
+#include <uuid/common.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+
+MAKE_PSTR(logger_name, "dns")
+
+namespace app {
+
+uuid::log::Logger Resolver::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+Resolver::Resolver(const __FlashStringHelper *name, change_function function)
+		: name_(name), function_(std::move(function)) {
+}
+
+Resolver::~Resolver() {
+#ifdef ARDUINO_ARCH_ESP32
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+#endif
+}
+
+bool Resolver::valid_hostname(const std::string &host) {
+	size_t label = 0;
+
+	if (host.empty() || host.length() > 253)
+		return false;
+
+	for (char c : host) {
+		if (c == '.') {
+			if (label == 0)
+				return false;
+			label = 0;
+		} else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+				|| (c >= '0' && c <= '9') || c == '-') {
+			if (++label > 63)
+				return false;
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Resolver::host(const std::string &host) {
+	if (host == host_)
+		return;
+
+	host_ = host;
+	address_ = (uint32_t)0;
+	resolved_ = false;
+	attempted_ = false;
+}
+
+void Resolver::loop() {
+	if (running_)
+		return;
+
+	if (completed_) {
+#ifdef ARDUINO_ARCH_ESP32
+		if (thread_.joinable()) {
+			thread_.join();
+		}
+#endif
+		completed_ = false;
+		finish(result_success_, result_address_);
+	}
+
+	if (host_.empty() || WiFi.status() != WL_CONNECTED)
+		return;
+
+	if (local_address_ != WiFi.localIP()) {
+		local_address_ = WiFi.localIP();
+		attempted_ = false;
+	}
+
+	uint64_t now_ms = uuid::get_uptime_ms();
+
+	if (!attempted_ || now_ms - last_attempt_ms_
+			>= (resolved_ ? REFRESH_INTERVAL_MS : RETRY_INTERVAL_MS)) {
+		attempted_ = true;
+		last_attempt_ms_ = now_ms;
+		start();
+	}
+}
+
+void Resolver::finish(bool success, const IPAddress &address) {
+	if (query_host_ != host_)
+		return;
+
+	if (!success) {
+		if (resolved_ || !failed_) {
+			logger_.warning(F("Unable to resolve %S host %s"), name_, host_.c_str());
+		}
+		resolved_ = false;
+		failed_ = true;
+		return;
+	}
+
+	resolved_ = true;
+	failed_ = false;
+
+	if (address != address_) {
+		logger_.info(F("Resolved %S host %s to %s"), name_, host_.c_str(),
+			uuid::printable_to_string(address).c_str());
+		address_ = address;
+		function_(address_);
+	}
+}
+
+#if defined(ARDUINO_ARCH_ESP8266)
+void Resolver::start() {
+	ip_addr_t addr;
+
+	query_host_ = host_;
+	running_ = true;
+
+	err_t err = dns_gethostbyname(query_host_.c_str(), &addr, dns_found, this);
+
+	if (err == ERR_OK) {
+		dns_found(query_host_.c_str(), &addr, this);
+	} else if (err != ERR_INPROGRESS) {
+		dns_found(query_host_.c_str(), nullptr, this);
+	}
+}
+
+void Resolver::dns_found(const char *name, const ip_addr_t *ipaddr, void *arg) {
+	auto *resolver = reinterpret_cast<Resolver *>(arg);
+
+	resolver->result_success_ = ipaddr != nullptr;
+	resolver->result_address_ = ipaddr ? IPAddress(*ipaddr) : IPAddress((uint32_t)0);
+	resolver->completed_ = true;
+	resolver->running_ = false;
+}
+#elif defined(ARDUINO_ARCH_ESP32)
+void Resolver::start() {
+	query_host_ = host_;
+
+	try {
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+
+		running_ = true;
+		thread_ = std::thread{[this, host = query_host_] {
+			try {
+				this->run(host);
+			} catch (...) {
+				result_success_ = false;
+				logger_.emerg("Thread exception");
+			}
+			completed_ = true;
+			running_ = false;
+		}};
+	} catch (...) {
+		logger_.emerg("Out of memory");
+		running_ = false;
+	}
+}
+
+void Resolver::run(std::string host) {
+	struct addrinfo hints{};
+	struct addrinfo *result = nullptr;
+
+	hints.ai_family = AF_INET;
+
+	result_success_ = false;
+
+	if (::getaddrinfo(host.c_str(), nullptr, &hints, &result) == 0 && result) {
+		auto *addr = reinterpret_cast<struct sockaddr_in *>(result->ai_addr);
+
+		result_address_ = IPAddress(addr->sin_addr.s_addr);
+		result_success_ = true;
+	}
+
+	if (result) {
+		::freeaddrinfo(result);
+	}
+}
+#else
+# error "Unknown arch"
+#endif
+
+} // namespace app
+
+#endif
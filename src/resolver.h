@@ -0,0 +1,101 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef ENV_NATIVE
+
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP8266
+# include <ESP8266WiFi.h>
+# include <lwip/ip_addr.h>
+#else
+# include <WiFi.h>
+#endif
+
+#include <atomic>
+#include <functional>
+#include <string>
+#ifdef ARDUINO_ARCH_ESP32
+# include <thread>
+#endif
+
+#include <uuid/log.h>
+
+namespace app {
+
+/*
+ * Resolves a hostname in the background, calling the change function from
+ * loop() whenever the address changes.
+ *
+ * The address is refreshed periodically; the lwIP DNS cache answers these
+ * queries until the record's TTL expires. It's also refreshed immediately
+ * if the local IP address changes.
+ */
+class Resolver {
+public:
+	using change_function = std::function<void(const IPAddress &address)>;
+
+	Resolver(const __FlashStringHelper *name, change_function function);
+	~Resolver();
+
+	static bool valid_hostname(const std::string &host);
+
+	void host(const std::string &host);
+	void loop();
+
+	inline IPAddress address() const { return address_; }
+
+private:
+	static constexpr uint64_t REFRESH_INTERVAL_MS = 60 * 1000;
+	static constexpr uint64_t RETRY_INTERVAL_MS = 10 * 1000;
+#ifdef ARDUINO_ARCH_ESP32
+	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+#endif
+
+	static uuid::log::Logger logger_;
+
+	void start();
+	void finish(bool success, const IPAddress &address);
+#if defined(ARDUINO_ARCH_ESP8266)
+	static void dns_found(const char *name, const ip_addr_t *ipaddr, void *arg);
+#elif defined(ARDUINO_ARCH_ESP32)
+	void run(std::string host);
+#endif
+
+	const __FlashStringHelper *name_;
+	change_function function_;
+	std::string host_;
+	std::string query_host_;
+	IPAddress address_{0, 0, 0, 0};
+	IPAddress local_address_{0, 0, 0, 0};
+	uint64_t last_attempt_ms_{0};
+	bool resolved_{false};
+	bool attempted_{false};
+	bool failed_{false};
+	std::atomic<bool> running_{false};
+	std::atomic<bool> completed_{false};
+	bool result_success_{false};
+	IPAddress result_address_{0, 0, 0, 0};
+#ifdef ARDUINO_ARCH_ESP32
+	std::thread thread_;
+#endif
+};
+
+} // namespace app
+
+#endif
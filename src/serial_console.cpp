@@ -0,0 +1,144 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENV_NATIVE
+
+#include "app/serial_console.h"
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/pstr.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && ARDUINO_USB_CDC_ON_BOOT
+# if ARDUINO_USB_MODE
+#  define SERIAL_CONSOLE_USB_SERIAL_JTAG
+# else
+#  define SERIAL_CONSOLE_USB_CDC
+# endif
+#endif
+
+MAKE_PSTR(logger_name, "serial")
+
+namespace app {
+
+namespace serial_console {
+
+static uuid::log::Logger logger{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+static std::atomic<unsigned long> rx_overflows{0};
+#if defined(SERIAL_CONSOLE_USB_CDC)
+static std::atomic<unsigned long> rx_dropped_bytes{0};
+#endif
+static std::atomic<unsigned long> rx_errors{0};
+static unsigned long reported_overflows = 0;
+static unsigned long reported_errors = 0;
+
+#if defined(SERIAL_CONSOLE_USB_CDC)
+static void usb_cdc_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+	if (id == ARDUINO_USB_CDC_RX_OVERFLOW_EVENT) {
+		auto *event = reinterpret_cast<arduino_usb_cdc_event_data_t *>(data);
+
+		rx_overflows++;
+		rx_dropped_bytes += event->rx_overflow.dropped_bytes;
+	}
+}
+#elif defined(ARDUINO_ARCH_ESP32) && !defined(SERIAL_CONSOLE_USB_SERIAL_JTAG)
+/* Called from the UART event task */
+static void uart_error(hardwareSerial_error_t error) {
+	if (error == UART_BUFFER_FULL_ERROR || error == UART_FIFO_OVF_ERROR) {
+		rx_overflows++;
+	} else if (error != UART_NO_ERROR) {
+		rx_errors++;
+	}
+}
+#endif
+
+void begin() {
+#if defined(ARDUINO_ARCH_ESP8266)
+	Serial.setRxBufferSize(APP_SERIAL_CONSOLE_RX_BUFFER_SIZE);
+	Serial.begin(APP_SERIAL_CONSOLE_BAUD_RATE);
+#elif defined(SERIAL_CONSOLE_USB_CDC)
+	Serial.setRxBufferSize(APP_SERIAL_CONSOLE_RX_BUFFER_SIZE);
+	Serial.onEvent(ARDUINO_USB_CDC_RX_OVERFLOW_EVENT, usb_cdc_event);
+	Serial.begin();
+#elif defined(SERIAL_CONSOLE_USB_SERIAL_JTAG)
+	Serial.setRxBufferSize(APP_SERIAL_CONSOLE_RX_BUFFER_SIZE);
+	Serial.setTxBufferSize(APP_SERIAL_CONSOLE_TX_BUFFER_SIZE);
+	Serial.begin();
+#elif defined(ARDUINO_ARCH_ESP32)
+	Serial.setRxBufferSize(APP_SERIAL_CONSOLE_RX_BUFFER_SIZE);
+	Serial.setTxBufferSize(APP_SERIAL_CONSOLE_TX_BUFFER_SIZE);
+	Serial.onReceiveError(uart_error);
+	Serial.begin(APP_SERIAL_CONSOLE_BAUD_RATE);
+#else
+# error "Unknown arch"
+#endif
+}
+
+void loop() {
+#if defined(ARDUINO_ARCH_ESP8266)
+	/* The interrupt handler only records that an error has occurred */
+	if (Serial.hasOverrun())
+		rx_overflows++;
+
+	if (Serial.hasRxError())
+		rx_errors++;
+#endif
+
+	unsigned long overflows = rx_overflows;
+	unsigned long errors = rx_errors;
+
+	if (overflows != reported_overflows) {
+		logger.warning(F("Receive buffer overflow (%lu total)"), overflows);
+		reported_overflows = overflows;
+	}
+
+	if (errors != reported_errors) {
+		logger.notice(F("Receive error (%lu total)"), errors);
+		reported_errors = errors;
+	}
+}
+
+void show(uuid::console::Shell &shell) {
+#if defined(SERIAL_CONSOLE_USB_CDC)
+	shell.println(F("Interface:     USB CDC"));
+#elif defined(SERIAL_CONSOLE_USB_SERIAL_JTAG)
+	shell.println(F("Interface:     USB Serial/JTAG"));
+#else
+	shell.printfln(F("Interface:     UART at %lu baud"), (unsigned long)APP_SERIAL_CONSOLE_BAUD_RATE);
+#endif
+	shell.printfln(F("RX buffer:     %u bytes"), (unsigned int)APP_SERIAL_CONSOLE_RX_BUFFER_SIZE);
+#if !defined(ARDUINO_ARCH_ESP8266) && !defined(SERIAL_CONSOLE_USB_CDC)
+	shell.printfln(F("TX buffer:     %u bytes"), (unsigned int)APP_SERIAL_CONSOLE_TX_BUFFER_SIZE);
+#endif
+	shell.printfln(F("RX overflows:  %lu"), rx_overflows.load());
+#if defined(SERIAL_CONSOLE_USB_CDC)
+	shell.printfln(F("RX dropped:    %lu bytes"), rx_dropped_bytes.load());
+#endif
+	shell.printfln(F("RX errors:     %lu"), rx_errors.load());
+}
+
+} // namespace serial_console
+
+} // namespace app
+
+#endif
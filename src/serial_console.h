@@ -0,0 +1,68 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <uuid/console.h>
+
+/*
+ * The baud rate is ignored when the local console is native USB CDC
+ * (ESP32-S2/S3 with ARDUINO_USB_CDC_ON_BOOT).
+ */
+#ifndef APP_SERIAL_CONSOLE_BAUD_RATE
+# define APP_SERIAL_CONSOLE_BAUD_RATE 115200
+#endif
+
+/*
+ * Receive data is buffered by the UART interrupt handler so that it isn't
+ * lost (at high baud rates) while the main loop is busy.
+ */
+#ifndef APP_SERIAL_CONSOLE_RX_BUFFER_SIZE
+# if defined(ARDUINO_ARCH_ESP8266)
+#  define APP_SERIAL_CONSOLE_RX_BUFFER_SIZE 512
+# else
+#  define APP_SERIAL_CONSOLE_RX_BUFFER_SIZE 2048
+# endif
+#endif
+
+/*
+ * Transmit data is buffered and sent by the UART interrupt handler instead
+ * of waiting for space in the hardware FIFO (not supported on the ESP8266).
+ */
+#ifndef APP_SERIAL_CONSOLE_TX_BUFFER_SIZE
+# define APP_SERIAL_CONSOLE_TX_BUFFER_SIZE 1024
+#endif
+
+namespace app {
+
+namespace serial_console {
+
+#ifndef ENV_NATIVE
+/* Configure buffers and error counters, then start the local console */
+void begin();
+
+/* Report any receive errors since the last call */
+void loop();
+
+/* Output configuration and error counters */
+void show(uuid::console::Shell &shell);
+#endif
+
+} // namespace serial_console
+
+} // namespace app
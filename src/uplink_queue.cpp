@@ -0,0 +1,521 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "app/uplink_queue.h"
+
+#include <Arduino.h>
+#include <esp_pthread.h>
+#include <WiFi.h>
+
+#include <CBOR.h>
+#include <CBOR_parsing.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/common.h>
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+#include "app/fs.h"
+#include "app/pstr.h"
+
+namespace cbor = qindesign::cbor;
+
+MAKE_PSTR(logger_name, "uplink")
+
+namespace app {
+
+static const char DIRECTORY[] = "/uplink";
+static const char HEAD_FILENAME[] = "/uplink/head";
+static constexpr size_t SEGMENT_ID_LENGTH = 8;
+
+class VectorPrint: public ::Print {
+public:
+	explicit VectorPrint(std::vector<uint8_t> &buffer) : buffer_(buffer) {}
+
+	size_t write(uint8_t data) override {
+		buffer_.push_back(data);
+		return 1;
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		buffer_.insert(buffer_.end(), buffer, buffer + size);
+		return size;
+	}
+
+private:
+	std::vector<uint8_t> &buffer_;
+};
+
+static bool read_record(cbor::Reader &reader, UplinkQueue::Record &record) {
+	uint64_t length;
+	uint64_t time;
+	bool indefinite;
+
+	if (!cbor::expectArray(reader, &length, &indefinite) || indefinite || length != 2
+			|| !cbor::expectUnsignedInt(reader, &time)
+			|| !cbor::expectBytes(reader, &length, &indefinite) || indefinite
+			|| length > UplinkQueue::MAX_RECORD_SIZE)
+		return false;
+
+	record.time = time;
+	record.data.resize(length);
+
+	return reader.readBytes(record.data.data(), length) == length;
+}
+
+uuid::log::Logger UplinkQueue::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+UplinkQueue::~UplinkQueue() {
+	if (thread_.joinable())
+		thread_.join();
+}
+
+std::string UplinkQueue::segment_filename(unsigned long id) {
+	std::array<char, sizeof(DIRECTORY) + 1 + SEGMENT_ID_LENGTH> filename;
+
+	snprintf(filename.data(), filename.size(), "%s/%08lx", DIRECTORY, id);
+	return filename.data();
+}
+
+void UplinkQueue::start() {
+	const char mode[2] = { 'r', '\0' };
+	auto dir = FS.open(DIRECTORY, mode);
+	std::vector<unsigned long> ids;
+	unsigned long head_id = 0;
+	size_t head_offset = 0;
+
+	if (!dir || !dir.isDirectory()) {
+		if (!FS.mkdir(DIRECTORY)) {
+			logger_.err(F("Unable to create %s"), DIRECTORY);
+			return;
+		}
+	} else {
+		while (true) {
+			auto name = dir.getNextFileName();
+
+			if (name.length() == 0)
+				break;
+
+			if (name.length() == sizeof(DIRECTORY) + SEGMENT_ID_LENGTH) {
+				const char *id = name.c_str() + sizeof(DIRECTORY);
+				char *end = nullptr;
+				unsigned long value = std::strtoul(id, &end, 16);
+
+				if (end && *end == '\0')
+					ids.push_back(value);
+			}
+		}
+
+		std::sort(ids.begin(), ids.end());
+	}
+	dir.close();
+
+	auto file = FS.open(HEAD_FILENAME, mode);
+	if (file) {
+		cbor::Reader reader{file};
+		uint64_t value;
+
+		if (cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag)
+				&& cbor::expectUnsignedInt(reader, &value)) {
+			head_id = value;
+
+			if (cbor::expectUnsignedInt(reader, &value))
+				head_offset = value;
+		}
+
+		file.close();
+	}
+
+	for (unsigned long id : ids) {
+		Segment segment{id, 0, 0, false, 0, 0};
+		size_t from = id == head_id ? head_offset : 0;
+
+		/* Segments before the head have already been sent */
+		if (id < head_id || !scan(segment, from) || !segment.records) {
+			FS.remove(segment_filename(id).c_str());
+			continue;
+		}
+
+		if (segments_.empty())
+			head_offset_ = from;
+
+		segments_.push_back(segment);
+	}
+
+	/*
+	 * Segment IDs restart when the queue is empty, so the head must not be
+	 * applied to a future segment with the same ID.
+	 */
+	if (segments_.empty() && head_id)
+		FS.remove(HEAD_FILENAME);
+
+	next_id_ = segments_.empty() ? 1 : ids.back() + 1;
+	pending_.reserve(APP_UPLINK_BATCH_SIZE + MAX_RECORD_SIZE);
+	started_ = true;
+
+	if (!segments_.empty()) {
+		unsigned long records = 0;
+
+		for (const auto &segment : segments_)
+			records += segment.records;
+
+		logger_.info(F("%lu records queued"), records);
+	}
+}
+
+/*
+ * Count the records in a segment from an offset, and find the end of the
+ * last complete record.
+ */
+bool UplinkQueue::scan(Segment &segment, size_t from) {
+	const char mode[2] = { 'r', '\0' };
+	auto file = FS.open(segment_filename(segment.id).c_str(), mode);
+	cbor::Reader reader{file};
+	Record record;
+
+	if (!file || !cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag))
+		return false;
+
+	segment.size = file.position();
+
+	while (file.available()) {
+		if (!read_record(reader, record)) {
+			logger_.warning(F("Segment %08lx truncated at %zu bytes"), segment.id, segment.size);
+			corrupt_++;
+			break;
+		}
+
+		if (segment.size >= from) {
+			if (!segment.records)
+				segment.first = record.time;
+
+			segment.records++;
+		}
+
+		segment.size = file.position();
+	}
+
+	return from <= segment.size;
+}
+
+void UplinkQueue::sender(Sender sender) {
+	sender_ = sender;
+}
+
+bool UplinkQueue::push(const std::string &data) {
+	return push(reinterpret_cast<const uint8_t *>(data.data()), data.length());
+}
+
+bool UplinkQueue::push(const uint8_t *data, size_t len) {
+	if (!started_ || len > MAX_RECORD_SIZE) {
+		dropped_++;
+		return false;
+	}
+
+	VectorPrint output{pending_};
+	cbor::Writer writer{output};
+	time_t now = ::time(nullptr);
+
+	if (pending_.empty()) {
+		pending_since_ms_ = uuid::get_uptime_ms();
+		pending_first_ = now >= MIN_VALID_TIME ? now : 0;
+	}
+
+	writer.beginArray(2);
+	writer.writeUnsignedInt(now >= MIN_VALID_TIME ? now : 0);
+	writer.beginBytes(len);
+	writer.writeBytes(data, len);
+
+	pending_records_++;
+	pushed_++;
+
+	if (pending_.size() >= APP_UPLINK_BATCH_SIZE)
+		commit();
+
+	return true;
+}
+
+/* Append the waiting records to the current segment with one write */
+void UplinkQueue::commit() {
+	if (pending_.empty())
+		return;
+
+	if (segments_.empty() || !segments_.back().writable || segments_.back().size >= SEGMENT_SIZE) {
+		VectorPrint output{pending_};
+		cbor::Writer writer{output};
+		size_t records_len = pending_.size();
+
+		if (!segments_.empty())
+			segments_.back().writable = false;
+
+		/* Prepend the tag to the first batch of a new segment */
+		writer.writeTag(cbor::kSelfDescribeTag);
+		std::rotate(pending_.begin(), pending_.begin() + records_len, pending_.end());
+
+		segments_.push_back({next_id_++, 0, 0, true, 0, 0});
+	}
+
+	Segment &segment = segments_.back();
+	/* Records in the current batch are still counted until it has been sent */
+	unsigned long batch_records = &segment == &segments_.front() ? batch_.size() : 0;
+	auto filename = segment_filename(segment.id);
+	const char mode[2] = { 'a', '\0' };
+	auto file = FS.open(filename.c_str(), mode, true);
+	size_t len = file ? file.write(pending_.data(), pending_.size()) : 0;
+
+	file.close();
+
+	if (len == pending_.size()) {
+		if (segment.records == 0) {
+			segment.first = pending_first_;
+		} else if (segment.records == batch_records) {
+			segment.next_first = pending_first_;
+		}
+
+		segment.size += len;
+		segment.records += pending_records_;
+		batches_written_++;
+	} else {
+		/* Don't append anything after a partial write */
+		logger_.err(F("Unable to write %lu records to %s"), pending_records_, filename.c_str());
+		segment.writable = false;
+		dropped_ += pending_records_;
+
+		if (!segment.size) {
+			FS.remove(filename.c_str());
+			segments_.pop_back();
+		}
+	}
+
+	pending_.clear();
+	pending_records_ = 0;
+
+	enforce_limit();
+}
+
+void UplinkQueue::save_head() {
+	if (segments_.empty()) {
+		FS.remove(HEAD_FILENAME);
+		return;
+	}
+
+	const char mode[2] = { 'w', '\0' };
+	auto file = FS.open(HEAD_FILENAME, mode);
+
+	if (file) {
+		cbor::Writer writer{file};
+
+		writer.writeTag(cbor::kSelfDescribeTag);
+		writer.writeUnsignedInt(segments_.front().id);
+		writer.writeUnsignedInt(head_offset_);
+	}
+}
+
+void UplinkQueue::remove_segment() {
+	FS.remove(segment_filename(segments_.front().id).c_str());
+	segments_.pop_front();
+	head_offset_ = 0;
+}
+
+/* Remove the oldest segments (except one that is being sent) to make space */
+void UplinkQueue::enforce_limit() {
+	size_t total = 0;
+
+	for (const auto &segment : segments_)
+		total += segment.size;
+
+	while (total > APP_UPLINK_QUEUE_SIZE && segments_.size() > 1 && !running_) {
+		logger_.warning(F("Queue full, dropping %lu records"), segments_.front().records);
+		total -= segments_.front().size;
+		dropped_ += segments_.front().records;
+		remove_segment();
+		save_head();
+	}
+}
+
+void UplinkQueue::loop() {
+	if (!started_)
+		return;
+
+	if (!pending_.empty() && uuid::get_uptime_ms() - pending_since_ms_ >= APP_UPLINK_COMMIT_INTERVAL_MS)
+		commit();
+
+	if (running_)
+		return;
+
+	if (thread_.joinable()) {
+		thread_.join();
+		finish_batch();
+	}
+
+	if (!segments_.empty() && head_offset_ >= segments_.front().size && !segments_.front().writable) {
+		remove_segment();
+		save_head();
+	}
+
+	if (!sender_ || segments_.empty() || head_offset_ >= segments_.front().size
+			|| WiFi.status() != WL_CONNECTED
+			|| (retry_ms_ && uuid::get_uptime_ms() < retry_ms_))
+		return;
+
+	if (!read_batch())
+		return;
+
+	try {
+		auto cfg = esp_pthread_get_default_config();
+		cfg.stack_size = TASK_STACK_SIZE;
+		cfg.prio = uxTaskPriorityGet(nullptr);
+		esp_pthread_set_cfg(&cfg);
+
+		running_ = true;
+		thread_ = std::thread{[this] {
+			try {
+				sent_ = sender_(batch_);
+			} catch (...) {
+				logger_.emerg("Thread exception");
+				sent_ = false;
+			}
+			running_ = false;
+		}};
+	} catch (...) {
+		logger_.emerg("Out of memory");
+		running_ = false;
+		batch_.clear();
+		retry_ms_ = uuid::get_uptime_ms() + RETRY_INTERVAL_MS;
+	}
+}
+
+/* Read the rest of the committed records in the head segment */
+bool UplinkQueue::read_batch() {
+	Segment &segment = segments_.front();
+	const char mode[2] = { 'r', '\0' };
+	auto file = FS.open(segment_filename(segment.id).c_str(), mode);
+	cbor::Reader reader{file};
+
+	batch_.clear();
+
+	if (!file || (head_offset_ == 0
+			? !cbor::expectValue(reader, cbor::DataType::kTag, cbor::kSelfDescribeTag)
+			: !file.seek(head_offset_))) {
+		logger_.err(F("Unable to read segment %08lx"), segment.id);
+		dropped_ += segment.records;
+		corrupt_++;
+		segment.records = 0;
+		segment.writable = false;
+		head_offset_ = segment.size;
+		return false;
+	}
+
+	while ((size_t)file.position() < segment.size) {
+		Record record;
+
+		if (!read_record(reader, record)) {
+			logger_.err(F("Segment %08lx corrupt at %zu bytes"), segment.id, (size_t)file.position());
+			dropped_ += segment.records - batch_.size();
+			corrupt_++;
+			segment.records = batch_.size();
+			segment.size = file.position();
+			segment.writable = false;
+			break;
+		}
+
+		batch_.push_back(std::move(record));
+	}
+
+	batch_end_ = file.position();
+
+	if (batch_.empty()) {
+		head_offset_ = segment.size;
+		return false;
+	}
+
+	segment.first = batch_.front().time;
+	segment.next_first = 0;
+	return true;
+}
+
+void UplinkQueue::finish_batch() {
+	if (sent_) {
+		Segment &segment = segments_.front();
+
+		sent_records_ += batch_.size();
+		batches_sent_++;
+		segment.records -= batch_.size();
+		segment.first = segment.records ? segment.next_first : 0;
+		segment.next_first = 0;
+		head_offset_ = batch_end_;
+		retry_ms_ = 0;
+		save_head();
+	} else {
+		send_failures_++;
+		retry_ms_ = uuid::get_uptime_ms() + RETRY_INTERVAL_MS;
+		logger_.debug(F("Unable to send %zu records"), batch_.size());
+	}
+
+	batch_.clear();
+	enforce_limit();
+}
+
+void UplinkQueue::show(uuid::console::Shell &shell) {
+	unsigned long records = 0;
+	size_t bytes = 0;
+	time_t oldest = 0;
+
+	for (const auto &segment : segments_) {
+		if (!records && segment.records)
+			oldest = segment.first;
+
+		records += segment.records;
+		bytes += segment.size;
+	}
+
+	if (!records && pending_records_)
+		oldest = pending_first_;
+
+	records += pending_records_;
+
+	bytes -= std::min(bytes, head_offset_);
+
+	shell.printfln(F("Uplink queue:  %lu records, %zu bytes in %zu segments (%zu bytes not yet written)"),
+		records, bytes, segments_.size(), pending_.size());
+
+	time_t now = ::time(nullptr);
+
+	if (oldest && now >= oldest) {
+		shell.printfln(F("Oldest record: %llus"), (unsigned long long)(now - oldest));
+	}
+
+	shell.printfln(F("Pushed:        %llu records in %lu flash writes"), pushed_, batches_written_);
+	shell.printfln(F("Sent:          %llu records in %lu batches (%lu failures)%S"),
+		sent_records_, batches_sent_, send_failures_,
+		!sender_ ? F(", no sender") : (running_ ? F(", sending") : F("")));
+	shell.printfln(F("Dropped:       %lu records (%lu corrupt segments)"), dropped_, corrupt_);
+}
+
+} // namespace app
+
+#endif
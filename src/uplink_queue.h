@@ -0,0 +1,145 @@
+/*
+ * mcu-app - Microcontroller application framework
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/console.h>
+#include <uuid/log.h>
+
+/* Maximum size of the queue on the filesystem, the oldest data is removed first */
+#ifndef APP_UPLINK_QUEUE_SIZE
+# define APP_UPLINK_QUEUE_SIZE (256 * 1024)
+#endif
+
+/* Records are written to flash when this much is waiting... */
+#ifndef APP_UPLINK_BATCH_SIZE
+# define APP_UPLINK_BATCH_SIZE 4096
+#endif
+
+/* ...or when the oldest waiting record is this old */
+#ifndef APP_UPLINK_COMMIT_INTERVAL_MS
+# define APP_UPLINK_COMMIT_INTERVAL_MS 5000
+#endif
+
+namespace app {
+
+/*
+ * Persistent store-and-forward queue for data that needs to be uploaded,
+ * so that it isn't lost while the network is down.
+ *
+ * Records are batched in memory and each batch is appended to a segment
+ * file on the filesystem with a single write. Segments are written to by
+ * one boot only, so a batch that was interrupted by a reset can only
+ * truncate the end of a segment.
+ *
+ * While the network is connected, the records at the head of the queue
+ * are read in batches of up to one segment and passed to the sender on a
+ * separate thread. They're removed from the queue when the sender
+ * returns true, otherwise they're retried later.
+ */
+class UplinkQueue {
+public:
+	struct Record {
+		time_t time; /* Seconds since the epoch, or 0 if the time wasn't set */
+		std::vector<uint8_t> data;
+	};
+
+	/* Called on a separate thread, return true if the records were uploaded */
+	using Sender = std::function<bool(const std::vector<Record> &records)>;
+
+	static constexpr size_t MAX_RECORD_SIZE = 1024;
+
+	~UplinkQueue();
+
+	void start();
+	void loop();
+
+	void sender(Sender sender);
+	bool push(const uint8_t *data, size_t len);
+	bool push(const std::string &data);
+
+	/* Write waiting records to flash (before a restart) */
+	void commit();
+
+	void show(uuid::console::Shell &shell);
+
+private:
+	struct Segment {
+		unsigned long id;
+		size_t size;
+		unsigned long records; /* Not yet sent */
+		bool writable;
+		time_t first; /* Time of the first record not yet sent */
+		time_t next_first; /* Time of the first record after the current batch */
+	};
+
+	static constexpr size_t SEGMENT_SIZE = 16 * 1024;
+	static constexpr size_t TASK_STACK_SIZE = 4 * 1024;
+	static constexpr uint64_t RETRY_INTERVAL_MS = 30 * 1000;
+	static constexpr time_t MIN_VALID_TIME = 1577836800; /* 2020-01-01 */
+
+	static uuid::log::Logger logger_;
+
+	static std::string segment_filename(unsigned long id);
+	bool scan(Segment &segment, size_t from);
+	void save_head();
+	void remove_segment();
+	void enforce_limit();
+	bool read_batch();
+	void finish_batch();
+
+	std::deque<Segment> segments_;
+	unsigned long next_id_{0};
+	size_t head_offset_{0};
+	bool started_{false};
+
+	std::vector<uint8_t> pending_;
+	unsigned long pending_records_{0};
+	uint64_t pending_since_ms_{0};
+	time_t pending_first_{0};
+
+	Sender sender_;
+	std::vector<Record> batch_;
+	size_t batch_end_{0};
+	uint64_t retry_ms_{0};
+	std::thread thread_;
+	std::atomic<bool> running_{false};
+	std::atomic<bool> sent_{false};
+
+	unsigned long long pushed_{0};
+	unsigned long long sent_records_{0};
+	unsigned long batches_written_{0};
+	unsigned long batches_sent_{0};
+	unsigned long send_failures_{0};
+	unsigned long dropped_{0};
+	unsigned long corrupt_{0};
+};
+
+} // namespace app
+
+#endif
@@ -59,6 +59,15 @@ std::string hex_string(const uint8_t *buf, size_t len) {
 	return text.data();
 }
 
+bool password_equal(const std::string &input, const std::string &password) {
+	uint8_t difference = input.length() != password.length();
+
+	for (size_t i = 0; i < input.length(); i++)
+		difference |= input[i] ^ (i < password.length() ? password[i] : 0);
+
+	return !difference;
+}
+
 std::string normalise_filename(const std::string &filename) {
 	std::string output;
 
@@ -45,6 +45,22 @@
 # define MCU_APP_THREAD_SAFE 0
 #endif
 
+/*
+ * Build with -DAPP_IRAM_HOT_PATHS=1 to place hot paths in IRAM so that
+ * they're not delayed by instruction cache misses. It doesn't let them run
+ * during flash writes: the other CPU is stalled and tasks are suspended
+ * wherever their code is, and data in PSRAM can't be accessed either.
+ */
+#ifndef APP_IRAM_HOT_PATHS
+# define APP_IRAM_HOT_PATHS 0
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32) && APP_IRAM_HOT_PATHS
+# define MCU_APP_HOT_IRAM IRAM_ATTR
+#else
+# define MCU_APP_HOT_IRAM
+#endif
+
 #include <CBOR.h>
 #include <CBOR_parsing.h>
 #include <CBOR_streams.h>
@@ -64,6 +80,9 @@ private:
 
 std::string hex_string(const uint8_t *buf, size_t len);
 
+/* Compare a password without stopping at the first difference */
+bool password_equal(const std::string &input, const std::string &password);
+
 template<typename T, size_t size>
 static inline std::string null_terminated_string(T(&data)[size]) {
 	T *found = reinterpret_cast<T*>(std::memchr(&data[0], '\0', size));